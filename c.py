@@ -3,51 +3,81 @@ import os
 import shutil
 
 
-def process_csv(csv_path):
-    # 创建 images 目录，如果不存在
-    base_path = os.path.join(os.path.dirname(csv_path), 'images')
-    if not os.path.exists(base_path):
-        os.makedirs(base_path)
+def read_results(csv_path):
+    """读取结果文件，返回 (照片序号, 图像路径, {瓦片名称: 占比}) 列表。
 
+    同时支持稀疏格式（T/P/C 记录）和旧的稠密矩阵格式。
+    """
     with open(csv_path, newline='', encoding='utf-8') as csvfile:
         reader = csv.reader(csvfile)
-        headers = next(reader)  # 读取第一行作为列标题
+        first = next(reader)
+        if first and first[0] in ('T', 'P', 'C'):
+            tile_names = {}
+            photos = {}
+            order = []
+            for row in [first] + list(reader):
+                if row[0] == 'T':
+                    tile_names[row[1]] = row[2]
+                elif row[0] == 'P':
+                    photos[row[1]] = (row[2], {})
+                    order.append(row[1])
+                elif row[0] == 'C':
+                    photos[row[1]][1][tile_names[row[2]]] = float(row[3])
+            return list(tile_names.values()), [(index, photos[index][0], photos[index][1]) for index in order]
 
-        # 确定 image path 和 photo index 的列索引
+        # 稠密格式：第一行是列标题
+        headers = first
         photo_index_index = headers.index("Photo Index")
         image_path_index = headers.index(" Image Path")
-        # 创建每个瓦片名称对应的文件夹和文本文件
-        tile_folders = {}
-        tile_files = {}
-        for i, header in enumerate(headers):
-            if i > image_path_index:
-                folder_path = os.path.join(base_path, header)
-                os.makedirs(folder_path, exist_ok=True)
-                tile_folders[i] = folder_path
-                # 创建对应的文本文件
-                tile_files[i] = open(os.path.join(folder_path, 'photo_indices.txt'), 'w')
-
-        # 遍历文件的每一行
+        tile_names = headers[image_path_index + 1:]
+        results = []
         for row in reader:
-            image_path = row[image_path_index]
-            photo_index = row[photo_index_index]
+            percentages = {}
             for i in range(image_path_index + 1, len(headers)):
                 try:
-                    percentage = float(row[i])
-                    if percentage > 20:
-                        # 复制文件到对应的文件夹
-                        target_folder = tile_folders[i]
-                        target_path = os.path.join(target_folder, os.path.basename(image_path))
-                        shutil.copy(image_path, target_path)
-                        print(f"Copied {image_path} to {target_path}")
-                        # 记录 photo index 到文本文件
-                        tile_files[i].write(f"{photo_index}\n")
+                    percentages[headers[i]] = float(row[i])
                 except ValueError:
-                    continue  # 如果转换失败或没有找到文件，则忽略
+                    continue
+            results.append((row[photo_index_index], row[image_path_index], percentages))
+        return tile_names, results
+
+
+def process_csv(csv_path):
+    # 创建 images 目录，如果不存在
+    base_path = os.path.join(os.path.dirname(csv_path), 'images')
+    if not os.path.exists(base_path):
+        os.makedirs(base_path)
+
+    tile_names, results = read_results(csv_path)
+
+    # 创建每个瓦片名称对应的文件夹和文本文件
+    tile_folders = {}
+    tile_files = {}
+    for tile_name in tile_names:
+        folder_path = os.path.join(base_path, tile_name)
+        os.makedirs(folder_path, exist_ok=True)
+        tile_folders[tile_name] = folder_path
+        # 创建对应的文本文件
+        tile_files[tile_name] = open(os.path.join(folder_path, 'photo_indices.txt'), 'w')
+
+    # 遍历每张照片
+    for photo_index, image_path, percentages in results:
+        for tile_name, percentage in percentages.items():
+            if percentage > 20:
+                # 复制文件到对应的文件夹
+                target_folder = tile_folders[tile_name]
+                target_path = os.path.join(target_folder, os.path.basename(image_path))
+                try:
+                    shutil.copy(image_path, target_path)
+                    print(f"Copied {image_path} to {target_path}")
+                except OSError:
+                    continue  # 如果没有找到文件，则忽略
+                # 记录 photo index 到文本文件
+                tile_files[tile_name].write(f"{photo_index}\n")
 
-        # 关闭所有打开的文本文件
-        for file in tile_files.values():
-            file.close()
+    # 关闭所有打开的文本文件
+    for file in tile_files.values():
+        file.close()
 
 
 # 用法
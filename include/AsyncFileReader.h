@@ -0,0 +1,30 @@
+#ifndef ASYNCFILEREADER_H
+#define ASYNCFILEREADER_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// 一个文件的完整内容，ok 为 false 时表示打开或读取失败
+struct FileReadResult {
+	size_t index;
+	bool ok;
+	std::string data;
+};
+
+// 批量读取整个文件。readFiles 在调用线程中运行到所有文件完成为止，
+// 每个文件完成时调用 onComplete（可能来自不同线程，允许阻塞以形成反压）
+class AsyncFileReader {
+public:
+	virtual ~AsyncFileReader() {}
+	virtual const char* name() const = 0;
+	virtual void readFiles(const std::vector<std::string>& files, const std::function<void(FileReadResult&&)>& onComplete) = 0;
+};
+
+// backend 为 auto | uring | threads；auto 在编译时启用 liburing 且内核支持时使用 io_uring，
+// 否则退回到 ioThreads 个阻塞读取线程。queueDepth 为 io_uring 同时在途的读请求数
+std::unique_ptr<AsyncFileReader> createAsyncFileReader(const std::string& backend, unsigned int ioThreads, unsigned int queueDepth);
+
+#endif // ASYNCFILEREADER_H
@@ -28,21 +28,41 @@
 //    }
 //};
 
+// 场景坐标中的视锥体平面，法线指向视锥体内部：normal * p + offset >= 0 为内侧
+struct FrustumPlanes {
+	osg::Vec3d normals[6];
+	double offsets[6];
+
+	// 包围盒完全位于某个平面外侧时返回 0，完全位于视锥体内返回 2，其余返回 1
+	int classify(const osg::BoundingBox& box) const;
+};
+
 class Camera {
 public:
 	explicit Camera(const PhotoInfo& photoInfo);
 
 	std::vector<osg::Vec3d> calculateCornerRays() const;
 	std::vector<std::pair<osg::Vec3d, osg::Vec3d>> calculatePartialPixelRays(int step, double length) const;
+	// 计算单个像素 (x, y) 的射线线段
+	std::pair<osg::Vec3d, osg::Vec3d> calculatePixelRay(double x, double y, double length) const;
+	// 将像素射线裁剪到 tiles 包围盒并集的最紧区间，未命中时返回起点终点重合的空线段
+	std::pair<osg::Vec3d, osg::Vec3d> calculateClippedPixelRay(double x, double y, const std::vector<NamedBoundingBox>& tiles) const;
+	std::vector<std::pair<osg::Vec3d, osg::Vec3d>> calculateClippedPixelRays(int step, const std::vector<NamedBoundingBox>& tiles) const;
+	// 将场景坐标转换到相机坐标系（z 轴沿光轴），像素坐标为 (fx * x / z + cx, fy * y / z + cy)
+	osg::Vec3d worldToCamera(const osg::Vec3d& world) const;
 
 	const PhotoInfo& getPhotoInfo() const {
 		return photoInfo;
 	}
 
-	osg::Vec3 getCameraCenter() const {
-		return osg::Vec3(photoInfo.pose.center[0], -photoInfo.pose.center[2], photoInfo.pose.center[1]);
+	// 双精度返回，float 内核自行减去局部原点后再降精度
+	osg::Vec3d getCameraCenter() const {
+		return osg::Vec3d(photoInfo.pose.center[0], -photoInfo.pose.center[2], photoInfo.pose.center[1]);
 	}
-	osg::ref_ptr<osg::MatrixTransform> createFrustumGeometry(double heightThreshold) const;
+	// 视锥体的近远平面由场景包围盒在相机光轴上的深度范围决定
+	osg::ref_ptr<osg::MatrixTransform> createFrustumGeometry(const osg::BoundingBox& sceneBounds) const;
+	// 与 createFrustumGeometry 相同的近远平面，侧面由图像四角射线确定
+	FrustumPlanes calculateFrustumPlanes(const osg::BoundingBox& sceneBounds) const;
 
 	osg::BoundingBox calculateFrustumBoundingBox(const osg::ref_ptr<osg::MatrixTransform>& frustumTransform) const;
 
@@ -61,6 +81,7 @@ private:
 	osg::Vec3d cameraCenter;  // World coordinates of the camera center
 	osg::Vec3d pixelToNormalizedImageCoordinates(double x, double y) const;
 	osg::Vec3d normalizedImageCoordinatesToRay(const osg::Vec3d& normalizedCoords) const;
+	void calculateDepthRange(const osg::BoundingBox& sceneBounds, double& nearPlane, double& farPlane) const;
 };
 
 #endif // CAMERA_H
@@ -0,0 +1,45 @@
+#ifndef CHECKPOINTLOG_H
+#define CHECKPOINTLOG_H
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "TileIntersectionCalculator.h"
+#include "TileRegistry.h"
+
+// 断点日志：每张照片完成时追加一条带校验和的记录，进程中断后可从日志恢复。
+//   格式：魔数 "PMCK" + 版本号，u32 长度 + 运行参数签名，tile 表 (u32 数量, 每项 u16 长度 + 名称)，
+//   之后每条记录为 u32 载荷长度 + u32 校验和 + 载荷 (i32 序号, u16 长度 + 路径, u32 结果数, 每项 u32 tileId + f64 占比)。
+// 记录保留全部候选 tile 的双精度占比，恢复后的输出与一次跑完的输出相同
+class CheckpointLog {
+public:
+	// resume 为 true 时读回已有日志，丢弃末尾写了一半的记录；参数签名或 tile 表不一致时抛出异常。
+	// resume 为 false 时清空重写
+	CheckpointLog(const std::string& path, const std::string& runKey, const TileRegistry& registry, bool resume);
+	~CheckpointLog();
+
+	bool isCompleted(int photoIndex) const { return completed.count(photoIndex) != 0; }
+	size_t numCompleted() const { return completed.size(); }
+	// 线程安全；每条记录写入后立即交给操作系统，进程被杀也不会丢失，落盘 (fsync) 按时间间隔进行
+	void append(const PhotoData& photoData);
+	// 日志中的全部照片，按序号排序
+	std::vector<PhotoData> readPhotos();
+	// append 累计耗时，用于确认断点开销
+	double getWriteSeconds() const { return writeSeconds; }
+
+private:
+	void sync();
+
+	std::string path;
+	std::FILE* file = nullptr;
+	std::unordered_set<int> completed;
+	std::vector<char> buffer;
+	std::mutex mutex;
+	std::chrono::steady_clock::time_point lastSync;
+	double writeSeconds = 0.0;
+};
+
+#endif // CHECKPOINTLOG_H
@@ -0,0 +1,35 @@
+#ifndef CONTENTHASH_H
+#define CONTENTHASH_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// 64 位内容签名：FNV-1a 按 8 字节字长处理，尾部逐字节。只用于检测内容变化，不用于安全场合
+const uint64_t kHashSeed = 14695981039346656037ull;
+const uint64_t kHashPrime = 1099511628211ull;
+
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t hash = kHashSeed) {
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		std::memcpy(&word, bytes + i, sizeof(word));
+		hash = (hash ^ word) * kHashPrime;
+	}
+	for (; i < size; ++i) {
+		hash = (hash ^ bytes[i]) * kHashPrime;
+	}
+	return hash;
+}
+
+template <typename T>
+inline uint64_t hashValue(const T& value, uint64_t hash) {
+	return hashBytes(&value, sizeof(T), hash);
+}
+
+inline uint64_t hashString(const std::string& value, uint64_t hash) {
+	return hashBytes(value.data(), value.size(), hashValue(value.size(), hash));
+}
+
+#endif // CONTENTHASH_H
@@ -0,0 +1,82 @@
+#ifndef COVERAGEENGINE_H
+#define COVERAGEENGINE_H
+
+#include <osg/MatrixTransform>
+#include <osg/Vec3d>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Camera.h"
+#include "SceneBuilder.h"
+#include "TileIntersectionCalculator.h"
+#include "PipelineConfig.h"
+
+class TileCache;
+
+// 一张照片的追踪输入。rays 为 camera 按 step 行优先采样的像素射线，
+// 不使用射线的引擎（如光栅化）按相同的采样点输出结果，保证各引擎逐射线可比
+struct CoverageBatch {
+	const Camera& camera;
+	const std::vector<NamedBoundingBox>& intersectingTiles;
+	int step;
+	const std::vector<std::pair<osg::Vec3d, osg::Vec3d>>& rays;
+};
+
+// 一张照片送入引擎前的准备结果：视锥体、候选 tile 与射线。processPhoto 与基准测试共用，保证两者输入一致
+struct PhotoRaySetup {
+	osg::ref_ptr<osg::MatrixTransform> frustumTransform;
+	osg::BoundingBox frustumBBox;
+	std::vector<NamedBoundingBox> intersectingTiles;
+	std::vector<std::pair<osg::Vec3d, osg::Vec3d>> rays;
+};
+
+// 相机高于场景高度阈值 30 米以上的照片不处理
+bool isPhotoAboveScene(const Camera& camera, double heightThreshold);
+// 未指定射线长度时射线裁剪到候选 tile 包围盒并集的最紧区间
+PhotoRaySetup setupPhotoRays(Camera& camera, const osg::BoundingBox& sceneBounds,
+	const std::vector<NamedBoundingBox>& tileBoundingBoxes, const PipelineConfig& config);
+
+// 加速结构的构建统计，供基准对比
+struct EngineBuildStats {
+	double buildSeconds = 0.0;  // 各 tile 构建耗时之和，并行构建时可能大于实际经过的时间
+	size_t triangles = 0;
+	size_t memoryBytes = 0;     // 加速结构占用，不含三角网本身
+};
+
+// tile 占比计算引擎：场景加载完成后 prepare 一次，之后可被多个照片线程并发调用 traceBatch；
+// 核外模式下每批 tile 换入后再次 prepare，换出的 tile 先经 releaseTiles 释放
+class CoverageEngine {
+public:
+	virtual ~CoverageEngine() {}
+
+	virtual const char* name() const = 0;
+	// 场景加载时每个 tile 读取完成后在加载线程中调用，可与其余 tile 的读取重叠构建加速结构
+	virtual void onTileLoaded(const std::string& /*tileName*/, osg::Node* /*tileNode*/) {}
+	virtual void prepare(const SceneBuilder& builder) = 0;
+	// 每条射线最先击中的 tile，未击中为 kInvalidTileId，顺序与 batch.rays 一致
+	virtual std::vector<TileId> traceBatch(const CoverageBatch& batch) const = 0;
+	// 由逐射线结果统计每个候选 tile 的占比
+	virtual std::vector<TileIntersectionResult> aggregate(const std::vector<TileId>& rayTiles,
+		const CoverageBatch& batch) const;
+
+	virtual EngineBuildStats getBuildStats() const { return EngineBuildStats(); }
+	// 核外模式卸载 tile 后调用，释放引擎为这些 tile 保存的数据
+	virtual void releaseTiles(const std::vector<TileId>& /*ids*/) {}
+	// 每个三角形在场景图之外的常驻内存估计，核外模式据此规划批次
+	virtual size_t accelerationBytesPerTriangle() const { return 0; }
+	// 共享 tile 缓存：attachTileCache 后 prepare 直接映射缓存中的 tile，不需要场景图节点；
+	// writeTileCache 把 prepare 构建的结果写成缓存。不支持的引擎返回 false 或抛出异常
+	virtual bool attachTileCache(const TileCache* /*cache*/) { return false; }
+	virtual void writeTileCache(const std::string& path, const SceneBuilder& builder) const;
+
+	std::vector<TileIntersectionResult> computeCoverage(const CoverageBatch& batch) const {
+		return aggregate(traceBatch(batch), batch);
+	}
+};
+
+// 按名称创建引擎，未知名称抛出 std::runtime_error；返回的引擎尚未 prepare
+std::unique_ptr<CoverageEngine> createCoverageEngine(const std::string& name, const PipelineConfig& config);
+// 所有可用引擎的名称，第一个为精确参考引擎
+const std::vector<std::string>& getCoverageEngineNames();
+
+#endif // COVERAGEENGINE_H
@@ -0,0 +1,14 @@
+#ifndef ENGINEBENCHMARK_H
+#define ENGINEBENCHMARK_H
+
+#include <vector>
+#include "PhotoInfoParser.h"
+#include "SceneBuilder.h"
+#include "PipelineConfig.h"
+
+// 以 osg 引擎为真值，在抽样照片上逐射线对比其他引擎，输出不一致率、最大占比误差和加速比。
+// 任一引擎超出 config 中的容差时返回 false
+bool runEngineBenchmark(const PipelineConfig& config, const std::vector<PhotoInfo>& photoInfos,
+	const SceneBuilder& builder);
+
+#endif // ENGINEBENCHMARK_H
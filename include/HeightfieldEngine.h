@@ -0,0 +1,46 @@
+#ifndef HEIGHTFIELDENGINE_H
+#define HEIGHTFIELDENGINE_H
+
+#include <osg/Vec3d>
+#include <osg/BoundingBox>
+#include <vector>
+#include "TileMesh.h"
+#include "TileRegistry.h"
+
+// 2.5D 数字表面模型：把所有 tile 的三角网自上而下栅格化为 (高程, TileId) 网格，
+// 并建立最大高程 mip 金字塔，射线在金字塔中分层步进求首个交点。
+// 场景坐标中地面为 (x, z) 平面，高程为 -y（与 SceneBuilder::calculateHeightThreshold 一致）
+class HeightfieldEngine {
+public:
+	// meshes 以 TileId 为下标；cellSize <= 0 时按场景最长边 4096 个格网自动选取。
+	// 栅格化与射线步进在共享线程池中执行，numThreads 为 0 时按线程池的线程数划分
+	HeightfieldEngine(const std::vector<TileMesh>& meshes, double cellSize, unsigned int numThreads = 0);
+
+	// 沿线段 start -> end 求首个击中的 tile，未击中返回 kInvalidTileId
+	TileId traceRay(const osg::Vec3d& start, const osg::Vec3d& end) const;
+	std::vector<TileId> traceRays(const std::vector<std::pair<osg::Vec3d, osg::Vec3d>>& rays) const;
+
+	double getCellSize() const { return cellSize; }
+	int getColumns() const { return columns; }
+	int getRows() const { return rows; }
+	// 网格与 mip 金字塔占用的字节数
+	size_t memoryBytes() const;
+
+private:
+	struct Level {
+		int columns, rows;
+		std::vector<float> maxHeight;
+	};
+
+	void rasterizeMesh(const TileMesh& mesh, TileId tileId, int rowBegin, int rowEnd);
+	void buildPyramid();
+
+	double cellSize;
+	double originX, originZ;     // 网格左下角的场景坐标
+	int columns, rows;
+	unsigned int numThreads;
+	std::vector<TileId> cellTiles;   // 第 0 层每个格网最高表面所属的 tile
+	std::vector<Level> levels;       // levels[0] 为原始高程
+};
+
+#endif // HEIGHTFIELDENGINE_H
@@ -0,0 +1,34 @@
+#ifndef INCREMENTALSTATE_H
+#define INCREMENTALSTATE_H
+
+#include <string>
+#include <vector>
+#include "SceneBuilder.h"
+#include "TileIntersectionCalculator.h"
+
+// 增量重算的状态：每个 tile 的内容哈希，以及每张照片的输入哈希、依赖的 tile 与结果
+struct IncrementalPhoto {
+	int index;
+	std::string imagePath;
+	uint64_t inputHash;                        // hashPhotoInfo() 的结果
+	bool hasResult;                            // 高于高度阈值的照片不产生结果
+	std::vector<TileId> dependencies;          // 视锥体候选 tile，下标对应 IncrementalState::tiles
+	std::vector<TileIntersectionResult> results;
+};
+
+// 文本格式：注释行以 # 开头；"K,<运行参数签名>"；
+//   每个 tile 一行 "T,<编号>,<内容哈希>,<文件签名>,<三角形数>,<包围盒 6 个分量>,<名称>"（v1 没有文件签名）；
+//   每张照片一行 "P,<序号>,<输入哈希>,<是否有结果>,<空格分隔的依赖 tile>,<路径>"，
+//   每个结果一行 "C,<序号>,<tile 编号>,<占比>"。哈希为十六进制，浮点数按可精确读回的最短形式写出
+struct IncrementalState {
+	std::string runKey;
+	std::vector<TileSummary> tiles;
+	std::vector<IncrementalPhoto> photos;
+};
+
+// 文件不存在时返回 false，格式错误时抛出异常
+bool readIncrementalState(const std::string& path, IncrementalState& state);
+// 先写临时文件再改名
+void writeIncrementalState(const std::string& path, const IncrementalState& state);
+
+#endif // INCREMENTALSTATE_H
@@ -0,0 +1,389 @@
+#ifndef MESHBVH_H
+#define MESHBVH_H
+
+#include <osg/BoundingBox>
+#include <osg/Vec3d>
+#include <algorithm>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include "TileMesh.h"
+
+class ThreadPool;
+
+// BVH 最大深度，遍历栈按此分配
+const uint32_t kMaxBvhDepth = 96;
+
+// 二叉 BVH 节点。叶子节点 count > 0，图元为 primitiveIndices[first, first + count)；
+// 内部节点 count == 0，左右子节点为 children[0]、children[1]
+struct BvhNode {
+	osg::BoundingBox bounds;
+	uint32_t first;
+	uint32_t count;
+	uint32_t children[2];
+
+	bool isLeaf() const { return count > 0; }
+};
+
+// 按图元包围盒构建的二叉 BVH，节点 0 为根节点。
+// 每层在三个轴上做分箱 SAH 划分；给定线程池时大于阈值的子树作为任务并行构建
+class Bvh {
+public:
+	void build(const std::vector<osg::BoundingBox>& primitiveBounds, uint32_t maxLeafSize = 4, ThreadPool* pool = nullptr);
+
+	const std::vector<BvhNode>& getNodes() const { return nodes; }
+	const std::vector<uint32_t>& getPrimitiveIndices() const { return primitiveIndices; }
+	bool empty() const { return nodes.empty(); }
+
+private:
+	std::vector<BvhNode> nodes;
+	std::vector<uint32_t> primitiveIndices;
+};
+
+// 线段 origin + t * direction，t ∈ [0, tMax]
+struct BvhRay {
+	osg::Vec3d origin;
+	osg::Vec3d direction;
+	osg::Vec3d inverseDirection;
+
+	BvhRay(const osg::Vec3d& start, const osg::Vec3d& end);
+};
+
+bool intersectBvhBounds(const BvhRay& ray, const osg::BoundingBox& bounds, double tMax, double& tEnter);
+
+// 由近到远遍历以 root 为根的子树，对每个叶子图元调用 intersectPrimitive(primitive, tMax)，
+// 回调在找到更近的交点时缩短 tMax 并返回 true
+template <typename IntersectPrimitive>
+bool traverseBvh(const Bvh& bvh, const BvhRay& ray, uint32_t root, double& tMax, IntersectPrimitive intersectPrimitive) {
+	const std::vector<BvhNode>& nodes = bvh.getNodes();
+	const std::vector<uint32_t>& primitives = bvh.getPrimitiveIndices();
+	if (nodes.empty()) return false;
+
+	bool hit = false;
+	// 压栈时记录进入距离，出栈时若已有更近的交点则跳过
+	uint32_t stack[kMaxBvhDepth + 1];
+	double stackEnter[kMaxBvhDepth + 1];
+	int stackSize = 0;
+	double tEnter;
+	if (!intersectBvhBounds(ray, nodes[root].bounds, tMax, tEnter)) return false;
+	stack[stackSize] = root;
+	stackEnter[stackSize++] = tEnter;
+	while (stackSize > 0) {
+		--stackSize;
+		if (stackEnter[stackSize] > tMax) continue;
+		const BvhNode& node = nodes[stack[stackSize]];
+		if (node.isLeaf()) {
+			for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+				if (intersectPrimitive(primitives[i], tMax)) hit = true;
+			}
+			continue;
+		}
+		// 先访问较近的子节点：后压栈的先出栈
+		double tLeft, tRight;
+		bool hitLeft = intersectBvhBounds(ray, nodes[node.children[0]].bounds, tMax, tLeft);
+		bool hitRight = intersectBvhBounds(ray, nodes[node.children[1]].bounds, tMax, tRight);
+		if (hitLeft && hitRight && tRight < tLeft) {
+			stack[stackSize] = node.children[0];
+			stackEnter[stackSize++] = tLeft;
+			stack[stackSize] = node.children[1];
+			stackEnter[stackSize++] = tRight;
+		}
+		else {
+			if (hitRight) {
+				stack[stackSize] = node.children[1];
+				stackEnter[stackSize++] = tRight;
+			}
+			if (hitLeft) {
+				stack[stackSize] = node.children[0];
+				stackEnter[stackSize++] = tLeft;
+			}
+		}
+	}
+	return hit;
+}
+
+// 宽 BVH 的子节点引用：最高位为 1 表示叶子，其余位为首个图元；否则为内部节点下标
+const uint32_t kBvhLeafFlag = 0x80000000u;
+const uint32_t kBvhEmptyChild = 0xFFFFFFFFu;
+
+// Width 路宽节点，子包围盒相对节点包围盒量化为 8 位，量化时向外取整保证包围盒保守
+template <int Width>
+struct WideBvhNode {
+	float origin[3];
+	float scale[3];
+	uint8_t lower[3][Width];
+	uint8_t upper[3][Width];
+	uint32_t children[Width];
+	uint8_t counts[Width];  // 叶子的图元数
+
+	osg::BoundingBox childBounds(int slot) const {
+		return osg::BoundingBox(
+			origin[0] + lower[0][slot] * scale[0], origin[1] + lower[1][slot] * scale[1], origin[2] + lower[2][slot] * scale[2],
+			origin[0] + upper[0][slot] * scale[0], origin[1] + upper[1][slot] * scale[1], origin[2] + upper[2][slot] * scale[2]);
+	}
+};
+
+// 由二叉 BVH 合并得到的 4 路或 8 路 BVH：每次展开表面积最大的内部子节点，直到填满 Width 个子节点。
+// 节点与图元数组可以自己持有（build），也可以指向外部只读内存（attach，如映射的共享缓存文件）
+template <int Width>
+class WideBvh {
+public:
+	typedef WideBvhNode<Width> Node;
+
+	WideBvh() {}
+	// 持有数组时指针指向自身的 vector，不能复制
+	WideBvh(const WideBvh&) = delete;
+	WideBvh& operator=(const WideBvh&) = delete;
+
+	void build(const Bvh& binary);
+	// 使用外部数组，调用方保证其生命周期长于 WideBvh
+	void attach(const Node* nodes, size_t numNodes, const uint32_t* primitives, size_t numPrimitives,
+		const osg::BoundingBox& bounds, uint32_t root, uint32_t rootCount);
+
+	const Node* getNodes() const { return nodeData; }
+	size_t numNodes() const { return nodeCount; }
+	const uint32_t* getPrimitiveIndices() const { return primitiveData; }
+	size_t numPrimitives() const { return primitiveCount; }
+	const osg::BoundingBox& getBounds() const { return bounds; }
+	uint32_t getRoot() const { return root; }
+	uint32_t getRootCount() const { return rootCount; }
+	bool empty() const { return root == kBvhEmptyChild; }
+	size_t memoryBytes() const { return nodeCount * sizeof(Node) + primitiveCount * sizeof(uint32_t); }
+
+	// 从子节点引用 ref（叶子时图元数为 count）开始由近到远遍历，回调约定同 traverseBvh
+	template <typename IntersectPrimitive>
+	bool traverse(const BvhRay& ray, uint32_t ref, uint32_t count, double& tMax, IntersectPrimitive intersectPrimitive) const;
+
+private:
+	uint32_t collapse(const std::vector<BvhNode>& binaryNodes, uint32_t binaryIndex);
+
+	std::vector<Node> nodes;
+	std::vector<uint32_t> primitiveIndices;
+	const Node* nodeData = nullptr;
+	size_t nodeCount = 0;
+	const uint32_t* primitiveData = nullptr;
+	size_t primitiveCount = 0;
+	osg::BoundingBox bounds;
+	uint32_t root = kBvhEmptyChild;
+	uint32_t rootCount = 0;
+};
+
+static inline float bvhSurfaceArea(const osg::BoundingBox& box) {
+	osg::Vec3f extent = box._max - box._min;
+	return extent.x() * extent.y() + extent.y() * extent.z() + extent.z() * extent.x();
+}
+
+template <int Width>
+void WideBvh<Width>::build(const Bvh& binary) {
+	nodes.clear();
+	primitiveIndices = binary.getPrimitiveIndices();
+	root = kBvhEmptyChild;
+	rootCount = 0;
+	const std::vector<BvhNode>& binaryNodes = binary.getNodes();
+	if (!binaryNodes.empty()) {
+		bounds = binaryNodes[0].bounds;
+		if (binaryNodes[0].isLeaf()) {
+			root = kBvhLeafFlag | binaryNodes[0].first;
+			rootCount = binaryNodes[0].count;
+		}
+		else {
+			root = collapse(binaryNodes, 0);
+		}
+	}
+	nodeData = nodes.data();
+	nodeCount = nodes.size();
+	primitiveData = primitiveIndices.data();
+	primitiveCount = primitiveIndices.size();
+}
+
+template <int Width>
+void WideBvh<Width>::attach(const Node* nodes, size_t numNodes, const uint32_t* primitives, size_t numPrimitives,
+	const osg::BoundingBox& bounds, uint32_t root, uint32_t rootCount) {
+	this->nodes.clear();
+	primitiveIndices.clear();
+	nodeData = nodes;
+	nodeCount = numNodes;
+	primitiveData = primitives;
+	primitiveCount = numPrimitives;
+	this->bounds = bounds;
+	this->root = root;
+	this->rootCount = rootCount;
+}
+
+template <int Width>
+uint32_t WideBvh<Width>::collapse(const std::vector<BvhNode>& binaryNodes, uint32_t binaryIndex) {
+	// 展开表面积最大的内部子节点
+	uint32_t candidates[Width];
+	int numCandidates = 2;
+	candidates[0] = binaryNodes[binaryIndex].children[0];
+	candidates[1] = binaryNodes[binaryIndex].children[1];
+	while (numCandidates < Width) {
+		int best = -1;
+		float bestArea = -1.0f;
+		for (int i = 0; i < numCandidates; ++i) {
+			const BvhNode& candidate = binaryNodes[candidates[i]];
+			if (!candidate.isLeaf() && bvhSurfaceArea(candidate.bounds) > bestArea) {
+				best = i;
+				bestArea = bvhSurfaceArea(candidate.bounds);
+			}
+		}
+		if (best < 0) break;
+		const BvhNode& expanded = binaryNodes[candidates[best]];
+		candidates[best] = expanded.children[0];
+		candidates[numCandidates++] = expanded.children[1];
+	}
+
+	const uint32_t nodeIndex = static_cast<uint32_t>(nodes.size());
+	nodes.push_back(Node());
+	const osg::BoundingBox& nodeBounds = binaryNodes[binaryIndex].bounds;
+	float origin[3], scale[3];
+	for (int axis = 0; axis < 3; ++axis) {
+		origin[axis] = nodeBounds._min[axis];
+		// 略微放大步长，使 origin + 255 * scale 不小于节点包围盒上界
+		float extent = nodeBounds._max[axis] - nodeBounds._min[axis];
+		scale[axis] = extent > 0.0f ? extent / 255.0f * (1.0f + 1e-5f) : std::max(std::fabs(origin[axis]), 1.0f) * 1e-7f;
+	}
+
+	uint32_t children[Width];
+	uint8_t counts[Width] = {};
+	uint8_t lower[3][Width] = {};
+	uint8_t upper[3][Width] = {};
+	for (int slot = 0; slot < Width; ++slot) {
+		if (slot >= numCandidates) {
+			children[slot] = kBvhEmptyChild;
+			continue;
+		}
+		const BvhNode& child = binaryNodes[candidates[slot]];
+		for (int axis = 0; axis < 3; ++axis) {
+			int lo = static_cast<int>(std::floor((child.bounds._min[axis] - origin[axis]) / scale[axis]));
+			int hi = static_cast<int>(std::ceil((child.bounds._max[axis] - origin[axis]) / scale[axis]));
+			lo = std::min(255, std::max(0, lo));
+			hi = std::min(255, std::max(0, hi));
+			// 反量化的浮点误差可能使包围盒略小，逐格修正
+			while (lo > 0 && origin[axis] + lo * scale[axis] > child.bounds._min[axis]) --lo;
+			while (hi < 255 && origin[axis] + hi * scale[axis] < child.bounds._max[axis]) ++hi;
+			lower[axis][slot] = static_cast<uint8_t>(lo);
+			upper[axis][slot] = static_cast<uint8_t>(hi);
+		}
+		if (child.isLeaf()) {
+			children[slot] = kBvhLeafFlag | child.first;
+			counts[slot] = static_cast<uint8_t>(child.count);
+		}
+		else {
+			children[slot] = collapse(binaryNodes, candidates[slot]);
+		}
+	}
+
+	Node& node = nodes[nodeIndex];
+	for (int axis = 0; axis < 3; ++axis) {
+		node.origin[axis] = origin[axis];
+		node.scale[axis] = scale[axis];
+		std::copy(lower[axis], lower[axis] + Width, node.lower[axis]);
+		std::copy(upper[axis], upper[axis] + Width, node.upper[axis]);
+	}
+	std::copy(children, children + Width, node.children);
+	std::copy(counts, counts + Width, node.counts);
+	return nodeIndex;
+}
+
+template <int Width>
+template <typename IntersectPrimitive>
+bool WideBvh<Width>::traverse(const BvhRay& ray, uint32_t ref, uint32_t count, double& tMax,
+	IntersectPrimitive intersectPrimitive) const {
+	if (ref == kBvhEmptyChild) return false;
+	bool hit = false;
+	// 每层最多压入 Width - 1 个兄弟节点
+	uint32_t stack[kMaxBvhDepth * (Width - 1) + 1];
+	uint32_t stackCount[kMaxBvhDepth * (Width - 1) + 1];
+	double stackEnter[kMaxBvhDepth * (Width - 1) + 1];
+	int stackSize = 0;
+	stack[stackSize] = ref;
+	stackCount[stackSize] = count;
+	stackEnter[stackSize++] = 0.0;
+	while (stackSize > 0) {
+		--stackSize;
+		if (stackEnter[stackSize] > tMax) continue;
+		const uint32_t current = stack[stackSize];
+		if (current & kBvhLeafFlag) {
+			const uint32_t first = current & ~kBvhLeafFlag;
+			for (uint32_t i = first; i < first + stackCount[stackSize]; ++i) {
+				if (intersectPrimitive(primitiveData[i], tMax)) hit = true;
+			}
+			continue;
+		}
+
+		const Node& node = nodeData[current];
+		int hitSlots[Width];
+		double hitEnter[Width];
+		int numHits = 0;
+		for (int slot = 0; slot < Width; ++slot) {
+			if (node.children[slot] == kBvhEmptyChild) continue;
+			double tEnter;
+			if (!intersectBvhBounds(ray, node.childBounds(slot), tMax, tEnter)) continue;
+			// 按进入距离插入排序
+			int position = numHits++;
+			while (position > 0 && hitEnter[position - 1] > tEnter) {
+				hitSlots[position] = hitSlots[position - 1];
+				hitEnter[position] = hitEnter[position - 1];
+				--position;
+			}
+			hitSlots[position] = slot;
+			hitEnter[position] = tEnter;
+		}
+		// 远的先压栈，近的先出栈
+		for (int i = numHits - 1; i >= 0; --i) {
+			stack[stackSize] = node.children[hitSlots[i]];
+			stackCount[stackSize] = node.counts[hitSlots[i]];
+			stackEnter[stackSize++] = hitEnter[i];
+		}
+	}
+	return hit;
+}
+
+// Möller-Trumbore 线段与三角形求交，双面
+bool intersectBvhTriangle(const BvhRay& ray, const osg::Vec3d& v0, const osg::Vec3d& v1, const osg::Vec3d& v2, double& t);
+
+// 一个 tile 的三角网及其宽 BVH。三角网数组由调用方持有（TileMesh 或映射的缓存文件），生命周期须长于 TileBvh
+template <int Width>
+struct TileBvh {
+	const osg::Vec3f* vertices = nullptr;
+	const uint32_t* indices = nullptr;
+	size_t numVertices = 0;
+	size_t numTriangles = 0;
+	WideBvh<Width> bvh;
+
+	void build(const TileMesh& tileMesh, ThreadPool* pool = nullptr) {
+		vertices = tileMesh.vertices.data();
+		indices = tileMesh.indices.data();
+		numVertices = tileMesh.vertices.size();
+		numTriangles = tileMesh.numTriangles();
+		std::vector<osg::BoundingBox> triangleBounds(tileMesh.numTriangles());
+		for (size_t t = 0; t < triangleBounds.size(); ++t) {
+			for (int i = 0; i < 3; ++i) {
+				triangleBounds[t].expandBy(tileMesh.vertices[tileMesh.indices[t * 3 + i]]);
+			}
+		}
+		Bvh binary;
+		binary.build(triangleBounds, 4, pool);
+		bvh.build(binary);
+	}
+
+	// 从子节点引用 ref 开始求 [0, tMax] 内最近的三角形交点，命中时缩短 tMax 并返回 true
+	bool intersect(const BvhRay& ray, uint32_t ref, uint32_t count, double& tMax) const {
+		return bvh.traverse(ray, ref, count, tMax, [&](uint32_t primitive, double& tNearest) {
+			const uint32_t* triangle = &indices[primitive * 3];
+			double t;
+			if (intersectBvhTriangle(ray, vertices[triangle[0]], vertices[triangle[1]], vertices[triangle[2]], t)
+				&& t >= 0.0 && t < tNearest) {
+				tNearest = t;
+				return true;
+			}
+			return false;
+		});
+	}
+	bool intersect(const BvhRay& ray, double& tMax) const {
+		return intersect(ray, bvh.getRoot(), bvh.getRootCount(), tMax);
+	}
+};
+
+#endif // MESHBVH_H
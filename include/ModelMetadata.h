@@ -0,0 +1,33 @@
+#ifndef MODELMETADATA_H
+#define MODELMETADATA_H
+
+#include <string>
+#include <vector>
+#include <osg/BoundingBox>
+#include "PhotoInfoParser.h"
+
+// data/mesh/metadata.xml 中的空间参考，OBJ 顶点坐标相对 SRSOrigin 存放
+struct ModelMetadata {
+	std::string srs;
+	double srsOrigin[3];
+	bool hasOrigin;
+};
+
+// 文件不存在时返回零原点；文件存在但格式错误时抛出异常
+ModelMetadata loadModelMetadata(const std::string& metadataFile);
+
+// 照片位置所在坐标系：local 与 mesh 相同；srs 为绝对坐标，需减去 SRSOrigin；
+// auto 选择使照片中心在水平方向更接近场景中心的一种
+enum class PhotoFrame {
+	Auto,
+	Local,
+	Srs
+};
+
+PhotoFrame parsePhotoFrame(const std::string& name);
+
+// 在 double 下把照片中心平移到 mesh 的局部坐标系，返回是否做了平移
+bool convertPhotosToLocalFrame(std::vector<PhotoInfo>& photoInfos, const ModelMetadata& metadata, PhotoFrame frame,
+	const osg::BoundingBox& sceneBounds);
+
+#endif // MODELMETADATA_H
@@ -0,0 +1,30 @@
+#ifndef OUTOFCOREPLANNER_H
+#define OUTOFCOREPLANNER_H
+
+#include <cstddef>
+#include <vector>
+#include "TileRegistry.h"
+
+// 一张照片的候选 tile 及其在地面上的位置（场景坐标 x、z）
+struct PhotoWorkItem {
+	int photoIndex;
+	double groundX, groundZ;
+	std::vector<TileId> tiles;
+};
+
+// 一批同时处理的照片，tiles 为它们候选 tile 的并集
+struct PhotoBatch {
+	std::vector<int> photoIndices;
+	std::vector<TileId> tiles;
+	size_t estimatedBytes;
+};
+
+// 按地面位置的 Morton 序返回下标，相邻下标的位置相近
+std::vector<size_t> groundMortonOrder(const std::vector<double>& groundX, const std::vector<double>& groundZ);
+
+// 照片按地面位置的 Morton 序排列后贪心装批，使每批候选 tile 的估计内存不超过 budgetBytes，
+// 相邻批次共享的 tile 较多。单张照片的候选 tile 已超过预算时抛出 std::runtime_error
+std::vector<PhotoBatch> planPhotoBatches(const std::vector<PhotoWorkItem>& items, const std::vector<size_t>& tileBytes,
+	size_t budgetBytes);
+
+#endif // OUTOFCOREPLANNER_H
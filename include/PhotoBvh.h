@@ -0,0 +1,40 @@
+#ifndef PHOTOBVH_H
+#define PHOTOBVH_H
+
+#include <vector>
+#include <utility>
+#include "Camera.h"
+#include "MeshBvh.h"
+#include "SceneBuilder.h"
+
+// 视锥体裁剪后保留的 tile BVH 子树，ref 与 count 同 WideBvhNode 的子节点引用
+struct BvhSubtree {
+	TileId tileId;
+	uint32_t ref;
+	uint32_t count;
+};
+
+// 单张照片的紧凑 BVH：用视锥体裁剪一次候选 tile 的 BVH，把保留的子树作为图元建立顶层 BVH，
+// 照片的所有射线只在顶层 BVH 与保留的子树中遍历
+template <int Width>
+class PhotoBvh {
+public:
+	// tileBvhs 以 TileId 为下标，未加载的 tile 为空指针
+	PhotoBvh(const std::vector<const TileBvh<Width>*>& tileBvhs, const std::vector<NamedBoundingBox>& intersectingTiles,
+		const FrustumPlanes& frustum);
+
+	// 线段最先击中的 tile，未击中返回 kInvalidTileId
+	TileId trace(const std::pair<osg::Vec3d, osg::Vec3d>& ray) const;
+	std::vector<TileId> traceRays(const std::vector<std::pair<osg::Vec3d, osg::Vec3d>>& rays, unsigned int numThreads = 0) const;
+
+	size_t numSubtrees() const { return subtrees.size(); }
+	size_t numVisitedNodes() const { return visitedNodes; }
+
+private:
+	const std::vector<const TileBvh<Width>*>& tileBvhs;
+	std::vector<BvhSubtree> subtrees;
+	Bvh topLevel;
+	size_t visitedNodes;
+};
+
+#endif // PHOTOBVH_H
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <vector>
+#include <cstdint>
 #include "tinyxml2.h"
 
 struct DistortionCoefficients {
@@ -26,6 +27,9 @@ struct PhotoInfo {
 	double aspectRatio; // 纵横比
 };
 
+// 影响射线的全部字段（路径、尺寸、内参、畸变与位姿）的哈希，用于判断照片的输入是否变化
+uint64_t hashPhotoInfo(const PhotoInfo& photoInfo);
+
 class PhotoInfoParser {
 public:
 	PhotoInfoParser(const std::string& xmlFile);
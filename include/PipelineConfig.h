@@ -0,0 +1,74 @@
+#ifndef PIPELINECONFIG_H
+#define PIPELINECONFIG_H
+
+#include <string>
+
+// 运行参数，命令行以 --name=value 的形式覆盖默认值
+struct PipelineConfig {
+	// run: 构建场景并处理照片；assign: 只根据已有结果文件做 tile 分配；bench: 引擎精度与速度对比
+	// plan: 把照片划分为 numShards 个分片并写清单；shard: 处理清单中的一个分片；merge: 合并各分片结果
+	// cache: 只构建并写出 tileCache，供之后的工作进程共享映射
+	std::string mode = "run";
+	std::string xmlFile = "data/images/weizi.xml";
+	std::string meshFolder = "data/mesh";
+	std::string metadataFile;      // 模型 SRSOrigin 所在文件，为空时使用 meshFolder/metadata.xml
+	std::string photoFrame = "auto";  // 照片位置坐标系：auto | local | srs
+	std::string ioBackend = "auto";  // tile 文件读取方式：auto | uring | threads
+	int ioThreads = 4;             // threads 读取方式的线程数
+	int ioDepth = 64;              // io_uring 同时在途的读请求数
+	int parseThreads = 0;          // tile 解析线程数，0 表示使用硬件线程数
+	int loadBufferMb = 512;        // 已读取未解析数据的上限(MB)
+	int memoryBudgetMb = 0;        // > 0 时启用核外模式，常驻 tile 的内存上限(MB)
+	int numShards = 1;             // plan 模式的分片数
+	int shardIndex = -1;           // shard 模式处理的分片序号
+	std::string shardDir = "shards";  // 分片清单与部分结果所在目录，多机运行时放在共享存储上
+	std::string checkpointFile;    // 断点日志，每张照片完成时追加结果
+	bool resume = false;           // 从已有断点日志继续，跳过其中已完成的照片
+	std::string incrementalFile;   // 增量状态文件：tile 内容哈希与照片的依赖和结果，只重算受变化 tile 影响的照片
+	std::string resultCacheDir;    // 本地结果缓存目录，按照片位姿与内参、采样参数和候选 tile 内容寻址
+	int resultCacheMb = 1024;      // 结果缓存的大小上限(MB)，超出时淘汰最久未用的结果
+	std::string rayLabelsFile;     // 写出逐射线 tile 标签，供下次位姿微调后增量更新
+	std::string previousXmlFile;   // 位姿增量模式：上次运行的空三 xml，与 previousRayLabels 一起使用
+	std::string previousRayLabels; // 上次运行写出的逐射线标签
+	double deltaMaxShift = 0.2;    // 相机中心位移超过此值(场景单位)的照片整张重算
+	double deltaMaxRotation = 0.05;  // 旋转超过此值(度)的照片整张重算
+	int deltaBand = 1;             // 标签边界重算带在估计像素位移之外的额外格数
+	std::string tileCache;         // bvh 引擎的共享 tile 缓存文件，有效时映射它代替加载场景，否则构建后写出
+	std::string outputCsv = "output.csv";
+	std::string outputFormat = "sparse";  // sparse | binary | dense
+	int photoBegin = 655;          // 处理的照片区间 [photoBegin, photoEnd)
+	int photoEnd = 656;
+	int rayStep = 128;             // 像素射线采样步长
+	double rayLength = 0.0;        // 射线长度，<= 0 时按候选 tile 包围盒自动裁剪
+	bool computeCoverage = false;  // 计算每张照片的 tile 占比并输出
+	std::string coverageEngine = "osg";  // 占比计算引擎，可选名称见 getCoverageEngineNames()
+	bool useTileGrid = true;       // tile 名称构成规则网格时按 2D DDA 访问 tile（osg 引擎与阈值细化）
+	bool buildKdTrees = false;     // 加载时构建 osg::KdTree，osgkd 引擎总是构建
+	int bvhWidth = 8;              // bvh 引擎的节点宽度，4 或 8
+	double dsmCellSize = 0.0;      // dsm 引擎格网尺寸，<= 0 时自动选取
+	bool engineReport = false;     // 与 osg 参考引擎逐射线对比并输出误差
+	bool showViewer = true;        // 处理完成后打开三维窗口
+
+	// bench 模式：在 [photoBegin, photoEnd) 中抽取 benchPhotos 张照片，以 osg 引擎为真值对比
+	std::string benchEngines;      // 逗号分隔的引擎名，为空时对比全部引擎
+	int benchPhotos = 8;
+	double benchMaxMismatch = 1.0;       // 射线标签不一致率容差(百分比)
+	double benchMaxCoverageError = 1.0;  // tile 占比最大误差容差(百分点)
+
+	// 下游 c.py 的分配阈值(百分比)，以及阈值附近的两遍细化
+	double assignmentThreshold = 20.0;
+	bool thresholdRefinement = false;
+	int coarseStep = 512;          // 粗采样步长，细采样步长沿用 rayStep
+	double refineBand = 2.0;       // 不确定带的最小半宽(百分点)
+
+	// tile 分配：占比超过 assignmentThreshold 的照片放入 assignFolder/<tile>/
+	bool assignTiles = false;
+	std::string assignFolder = "images";
+	std::string assignInput;       // assign 模式读取的结果文件，为空时使用 outputCsv
+	std::string linkMode = "hardlink";  // hardlink | reflink | symlink | copy
+	int assignThreads = 0;         // 0 表示使用硬件线程数
+};
+
+PipelineConfig parsePipelineConfig(int argc, char** argv);
+
+#endif // PIPELINECONFIG_H
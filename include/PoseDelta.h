@@ -0,0 +1,49 @@
+#ifndef POSEDELTA_H
+#define POSEDELTA_H
+
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+#include "CoverageEngine.h"
+#include "PhotoInfoParser.h"
+#include "RayLabelStore.h"
+
+// 重新空三后新旧位姿的差异
+enum class PoseChange {
+	Unchanged,  // 位姿与内参完全相同
+	Small,      // 只有位姿小幅变化
+	Large       // 超出阈值或内参、尺寸变化
+};
+
+struct PoseDeltaOptions {
+	double maxShift = 0.2;            // 相机中心位移上限(场景单位)，超出时整张重算
+	double maxRotationDegrees = 0.05; // 旋转角上限(度)
+	int band = 1;                     // 在估计的像素位移之外再多重算的格子数
+};
+
+PoseChange classifyPoseChange(const PhotoInfo& previous, const PhotoInfo& current, const PoseDeltaOptions& options);
+
+// 与 radius 个格子内任一邻居标签不同、或距图像边缘不超过 radius 个格子的射线，位姿微调后只有它们的标签可能改变
+std::vector<char> markLabelBoundaries(const std::vector<TileId>& labels, int cols, int rows, int radius);
+
+// 位姿增量模式：以上次运行的位姿和逐射线标签为基础求本次的标签。未移动的照片直接沿用标签，
+// 小幅移动只重算标签边界附近的射线（边界宽度按位移与旋转在图像上造成的最大像素位移估计），其余整张重算
+class PoseDeltaTracer {
+public:
+	PoseDeltaTracer(std::vector<PhotoInfo> previousPhotos, std::unordered_map<int, PhotoRayLabels> previousLabels,
+		const osg::BoundingBox& sceneBounds, const PoseDeltaOptions& options);
+
+	// 线程安全，返回与 batch.rays 一一对应的标签
+	std::vector<TileId> trace(const CoverageEngine& engine, const CoverageBatch& batch, int photoIndex) const;
+	void printSummary() const;
+
+private:
+	std::vector<PhotoInfo> previousPhotos;
+	std::unordered_map<int, PhotoRayLabels> previousLabels;
+	osg::BoundingBox sceneBounds;
+	PoseDeltaOptions options;
+	mutable std::atomic<size_t> unchangedPhotos{ 0 }, smallPhotos{ 0 }, fullPhotos{ 0 };
+	mutable std::atomic<size_t> tracedRays{ 0 }, totalRays{ 0 };
+};
+
+#endif // POSEDELTA_H
@@ -0,0 +1,13 @@
+#ifndef PROCESSMEMORY_H
+#define PROCESSMEMORY_H
+
+#include <cstddef>
+
+// 进程当前与峰值常驻内存(字节)，平台不支持时返回 0
+size_t currentResidentBytes();
+size_t peakResidentBytes();
+
+// 把已释放的堆内存归还给系统，使卸载 tile 后的常驻内存测量可信（仅 glibc 生效）
+void releaseFreedMemory();
+
+#endif // PROCESSMEMORY_H
@@ -0,0 +1,17 @@
+#ifndef RAYCLIPPING_H
+#define RAYCLIPPING_H
+
+#include <osg/Vec3d>
+#include <osg/BoundingBox>
+#include <vector>
+#include "SceneBuilder.h"
+
+// 射线 origin + t * direction 与包围盒的 slab 求交，命中时返回参数区间 [tmin, tmax]（tmin >= 0）
+bool intersectRayBox(const osg::Vec3d& origin, const osg::Vec3d& direction, const osg::BoundingBox& bbox,
+	double& tmin, double& tmax);
+
+// 将射线裁剪到所有 tile 包围盒并集所覆盖的最紧区间，未命中任何 tile 时返回 false
+bool clipRayToTiles(const osg::Vec3d& origin, const osg::Vec3d& direction, const std::vector<NamedBoundingBox>& tiles,
+	double& tmin, double& tmax);
+
+#endif // RAYCLIPPING_H
@@ -6,21 +6,35 @@
 #include <osg/Vec3d>
 #include <vector>
 #include <string>
-#include <map>
+#include <cstdint>
+#include "TileBroadPhase.h"
+#include "SceneBuilder.h"
 
-struct IntersectionDetail {
-	std::vector<std::string> tileNames; // Tile names that a ray intersects
+// 一条射线命中的 TileId 在 IntersectionResults::tileIds 中的区间
+struct RayHitSpan {
+	uint32_t offset;
+	uint32_t count;
 };
 
-typedef std::map<osg::Vec3d, IntersectionDetail> IntersectionResults;
+// 按射线下标寻址的求交结果：spans[i] 对应 rays[i]，所有命中的 tile 编号连续存放在 tileIds 中，
+// 每条射线的命中按由近到远排列
+struct IntersectionResults {
+	std::vector<RayHitSpan> spans;
+	std::vector<TileId> tileIds;
+
+	size_t numRays() const { return spans.size(); }
+	const TileId* hitsBegin(size_t ray) const { return tileIds.data() + spans[ray].offset; }
+	const TileId* hitsEnd(size_t ray) const { return hitsBegin(ray) + spans[ray].count; }
+};
 
 class RayIntersection {
 public:
-	RayIntersection(osg::ref_ptr<osg::Group> sceneRoot, const std::map<std::string, osg::BoundingBox>& tileBoundingBoxes);
-	IntersectionResults calculateIntersections(const osg::Vec3& cameraCenter, const std::vector<osg::Vec3d>& rays);
+	RayIntersection(osg::ref_ptr<osg::Group> sceneRoot, const std::vector<NamedBoundingBox>& tileBoundingBoxes);
+	IntersectionResults calculateIntersections(const osg::Vec3d& cameraCenter, const std::vector<osg::Vec3d>& rays);
 private:
 	osg::ref_ptr<osg::Group> sceneRoot;
-	std::map<std::string, osg::BoundingBox> tileBoundingBoxes;
+	std::vector<TileId> tileIds;  // 宽相位下标到 TileId 的映射
+	TileBroadPhase broadPhase;
 	osg::ref_ptr<osg::Node> getNodeByName(osg::Group* group, const std::string& name);
 };
 
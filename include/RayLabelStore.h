@@ -0,0 +1,49 @@
+#ifndef RAYLABELSTORE_H
+#define RAYLABELSTORE_H
+
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "SceneBuilder.h"
+
+// 逐射线 tile 标签文件，供位姿微调后的增量更新使用。标签按行程编码，通常只占原始大小的几个百分点。
+//   格式：魔数 "PMRL" + 版本号，u32 长度 + 运行参数键，tile 表 (u32 数量, 每项 u16 长度 + 名称 + u64 内容哈希)，
+//   之后每张照片 (i32 序号, u64 记录键, u32 列数, u32 行数, u32 候选 tile 数 + 各 tileId,
+//   u32 行程数 + 每项 u32 tileId + u32 长度)。记录键由运行参数键与候选 tile 的名称、内容哈希计算
+struct PhotoRayLabels {
+	uint32_t cols = 0, rows = 0;
+	std::vector<TileId> candidates;                  // 候选 tile，按编号排列
+	std::vector<std::pair<TileId, uint32_t>> runs;   // (标签, 连续射线数)
+
+	// 展开为 cols * rows 个行优先的标签
+	std::vector<TileId> decode() const;
+};
+
+class RayLabelWriter {
+public:
+	// builder 须已计算 tile 内容哈希（SceneBuilder::computeTileContentHashes），并在写入期间保持有效
+	RayLabelWriter(const std::string& filename, const std::string& runKey, const SceneBuilder& builder);
+	~RayLabelWriter();
+	// 关闭文件，写入失败时抛出异常
+	void close();
+
+	// 线程安全；labels 须为 cols * rows 个行优先的标签
+	void writePhoto(int photoIndex, uint32_t cols, uint32_t rows, const std::vector<NamedBoundingBox>& candidates,
+		const std::vector<TileId>& labels);
+
+private:
+	std::FILE* file;
+	std::string filename;
+	std::string runKey;
+	const SceneBuilder& builder;
+	std::mutex mutex;
+};
+
+// 读回标签文件，tileId 按名称映射到 builder 的编号。运行参数键不同时整个文件不可用，返回空表；
+// 含有当前场景中不存在或内容已变化的 tile、或记录键不符的照片被丢弃，这些照片整张重算
+std::unordered_map<int, PhotoRayLabels> readRayLabels(const std::string& filename, const std::string& runKey, const SceneBuilder& builder);
+
+#endif // RAYLABELSTORE_H
@@ -0,0 +1,46 @@
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "PhotoInfoParser.h"
+#include "SceneBuilder.h"
+#include "TileIntersectionCalculator.h"
+
+// 本地内容寻址的照片结果缓存：键为照片位姿与内参、采样参数、候选 tile 名称与内容哈希的签名，
+// 与 xml、mesh 目录的路径无关，换阈值或照片子集重跑时输入相同的照片直接命中。
+//   目录结构：<dir>/tiles.txt 为上次扫描的 tile 摘要（增量状态格式，只含 T 行），供下次跳过未变化 tile 的解析；
+//   每个结果一个文件 <dir>/<16 位十六进制键>.res：魔数 "PMRC" + 版本号，u64 键，u32 结果数，每项 u16 长度 + tile 名称 + f64 占比。
+// 总大小超过上限时按最近使用时间（命中时刷新文件修改时间）淘汰最久未用的结果，直到低于上限的 90%
+class ResultCache {
+public:
+	// parametersKey 为影响结果的采样与引擎参数
+	ResultCache(const std::string& directory, const std::string& parametersKey, uint64_t maxBytes);
+
+	// tiles 为按编号排列的候选 tile，builder 须已计算内容哈希（带 knownTiles 的 scanScene）
+	uint64_t photoKey(const PhotoInfo& photoInfo, const std::vector<TileId>& tiles, const SceneBuilder& builder) const;
+	// 以下均线程安全。未命中、文件损坏或含有当前场景中不存在的 tile 时返回 false
+	bool lookup(uint64_t key, const TileRegistry& registry, std::vector<TileIntersectionResult>& results);
+	void store(uint64_t key, const TileRegistry& registry, const std::vector<TileIntersectionResult>& results);
+
+	std::vector<TileSummary> readTileIndex() const;
+	void writeTileIndex(const SceneBuilder& builder) const;
+	void printSummary() const;
+
+private:
+	std::string entryPath(uint64_t key) const;
+	// 调用者持有 mutex
+	void evict();
+
+	std::string directory;
+	std::string parametersKey;
+	uint64_t maxBytes;
+	uint64_t totalBytes = 0;
+	std::mutex mutex;
+	std::atomic<size_t> hits{ 0 }, misses{ 0 }, stored{ 0 }, evicted{ 0 };
+};
+
+#endif // RESULTCACHE_H
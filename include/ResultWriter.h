@@ -0,0 +1,54 @@
+#ifndef RESULTWRITER_H
+#define RESULTWRITER_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdio>
+#include "TileIntersectionCalculator.h"
+#include "TileRegistry.h"
+
+// 稀疏结果格式
+//   SparseText:   文本，开头为 "T,<tileId>,<tileName>" 的 tile 表，之后每张照片一行
+//                 "P,<photoIndex>,<imagePath>"，并为每个非零占比写一行 "C,<photoIndex>,<tileId>,<percentage>"；
+//                 名称与路径含逗号、引号或换行时按 CSV 规则加双引号
+//   SparseBinary: 魔数 "PMSR" + 版本号，tile 表 (u32 数量, 每项 u16 长度 + 名称)，
+//                 之后每张照片 (i32 序号, u16 长度 + 路径, u32 非零数, 每项 u32 tileId + f32 占比)；名称或路径超过 65535 字节时抛出异常
+enum class ResultFormat {
+	SparseText,
+	SparseBinary
+};
+
+// 照片完成后立即追加写出，内存与输出大小只与非零 (photo, tile) 对的数量有关
+class SparseResultWriter {
+public:
+	SparseResultWriter(const std::string& filename, const TileRegistry& registry, ResultFormat format);
+	~SparseResultWriter();
+
+	// 线程安全，可在各个照片线程中直接调用
+	void writePhoto(const PhotoData& photoData);
+	// 写出缓冲并刷新到文件，写入失败（如磁盘已满）时抛出异常
+	void flush();
+
+private:
+	void appendText(const PhotoData& photoData);
+	void appendBinary(const PhotoData& photoData);
+	void appendBytes(const void* data, size_t size);
+	void flushLocked();
+
+	std::FILE* file;
+	std::string filename;
+	ResultFormat format;
+	std::vector<char> buffer;
+	std::mutex mutex;
+};
+
+// 读回稀疏结果文件（文本或二进制），intersectionResults 中的 tileId 对应 tileNames 的下标
+struct SparseResults {
+	std::vector<std::string> tileNames;
+	std::vector<PhotoData> photos;
+};
+
+SparseResults readSparseResults(const std::string& filename);
+
+#endif // RESULTWRITER_H
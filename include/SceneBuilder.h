@@ -6,13 +6,32 @@
 #include <osg/BoundingBox>
 #include <string>
 #include <map>
+#include <vector>
+#include <functional>
+#include "TileRegistry.h"
+#include "TileGrid.h"
+#include "TileLoader.h"
 
-// 定义用于存储命名包围盒的结构体
+// 定义用于存储命名包围盒的结构体，名称通过 TileRegistry 由编号解析
 struct NamedBoundingBox {
+	TileId id;
+	osg::BoundingBox bbox;
+};
+
+// 不读取 tile 内容即可恢复场景登记所需的信息，由共享 tile 缓存提供
+struct TileSummary {
 	std::string name;
 	osg::BoundingBox bbox;
+	size_t triangles;
+	uint64_t sourceStamp = 0;  // tileSourceStamp() 的结果，用于判断缓存是否过期
+	uint64_t contentHash = 0;  // tileContentHash() 的结果，用于增量重算
 };
 
+// 由 tile 文件的名称、大小和修改时间计算的签名，任一文件变化时改变
+uint64_t tileSourceStamp(const std::vector<std::string>& files);
+// 由 tile 文件名与文件内容计算的哈希，只在内容变化时改变
+uint64_t tileContentHash(const std::vector<std::string>& files);
+
 // 定义用于打印和计算包围盒的访问器类
 class BBoxPrinter : public osg::NodeVisitor {
 public:
@@ -28,13 +47,69 @@ private:
 class SceneBuilder {
 public:
 	SceneBuilder();
+	// 加载时为每个 tile 的几何体构建 osg::KdTree，须在 buildScene 之前设置
+	void setBuildKdTrees(bool enabled) { buildKdTrees = enabled; }
+	bool getBuildKdTrees() const { return buildKdTrees; }
+	// 读取与解析的并发度及读取缓冲上限，须在 buildScene 之前设置
+	void setLoadOptions(const TileLoadOptions& options) { loadOptions = options; }
+	// 每个 tile 读取完成后在加载线程中调用，须线程安全
+	void setTileLoadedCallback(std::function<void(const std::string&, osg::Node*)> callback) { tileLoadedCallback = callback; }
 	osg::ref_ptr<osg::Group> buildScene(const std::string& meshFolderPath);
+	// 核外模式：只扫描 tile 的 obj 文本，登记编号、包围盒和三角形数而不构建场景图，getTileNodes() 全部为空，
+	// 之后用 loadTiles / unloadTiles 控制常驻的 tile。
+	// 给定 knownTiles 时计算每个 tile 的内容哈希（getTileContentHashes），文件签名与摘要一致的 tile 沿用摘要中的哈希，
+	// 内容与摘要一致的 tile 不再扫描
+	void scanScene(const std::string& meshFolderPath, const std::vector<TileSummary>* knownTiles = nullptr);
+	// 加载尚未常驻的 tile，每个 tile 完成时同样触发 tileLoadedCallback
+	void loadTiles(const std::vector<TileId>& ids);
+	// 按缓存中的摘要登记 tile，不读取 tile 文件，getTileNodes() 全部为空；
+	// 目录中的 tile 与摘要不一致或文件签名不同时不做任何登记并返回 false
+	bool restoreScene(const std::string& meshFolderPath, const std::vector<TileSummary>& summaries);
+	void unloadTiles(const std::vector<TileId>& ids);
+	bool isTileLoaded(TileId id) const { return id < tileNodes.size() && tileNodes[id].valid(); }
+	// 以 TileId 为下标的三角形数，只由 scanScene 与 restoreScene 提供，核外模式据此估计 tile 的内存占用
+	const std::vector<size_t>& getTileTriangleCounts() const { return tileTriangles; }
+	// 以 TileId 为下标的 tile 文件列表
+	const std::vector<std::vector<std::string>>& getTileFilePaths() const { return tileFilePaths; }
+	// 以 TileId 为下标的内容哈希，由带 knownTiles 的 scanScene 或 computeTileContentHashes 计算
+	const std::vector<uint64_t>& getTileContentHashes() const { return tileContentHashes; }
+	// 以 TileId 为下标的文件签名（tileSourceStamp），由 scanScene 与 restoreScene 提供
+	const std::vector<uint64_t>& getTileSourceStamps() const { return tileSourceStamps; }
+	// 为尚未计算内容哈希的 tile 补算（buildScene、restoreScene 与不带 knownTiles 的 scanScene 不计算）
+	void computeTileContentHashes();
 	void printTileBoundingBoxes() const;
 	osg::ref_ptr<osg::Group> createBoundingBoxGeometry();
 	double calculateHeightThreshold() const;
+	// 下标即 TileId
 	const std::vector<NamedBoundingBox>& getTileBoundingBoxes() const;
+	const std::vector<osg::ref_ptr<osg::Node>>& getTileNodes() const { return tileNodes; }
+	const TileRegistry& getTileRegistry() const { return tileRegistry; }
+	// 由 Tile_XXXX_YYYY 名称恢复的地面网格，名称不规则时 isValid() 为 false
+	const TileGrid& getTileGrid() const { return tileGrid; }
+	// 所有 tile 包围盒的并集
+	osg::BoundingBox getSceneBoundingBox() const;
 private:
+	void listTileFolders(const std::string& meshFolderPath, std::vector<std::string>& tileFolderNames,
+		std::vector<std::vector<std::string>>& tileFiles) const;
+	// 用 TileLoader 加载一组 tile，每个 tile 的全部文件完成时在解析线程中调用 onTile(下标, 节点, 包围盒)
+	void loadTileGroups(const std::vector<std::string>& tileFolderNames, const std::vector<std::vector<std::string>>& tileFiles,
+		const std::function<void(size_t, osg::ref_ptr<osg::Group>, const osg::BoundingBox&)>& onTile) const;
+	void finishRegistration();
+
+	TileRegistry tileRegistry;
 	std::vector<NamedBoundingBox> tileBoundingBoxes;
+	std::vector<osg::ref_ptr<osg::Node>> tileNodes;
+	std::vector<std::vector<std::string>> tileFilePaths;  // 以 TileId 为下标
+	std::vector<size_t> tileTriangles;
+	std::vector<uint64_t> tileContentHashes;
+	std::vector<uint64_t> tileSourceStamps;
+	TileGrid tileGrid;
+	bool buildKdTrees;
+	TileLoadOptions loadOptions;
+	std::function<void(const std::string&, osg::Node*)> tileLoadedCallback;
 };
 
+// 并行为已加载的 tile 构建 osg::KdTree，IntersectionVisitor 求交时自动使用
+void buildTileKdTrees(const std::vector<osg::ref_ptr<osg::Node>>& tileNodes);
+
 #endif // SCENEBUILDER_H
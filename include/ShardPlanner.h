@@ -0,0 +1,41 @@
+#ifndef SHARDPLANNER_H
+#define SHARDPLANNER_H
+
+#include <string>
+#include <vector>
+#include "ResultWriter.h"
+
+// 一张照片的估计处理开销，位置用于让同一分片的照片在地面上相邻
+struct PhotoCost {
+	int photoIndex;
+	double groundX, groundZ;
+	double cost;
+};
+
+// 分片清单，所有进程通过共享存储上的 <shardDir>/manifest.txt 协调
+//   文本格式：注释行以 # 开头；"xml,<路径>"、"mesh,<路径>"、"shards,<数量>"，
+//   之后每张照片一行 "S,<分片>,<photoIndex>"
+struct ShardManifest {
+	std::string xmlFile;
+	std::string meshFolder;
+	std::vector<std::vector<int>> shardPhotos;
+	std::vector<double> shardCosts;
+};
+
+// 照片按地面 Morton 序排列后切成开销均衡的连续段，每段一个分片
+ShardManifest planShards(const std::vector<PhotoCost>& photos, int numShards);
+
+// 写入新清单前删除目录中旧的分片结果与 .done 标记
+void writeShardManifest(const std::string& shardDir, const ShardManifest& manifest);
+ShardManifest readShardManifest(const std::string& shardDir);
+
+// 分片的部分结果先写到 shardResultPath() + ".tmp"，完成后由 commitShardResult 改名并写 .done 标记
+// （照片数与照片列表签名），合并只认带标记的分片，中途退出的进程重跑即可
+std::string shardResultPath(const std::string& shardDir, int shard);
+void commitShardResult(const std::string& shardDir, int shard, const std::vector<int>& photoIndices);
+
+// 合并所有分片的部分结果，tile 按名称统一编号，照片按序号排序；
+// 缺少分片、标记与清单不符或结果中有清单外、重复的照片时抛出异常
+SparseResults mergeShardResults(const std::string& shardDir, const ShardManifest& manifest);
+
+#endif // SHARDPLANNER_H
@@ -0,0 +1,64 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 固定数量工作线程的任务池，场景加载与加速结构构建共用 ThreadPool::shared()
+class ThreadPool {
+public:
+	// numThreads 为 0 时使用硬件线程数
+	explicit ThreadPool(unsigned int numThreads = 0);
+	~ThreadPool();
+
+	void submit(std::function<void()> task);
+	unsigned int size() const { return static_cast<unsigned int>(workers.size()); }
+
+	static ThreadPool& shared();
+
+private:
+	void workerLoop();
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stopping;
+};
+
+// 一组提交到同一线程池的任务，wait 返回时全部完成；任务抛出的第一个异常在 wait 中重新抛出。
+// 任务先进本组的队列，线程池中只排一个取任务的入口。等待的线程只协助执行本组的任务，
+// 工作线程内嵌套等待不会死锁，也不会把无关的任务压到自己的栈上
+class TaskGroup {
+public:
+	explicit TaskGroup(ThreadPool& pool) : pool(pool), state(std::make_shared<State>()) {}
+	~TaskGroup() { waitNoThrow(); }
+
+	void run(std::function<void()> task);
+	void wait();
+
+private:
+	// 入口任务可能在组析构之后才被工作线程取到，因此状态由入口任务共同持有
+	struct State {
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::deque<std::function<void()>> tasks;
+		int pending = 0;
+		std::exception_ptr error;
+	};
+	// 从本组队列取一个任务执行，fromBack 为 true 时取最近提交的任务
+	static bool runOne(State& state, bool fromBack);
+	void waitNoThrow();
+
+	ThreadPool& pool;
+	std::shared_ptr<State> state;
+};
+
+#endif // THREADPOOL_H
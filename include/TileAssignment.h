@@ -0,0 +1,39 @@
+#ifndef TILEASSIGNMENT_H
+#define TILEASSIGNMENT_H
+
+#include <string>
+#include <vector>
+#include "TileIntersectionCalculator.h"
+
+// 照片落到 tile 目录的方式；硬链接/reflink 只在跨文件系统或文件系统不支持时退回到复制，其他错误直接报告
+enum class LinkMode {
+	Hardlink,
+	Reflink,
+	Symlink,
+	Copy
+};
+
+LinkMode parseLinkMode(const std::string& name);
+
+struct TileAssignmentOptions {
+	std::string outputFolder;   // 每个 tile 在其下建立同名子目录
+	double threshold;           // 占比大于该值(百分比)的照片分配给 tile
+	LinkMode linkMode;
+	unsigned int numThreads;    // 0 表示使用硬件线程数
+};
+
+struct TileAssignmentStats {
+	size_t assignedPairs = 0;
+	size_t linked = 0;          // 硬链接、reflink 或符号链接
+	size_t copied = 0;
+	size_t failed = 0;
+};
+
+// 代替 c.py：为每个 tile 写 photo_indices.txt，并按 linkMode 并行地把照片放入 tile 目录
+// photos 中的 tileId 是 tileNames 的下标
+TileAssignmentStats assignPhotosToTiles(
+	const std::vector<PhotoData>& photos,
+	const std::vector<std::string>& tileNames,
+	const TileAssignmentOptions& options);
+
+#endif // TILEASSIGNMENT_H
@@ -0,0 +1,41 @@
+#ifndef TILEBROADPHASE_H
+#define TILEBROADPHASE_H
+
+#include <osg/BoundingBox>
+#include <osg/Vec3d>
+#include <vector>
+#include <cstdint>
+
+// 射线与某个 tile 包围盒的相交区间，tileId 为构建时包围盒的下标
+struct TileHit {
+	uint32_t tileId;
+	float tEnter;
+	float tExit;
+};
+
+// 以 SoA 布局存放所有 tile 包围盒，编译时启用 AVX2 则每次对 8 个包围盒做 slab 测试
+// 包围盒以并集中心为局部原点存为 float，射线起点在 double 下平移后再转 float
+class TileBroadPhase {
+public:
+	TileBroadPhase();
+	explicit TileBroadPhase(const std::vector<osg::BoundingBox>& boxes);
+	void build(const std::vector<osg::BoundingBox>& boxes);
+
+	// 求射线 origin + t * direction 在 [tmin, tmax] 内命中的包围盒，结果按进入距离由近到远排序
+	void intersect(const osg::Vec3d& origin, const osg::Vec3d& direction, float tmin, float tmax,
+		std::vector<TileHit>& hits) const;
+
+	size_t size() const { return numBoxes; }
+	const osg::Vec3d& getLocalOrigin() const { return localOrigin; }
+
+private:
+	size_t numBoxes;
+	osg::Vec3d localOrigin;
+	// 长度补齐到 8 的倍数
+	std::vector<float> minX, minY, minZ;
+	std::vector<float> maxX, maxY, maxZ;
+	// 有效包围盒为 -1（全 1），无效包围盒与补齐通道为 0，与命中掩码相与
+	std::vector<int32_t> validMask;
+};
+
+#endif // TILEBROADPHASE_H
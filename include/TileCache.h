@@ -0,0 +1,48 @@
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "MeshBvh.h"
+#include "SceneBuilder.h"
+
+// 只读的 tile 三角网与 BVH 缓存文件。各进程以共享方式映射同一文件，
+// 同一主机上的多个工作进程只占用一份物理内存（页缓存），不再各自加载场景图和构建 BVH。
+//   格式：TileCacheHeader，numTiles 个 TileCacheRecord，之后是 64 字节对齐的名称、顶点、索引、
+//   WideBvhNode 与图元数组；数组按本机内存布局原样存放，头部记录 BVH 宽度与节点大小用于校验
+class TileCache {
+public:
+	~TileCache();
+	TileCache(const TileCache&) = delete;
+	TileCache& operator=(const TileCache&) = delete;
+
+	// 映射缓存文件；文件不存在、格式或 BVH 宽度不符时返回空指针
+	static std::unique_ptr<TileCache> open(const std::string& path, int bvhWidth);
+
+	// 下标与缓存中的 tile 顺序一致，即写出时的 TileId
+	const std::vector<TileSummary>& getTiles() const { return tiles; }
+	// 按名称查找，未找到返回 -1
+	int findTile(const std::string& name) const;
+	// 把 tileBvh 的三角网与 BVH 指向映射的内存
+	template <int Width>
+	void attach(size_t index, TileBvh<Width>& tileBvh) const;
+	size_t mappedBytes() const { return size; }
+
+private:
+	TileCache() {}
+
+	const char* data = nullptr;
+	size_t size = 0;
+	void* mappingHandle = nullptr;  // Windows 的映射对象
+	std::vector<TileSummary> tiles;
+	std::map<std::string, int> tileIndices;
+};
+
+// 把已构建的 tile BVH（以 TileId 为下标，未加载为空指针）写成缓存文件。
+// 先写本进程、本线程独有的临时文件再改名，已映射旧文件的进程不受影响，并发写入的进程各自写完整的文件，最后一个改名的生效
+template <int Width>
+void writeTileCache(const std::string& path, const SceneBuilder& builder, const std::vector<const TileBvh<Width>*>& tileBvhs);
+
+#endif // TILECACHE_H
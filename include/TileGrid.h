@@ -0,0 +1,106 @@
+#ifndef TILEGRID_H
+#define TILEGRID_H
+
+#include <osg/BoundingBox>
+#include <osg/Vec3d>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "TileRegistry.h"
+
+// 解析 ContextCapture 的 Tile_XXXX_YYYY 名称（编号可带正负号），不符合时返回 false
+bool parseTileGridName(const std::string& name, int& gridX, int& gridY);
+
+// 由 tile 名称中的网格编号和包围盒恢复地面上的规则网格（场景坐标 x、z 平面）。
+// 网格覆盖所有 tile 包围盒的并集，每个格子记录与其重叠的 tile，tile 越出自身格子的部分也能被找到
+class TileGrid {
+public:
+	TileGrid();
+
+	// names 与 boxes 都以 TileId 为下标；任一 tile 名称不符合网格命名或编号与位置不一致时网格无效
+	void build(const std::vector<std::string>& names, const std::vector<osg::BoundingBox>& boxes);
+	bool isValid() const { return valid; }
+
+	// 按名称中的网格编号 O(1) 查找 tile，不存在返回 kInvalidTileId
+	TileId tileAt(int gridX, int gridY) const;
+
+	int getColumns() const { return columns; }
+	int getRows() const { return rows; }
+	double getCellSizeX() const { return cellSizeX; }
+	double getCellSizeZ() const { return cellSizeZ; }
+
+	// 按 2D DDA 由近到远访问线段 start→end 在地面投影上经过的格子。
+	// fn(const TileId* tiles, size_t count, double tEnter, double tExit) 返回 false 时停止，t 为线段参数
+	template <typename Fn>
+	void traverse(const osg::Vec3d& start, const osg::Vec3d& end, Fn fn) const;
+
+private:
+	bool valid;
+	int columns, rows;
+	double originX, originZ;      // 网格左下角
+	double cellSizeX, cellSizeZ;
+	// 格子 (cx, cz) 的 tile 列表为 cellTiles[cellStart[i], cellStart[i + 1])，i = cz * columns + cx
+	std::vector<uint32_t> cellStart;
+	std::vector<TileId> cellTiles;
+	// 名称编号到 TileId，以 (gridY - minGridY) * gridColumns + (gridX - minGridX) 为下标
+	int minGridX, minGridY, gridColumns, gridRows;
+	std::vector<TileId> nameIndex;
+};
+
+template <typename Fn>
+void TileGrid::traverse(const osg::Vec3d& start, const osg::Vec3d& end, Fn fn) const {
+	if (!valid) return;
+	const double dx = end.x() - start.x(), dz = end.z() - start.z();
+	const double width = columns * cellSizeX, depth = rows * cellSizeZ;
+
+	// 先把线段裁剪到网格矩形
+	double t0 = 0.0, t1 = 1.0;
+	const double px = start.x() - originX, pz = start.z() - originZ;
+	const double deltas[2] = { dx, dz }, offsets[2] = { px, pz }, extents[2] = { width, depth };
+	for (int axis = 0; axis < 2; ++axis) {
+		if (deltas[axis] == 0.0) {
+			if (offsets[axis] < 0.0 || offsets[axis] > extents[axis]) return;
+			continue;
+		}
+		double a = -offsets[axis] / deltas[axis], b = (extents[axis] - offsets[axis]) / deltas[axis];
+		if (a > b) std::swap(a, b);
+		t0 = std::max(t0, a);
+		t1 = std::min(t1, b);
+		if (t0 > t1) return;
+	}
+
+	const double enterX = px + dx * t0, enterZ = pz + dz * t0;
+	int cx = std::min(columns - 1, std::max(0, static_cast<int>(std::floor(enterX / cellSizeX))));
+	int cz = std::min(rows - 1, std::max(0, static_cast<int>(std::floor(enterZ / cellSizeZ))));
+	const int stepX = dx > 0.0 ? 1 : -1, stepZ = dz > 0.0 ? 1 : -1;
+	const double inf = std::numeric_limits<double>::infinity();
+	// 到下一条格线的线段参数，以及跨过一个格子的参数增量
+	double tNextX = dx == 0.0 ? inf : ((cx + (stepX > 0 ? 1 : 0)) * cellSizeX - px) / dx;
+	double tNextZ = dz == 0.0 ? inf : ((cz + (stepZ > 0 ? 1 : 0)) * cellSizeZ - pz) / dz;
+	const double tDeltaX = dx == 0.0 ? inf : cellSizeX / std::fabs(dx);
+	const double tDeltaZ = dz == 0.0 ? inf : cellSizeZ / std::fabs(dz);
+
+	double tEnter = t0;
+	while (true) {
+		const double tExit = std::min(t1, std::min(tNextX, tNextZ));
+		const size_t cell = static_cast<size_t>(cz) * columns + cx;
+		const uint32_t first = cellStart[cell];
+		if (!fn(cellTiles.data() + first, static_cast<size_t>(cellStart[cell + 1] - first), tEnter, tExit)) return;
+		if (tExit >= t1) return;
+		if (tNextX < tNextZ) {
+			cx += stepX;
+			tEnter = tNextX;
+			tNextX += tDeltaX;
+		}
+		else {
+			cz += stepZ;
+			tEnter = tNextZ;
+			tNextZ += tDeltaZ;
+		}
+		if (cx < 0 || cx >= columns || cz < 0 || cz >= rows) return;
+	}
+}
+
+#endif // TILEGRID_H
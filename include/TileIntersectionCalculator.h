@@ -4,33 +4,78 @@
 #include <osg/Group>
 #include <osgUtil/IntersectVisitor>
 #include <osgUtil/LineSegmentIntersector>
+#include <osgUtil/IntersectionVisitor>
 #include <map>
 #include <vector>
 #include <string>
 #include "SceneBuilder.h"
+#include "TileRegistry.h"
 #include "PhotoInfoParser.h"
 
+class Camera;
+
 // 定义输出结果的结构体
 struct TileIntersectionResult {
-	std::string tileName;
+	TileId tileId;
 	double percentage;
 };
 
+// 阈值细化参数：粗采样估计离阈值不足 band 的 tile 才按细步长重新采样
+struct ThresholdRefinementOptions {
+	double threshold;   // 下游判定阈值(百分比)
+	int coarseStep;     // 粗采样步长(像素)
+	int fineStep;       // 细采样步长(像素)
+	double minBand;     // 不确定带的最小半宽(百分点)
+	double rayLength;   // <= 0 时射线裁剪到候选 tile 包围盒
+};
+
 struct PhotoData {
 	int index;
 	std::string imagePath;
 	std::vector<TileIntersectionResult> intersectionResults;
 };
 
+// 函数声明：求每条射线最先击中的 tile，未击中为 kInvalidTileId；
+// tileGrid 有效时按网格 2D DDA 由近到远访问 tile，否则扫描候选 tile 的包围盒
+std::vector<TileId> traceRayTiles(
+	const std::vector<osg::ref_ptr<osg::Node>>& tileNodes,
+	const std::vector<std::pair<osg::Vec3d, osg::Vec3d>>& pixelRays,
+	const std::vector<NamedBoundingBox>& intersectingTiles,
+	const TileGrid* tileGrid = nullptr);
+
+// 函数声明：与 traceRayTiles 结果相同，但把一段射线按 tile 分组放入 IntersectorGroup，
+// 每个 tile 子树只遍历一次并使用 KdTree（若已构建）；numThreads 为 0 时使用共享线程池的线程数
+std::vector<TileId> traceRayTilesBatched(
+	const std::vector<osg::ref_ptr<osg::Node>>& tileNodes,
+	const std::vector<std::pair<osg::Vec3d, osg::Vec3d>>& pixelRays,
+	const std::vector<NamedBoundingBox>& intersectingTiles,
+	unsigned int numThreads = 0);
+
+// 函数声明：由逐射线的命中 tile 统计每个候选 tile 的射线占比
+std::vector<TileIntersectionResult> aggregateTileCoverage(
+	const std::vector<TileId>& rayTiles,
+	const std::vector<NamedBoundingBox>& intersectingTiles);
+
 // 函数声明：计算射线与 Tile 的碰撞检测并返回每个 Tile 的射线占比
+// tileNodes 以 TileId 为下标，由 SceneBuilder::getTileNodes 提供
 std::vector<TileIntersectionResult> performRayTileIntersections(
-	const osg::ref_ptr<osg::Group>& scene,
+	const std::vector<osg::ref_ptr<osg::Node>>& tileNodes,
 	const std::vector<std::pair<osg::Vec3d, osg::Vec3d>>& pixelRays,
-	const std::vector<NamedBoundingBox>& intersectingTiles);
+	const std::vector<NamedBoundingBox>& intersectingTiles,
+	const TileGrid* tileGrid = nullptr);
+
+// 函数声明：两遍采样，只对占比接近阈值的 tile 进行细化
+std::vector<TileIntersectionResult> performThresholdRefinedIntersections(
+	const std::vector<osg::ref_ptr<osg::Node>>& tileNodes,
+	const Camera& camera,
+	const std::vector<NamedBoundingBox>& intersectingTiles,
+	const ThresholdRefinementOptions& options,
+	const TileGrid* tileGrid = nullptr);
 
+// 每个注册的 tile 一列，列名在输出时由 registry 解析
 void outputIntersectionResultsToCSV(
 	const std::string& filename,
 	const std::vector<PhotoData>& allPhotoData,
-	const std::vector<std::string>& tileNames);
+	const TileRegistry& registry);
 
 #endif // RAY_TILE_INTERSECTIONS_H
@@ -0,0 +1,43 @@
+#ifndef TILELOADER_H
+#define TILELOADER_H
+
+#include <osg/Node>
+#include <osg/ref_ptr>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// 读取与解析分开限流：读取层（io_uring 或 ioThreads 个线程）把整个文件读入内存，parseThreads 个线程从内存解析。
+// 已读未解析的数据不超过 maxBufferedBytes（单个文件超过上限时仍可独占读入）
+struct TileLoadOptions {
+	std::string ioBackend = "auto";  // auto | uring | threads，见 createAsyncFileReader
+	unsigned int ioThreads = 4;
+	unsigned int queueDepth = 64;
+	unsigned int parseThreads = 0;  // 0 表示使用硬件线程数
+	size_t maxBufferedBytes = static_cast<size_t>(512) << 20;
+};
+
+struct TileLoadStats {
+	size_t files = 0;
+	size_t failed = 0;
+	uint64_t bytesRead = 0;
+	double readSeconds = 0.0;   // 最后一个文件读完的时间，用于计算读取带宽
+	double seconds = 0.0;
+	const char* backend = "";
+};
+
+class TileLoader {
+public:
+	explicit TileLoader(const TileLoadOptions& options);
+
+	// 按下标顺序发起读取，onParsed(fileIndex, node) 在解析线程中调用，读取或解析失败时 node 为空。
+	// 结果由调用方写入按下标预分配的槽位，与完成顺序无关
+	TileLoadStats load(const std::vector<std::string>& files,
+		const std::function<void(size_t, osg::ref_ptr<osg::Node>)>& onParsed) const;
+
+private:
+	TileLoadOptions options;
+};
+
+#endif // TILELOADER_H
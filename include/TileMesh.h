@@ -0,0 +1,25 @@
+#ifndef TILEMESH_H
+#define TILEMESH_H
+
+#include <osg/Node>
+#include <osg/Vec3f>
+#include <osg/BoundingBox>
+#include <vector>
+#include <cstdint>
+
+// 一个 tile 的三角网：顶点与三角形索引（每 3 个索引构成一个三角形），供不依赖场景图的求交引擎使用
+struct TileMesh {
+	std::vector<osg::Vec3f> vertices;
+	std::vector<uint32_t> indices;
+	osg::BoundingBox bbox;
+
+	size_t numTriangles() const { return indices.size() / 3; }
+};
+
+// 遍历 tile 节点下所有 Geometry，收集三角形（与 performRayTileIntersections 一样不考虑变换节点）
+TileMesh extractTileMesh(osg::Node* tileNode);
+
+// 并行提取所有 tile 的三角网，下标与 tileNodes 一致
+std::vector<TileMesh> extractTileMeshes(const std::vector<osg::ref_ptr<osg::Node>>& tileNodes);
+
+#endif // TILEMESH_H
@@ -0,0 +1,41 @@
+#ifndef TILERASTERIZER_H
+#define TILERASTERIZER_H
+
+#include <vector>
+#include "Camera.h"
+#include "TileMesh.h"
+#include "TileRegistry.h"
+#include "TileIntersectionCalculator.h"
+
+// 降采样的深度 + TileId 缓冲，ids[row * stride + col] 对应图像像素 (col * step, row * step)，
+// 与 calculatePartialPixelRays(step, ...) 的采样点一一对应
+struct TileIdBuffer {
+	int cols = 0;
+	int rows = 0;
+	int stride = 0;                  // 行宽补齐到 8 的倍数
+	int step = 1;
+	std::vector<TileId> ids;         // kInvalidTileId 表示该采样点没有被任何 tile 覆盖
+	std::vector<float> inverseDepth; // 1 / 深度，0 表示无穷远
+
+	TileId at(int col, int row) const { return ids[row * stride + col]; }
+};
+
+// 把候选 tile 的三角形经相机模型投影后光栅化，每个采样点保留最近的 tile，
+// 用 TileId 缓冲的直方图得到每个 tile 的像素占比。屏幕按 bin 划分，各线程独占不同的 bin
+class TileRasterizer {
+public:
+	// meshes 以 TileId 为下标，生命周期须长于光栅化器；任务在共享线程池中执行，numThreads 为 0 时按线程池的线程数划分
+	explicit TileRasterizer(const std::vector<TileMesh>& meshes, unsigned int numThreads = 0);
+
+	void rasterize(const Camera& camera, const std::vector<NamedBoundingBox>& intersectingTiles, int step,
+		TileIdBuffer& buffer) const;
+
+	std::vector<TileIntersectionResult> computeCoverage(const Camera& camera,
+		const std::vector<NamedBoundingBox>& intersectingTiles, int step) const;
+
+private:
+	const std::vector<TileMesh>& meshes;
+	unsigned int numThreads;
+};
+
+#endif // TILERASTERIZER_H
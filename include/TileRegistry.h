@@ -0,0 +1,28 @@
+#ifndef TILEREGISTRY_H
+#define TILEREGISTRY_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+// tile 的稠密整数编号，热路径中的数据结构都以它为下标，名称只在输出时解析
+typedef uint32_t TileId;
+const TileId kInvalidTileId = 0xFFFFFFFFu;
+
+class TileRegistry {
+public:
+	// 注册 tile 名称并返回编号，已注册过的名称返回原编号
+	TileId registerTile(const std::string& name);
+	// 按名称查找编号，未注册返回 kInvalidTileId
+	TileId findTile(const std::string& name) const;
+	const std::string& getTileName(TileId id) const { return names[id]; }
+	const std::vector<std::string>& getTileNames() const { return names; }
+	size_t size() const { return names.size(); }
+
+private:
+	std::vector<std::string> names;
+	std::unordered_map<std::string, TileId> ids;
+};
+
+#endif // TILEREGISTRY_H
@@ -0,0 +1,240 @@
+#include "AsyncFileReader.h"
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#if defined(__linux__) && defined(PHOTOMAPPING_HAVE_LIBURING)
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <liburing.h>
+#endif
+
+static bool readWholeFile(const std::string& path, std::string& data) {
+	std::ifstream file(path.c_str(), std::ios::binary | std::ios::ate);
+	if (!file) return false;
+	std::streamoff size = file.tellg();
+	if (size < 0) return false;
+	data.resize(static_cast<size_t>(size));
+	file.seekg(0, std::ios::beg);
+	return size == 0 || static_cast<bool>(file.read(&data[0], size));
+}
+
+// 退路：多个线程按下标顺序阻塞读取
+class ThreadedFileReader : public AsyncFileReader {
+public:
+	explicit ThreadedFileReader(unsigned int numThreads) : numThreads(std::max(1u, numThreads)) {}
+	const char* name() const override { return "threads"; }
+	void readFiles(const std::vector<std::string>& files, const std::function<void(FileReadResult&&)>& onComplete) override {
+		std::atomic<size_t> nextFile(0);
+		auto worker = [&]() {
+			for (size_t index = nextFile++; index < files.size(); index = nextFile++) {
+				FileReadResult result;
+				result.index = index;
+				result.ok = readWholeFile(files[index], result.data);
+				onComplete(std::move(result));
+			}
+		};
+		std::vector<std::thread> threads;
+		for (unsigned int i = 0; i < numThreads; ++i) threads.emplace_back(worker);
+		for (auto& thread : threads) thread.join();
+	}
+
+private:
+	unsigned int numThreads;
+};
+
+#if defined(__linux__) && defined(PHOTOMAPPING_HAVE_LIBURING)
+// 单线程驱动的 io_uring 读取：每个文件切成最多 kChunkBytes 的大块读请求，保持 queueDepth 个请求在途，
+// 文件的所有块完成后立即交给 onComplete，读取与下游解析重叠
+class UringFileReader : public AsyncFileReader {
+public:
+	explicit UringFileReader(unsigned int queueDepth) : queueDepth(std::max(2u, queueDepth)) {
+		int error = io_uring_queue_init(this->queueDepth, &ring, 0);
+		if (error < 0) throw std::runtime_error(std::string("io_uring_queue_init failed: ") + std::strerror(-error));
+		// IORING_OP_READ 与 probe 同在 5.6 引入；5.1-5.5 的内核 probe 失败，按不支持处理
+		io_uring_probe* probe = io_uring_get_probe_ring(&ring);
+		const bool readSupported = probe && io_uring_opcode_supported(probe, IORING_OP_READ);
+		if (probe) io_uring_free_probe(probe);
+		if (!readSupported) {
+			io_uring_queue_exit(&ring);
+			throw std::runtime_error("io_uring on this kernel does not support IORING_OP_READ");
+		}
+	}
+	~UringFileReader() override { io_uring_queue_exit(&ring); }
+	const char* name() const override { return "io_uring"; }
+
+	void readFiles(const std::vector<std::string>& files, const std::function<void(FileReadResult&&)>& onComplete) override {
+		struct OpenFile {
+			int fd = -1;
+			size_t size = 0;
+			size_t submitted = 0;   // 已提交的字节数
+			unsigned int pending = 0;
+			bool ok = true;
+			FileReadResult result;
+		};
+		// 每个请求的 user_data 指向对应的块
+		struct Chunk {
+			size_t file;
+			size_t offset;
+			size_t length;
+		};
+
+		std::vector<OpenFile> open(files.size());
+		std::deque<Chunk> chunks;
+		size_t nextFile = 0;
+		unsigned int inFlight = 0;
+
+		auto finish = [&](size_t index) {
+			OpenFile& file = open[index];
+			if (file.fd >= 0) close(file.fd);
+			file.fd = -1;
+			file.result.index = index;
+			file.result.ok = file.ok;
+			if (!file.ok) file.result.data.clear();
+			onComplete(std::move(file.result));
+		};
+		// 打开下一个文件并把它切块；空文件与打开失败的文件直接完成
+		auto openNext = [&]() {
+			size_t index = nextFile++;
+			OpenFile& file = open[index];
+			file.fd = ::open(files[index].c_str(), O_RDONLY | O_CLOEXEC);
+			struct stat fileStat;
+			if (file.fd < 0 || fstat(file.fd, &fileStat) != 0) {
+				file.ok = false;
+				finish(index);
+				return;
+			}
+			file.size = static_cast<size_t>(fileStat.st_size);
+			file.result.data.resize(file.size);
+			if (file.size == 0) {
+				finish(index);
+				return;
+			}
+			for (size_t offset = 0; offset < file.size; offset += kChunkBytes) {
+				chunks.push_back({ index, offset, std::min(kChunkBytes, file.size - offset) });
+				++file.pending;
+			}
+		};
+		auto submitChunk = [&](const Chunk& chunk) {
+			io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+			if (!sqe) return false;
+			Chunk* owned = new Chunk(chunk);
+			OpenFile& file = open[chunk.file];
+			io_uring_prep_read(sqe, file.fd, &file.result.data[chunk.offset], static_cast<unsigned int>(chunk.length), chunk.offset);
+			io_uring_sqe_set_data(sqe, owned);
+			++inFlight;
+			return true;
+		};
+
+		// 出错时（等待失败或 onComplete 抛出）先收回所有在途请求再抛出，否则内核会写入已释放的缓冲区
+		auto drain = [&]() {
+			io_uring_submit(&ring);
+			while (inFlight > 0) {
+				io_uring_cqe* cqe = nullptr;
+				int error = io_uring_wait_cqe(&ring, &cqe);
+				if (error == -EINTR) continue;
+				if (error < 0) {
+					// 无法确认请求已结束：宁可泄漏缓冲区也不释放（移动 vector 不会移动元素）
+					new std::vector<OpenFile>(std::move(open));
+					return;
+				}
+				delete static_cast<Chunk*>(io_uring_cqe_get_data(cqe));
+				io_uring_cqe_seen(&ring, cqe);
+				--inFlight;
+			}
+			for (OpenFile& file : open) {
+				if (file.fd >= 0) close(file.fd);
+				file.fd = -1;
+			}
+		};
+
+		try {
+			while (nextFile < files.size() || !chunks.empty() || inFlight > 0) {
+				// 填满提交队列
+				while (inFlight < queueDepth) {
+					if (chunks.empty()) {
+						if (nextFile >= files.size()) break;
+						openNext();
+						continue;
+					}
+					if (!submitChunk(chunks.front())) break;
+					chunks.pop_front();
+				}
+				if (inFlight == 0) continue;
+				io_uring_submit(&ring);
+
+				io_uring_cqe* cqe = nullptr;
+				int error = io_uring_wait_cqe(&ring, &cqe);
+				if (error < 0) {
+					if (error == -EINTR) continue;
+					throw std::runtime_error(std::string("io_uring_wait_cqe failed: ") + std::strerror(-error));
+				}
+				// 一次收割所有已完成的请求
+				unsigned int head;
+				unsigned int reaped = 0;
+				std::vector<size_t> completedFiles;
+				io_uring_for_each_cqe(&ring, head, cqe) {
+					++reaped;
+					std::unique_ptr<Chunk> chunk(static_cast<Chunk*>(io_uring_cqe_get_data(cqe)));
+					OpenFile& file = open[chunk->file];
+					--inFlight;
+					if (cqe->res < 0) {
+						file.ok = false;
+					}
+					else if (static_cast<size_t>(cqe->res) < chunk->length && cqe->res > 0) {
+						// 短读：剩余部分重新排队
+						size_t done = static_cast<size_t>(cqe->res);
+						chunks.push_front({ chunk->file, chunk->offset + done, chunk->length - done });
+						continue;
+					}
+					else if (cqe->res == 0) {
+						file.ok = false;  // 文件在读取期间被截断
+					}
+					if (--file.pending == 0) completedFiles.push_back(chunk->file);
+				}
+				io_uring_cq_advance(&ring, reaped);
+				for (size_t index : completedFiles) finish(index);
+			}
+		}
+		catch (...) {
+			drain();
+			throw;
+		}
+	}
+
+private:
+	static constexpr size_t kChunkBytes = static_cast<size_t>(4) << 20;
+	unsigned int queueDepth;
+	io_uring ring;
+};
+#endif
+
+std::unique_ptr<AsyncFileReader> createAsyncFileReader(const std::string& backend, unsigned int ioThreads, unsigned int queueDepth) {
+	if (backend != "auto" && backend != "uring" && backend != "threads") {
+		throw std::runtime_error("io-backend must be auto, uring or threads");
+	}
+#if defined(__linux__) && defined(PHOTOMAPPING_HAVE_LIBURING)
+	if (backend != "threads") {
+		try {
+			return std::unique_ptr<AsyncFileReader>(new UringFileReader(queueDepth));
+		}
+		catch (const std::exception& e) {
+			// 内核不支持或被容器禁用时退回线程读取
+			if (backend == "uring") throw;
+			std::cout << e.what() << ", falling back to threaded reads." << std::endl;
+		}
+	}
+#else
+	(void)queueDepth;
+	if (backend == "uring") {
+		throw std::runtime_error("io_uring support was not compiled in (PHOTOMAPPING_HAVE_LIBURING)");
+	}
+#endif
+	return std::unique_ptr<AsyncFileReader>(new ThreadedFileReader(ioThreads));
+}
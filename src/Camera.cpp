@@ -10,7 +10,10 @@
 #include <osg/Geode>
 #include <osg/Matrixd>
 #include <osg/Notify>
+#include <algorithm>
+#include <limits>
 #include <TileIntersectionCalculator.h>
+#include "RayClipping.h"
 
 static void printMatrix(const osg::Matrixd& matrix) {
 	osg::notify(osg::NOTICE) << "Matrix: \n";
@@ -91,16 +94,53 @@ std::vector<std::pair<osg::Vec3d, osg::Vec3d>> Camera::calculatePartialPixelRays
 
 	for (int y = 0; y < photoInfo.imageHeight; y += step) {
 		for (int x = 0; x < photoInfo.imageWidth; x += step) {
-			osg::Vec3d normalizedCoords = pixelToNormalizedImageCoordinates(x, y);
-			osg::Vec3d position = getCameraCenter();
-			osg::Vec3d direction = normalizedImageCoordinatesToRay(normalizedCoords);
-			osg::Vec3d endPoint = position + direction * length;
-			pixelRays.emplace_back(position, endPoint);
+			pixelRays.push_back(calculatePixelRay(x, y, length));
 		}
 	}
 	return pixelRays;
 }
 
+std::pair<osg::Vec3d, osg::Vec3d> Camera::calculatePixelRay(double x, double y, double length) const {
+	osg::Vec3d normalizedCoords = pixelToNormalizedImageCoordinates(x, y);
+	osg::Vec3d position = getCameraCenter();
+	osg::Vec3d direction = normalizedImageCoordinatesToRay(normalizedCoords);
+	osg::Vec3d endPoint = position + direction * length;
+	return std::make_pair(position, endPoint);
+}
+
+std::pair<osg::Vec3d, osg::Vec3d> Camera::calculateClippedPixelRay(double x, double y, const std::vector<NamedBoundingBox>& tiles) const {
+	osg::Vec3d position = getCameraCenter();
+	osg::Vec3d direction = normalizedImageCoordinatesToRay(pixelToNormalizedImageCoordinates(x, y));
+	double tmin, tmax;
+	if (!clipRayToTiles(position, direction, tiles, tmin, tmax)) {
+		return std::make_pair(position, position);
+	}
+	return std::make_pair(position + direction * tmin, position + direction * tmax);
+}
+
+std::vector<std::pair<osg::Vec3d, osg::Vec3d>> Camera::calculateClippedPixelRays(int step, const std::vector<NamedBoundingBox>& tiles) const {
+	std::vector<std::pair<osg::Vec3d, osg::Vec3d>> pixelRays;
+	pixelRays.reserve((photoInfo.imageWidth / step) * (photoInfo.imageHeight / step));
+
+	for (int y = 0; y < photoInfo.imageHeight; y += step) {
+		for (int x = 0; x < photoInfo.imageWidth; x += step) {
+			pixelRays.push_back(calculateClippedPixelRay(x, y, tiles));
+		}
+	}
+	return pixelRays;
+}
+
+osg::Vec3d Camera::worldToCamera(const osg::Vec3d& world) const {
+	// normalizedImageCoordinatesToRay 的逆变换：先从 OSG 坐标 (x, -z, y) 转回 ENU，再乘以旋转矩阵
+	osg::Vec3d d = world - osg::Vec3d(getCameraCenter());
+	osg::Vec3d enu(d.x(), d.z(), -d.y());
+	const double (*r)[3] = photoInfo.pose.rotationMatrix;
+	return osg::Vec3d(
+		r[0][0] * enu.x() + r[0][1] * enu.y() + r[0][2] * enu.z(),
+		r[1][0] * enu.x() + r[1][1] * enu.y() + r[1][2] * enu.z(),
+		r[2][0] * enu.x() + r[2][1] * enu.y() + r[2][2] * enu.z());
+}
+
 // 将像素坐标转换为归一化图像坐标
 osg::Vec3d Camera::pixelToNormalizedImageCoordinates(double x, double y) const {
 	// Calculate the normalized image coordinates
@@ -140,24 +180,70 @@ void Camera::addFrustumEdges(osg::ref_ptr<osg::DrawElementsUInt> edges) const {
 	}
 }
 
-osg::ref_ptr<osg::MatrixTransform> Camera::createFrustumGeometry(double heightThreshold) const {
-	double fovY = osg::DegreesToRadians(photoInfo.fovY); // Vertical field of view in radians
-	double aspectRatio = photoInfo.aspectRatio;
-	double nearPlane = 0.1;  // Near clipping plane
-
-	// Determine the far clipping plane based on the height threshold
-	double farPlane;
-	// print  photoInfo.pose.center[1] heightThreshold
-	//std::cout << "photoInfo.pose.center[2]:" << photoInfo.pose.center[2] << std::endl;
-	//std::cout << "heightThreshold:" << heightThreshold << std::endl;
-	if (photoInfo.pose.center[2] > (heightThreshold + 30)) {
-		//farPlane = 200.0;  // Use far plane of 100 if above the threshold
-		farPlane = 8.0;  // Use far plane of 100 if above the threshold
+// 场景包围盒八个角点沿光轴的深度范围即为最紧的近远平面
+void Camera::calculateDepthRange(const osg::BoundingBox& sceneBounds, double& nearPlane, double& farPlane) const {
+	nearPlane = 0.1;  // Near clipping plane
+	farPlane = 8.0;   // Fallback when the scene bounds are unknown
+	if (sceneBounds.valid()) {
+		osg::Vec3d opticalAxis = normalizedImageCoordinatesToRay(osg::Vec3d(0.0, 0.0, 1.0));
+		osg::Vec3d position = getCameraCenter();
+		double minDepth = std::numeric_limits<double>::max();
+		double maxDepth = -std::numeric_limits<double>::max();
+		for (unsigned int i = 0; i < 8; ++i) {
+			double depth = (osg::Vec3d(sceneBounds.corner(i)) - position) * opticalAxis;
+			minDepth = std::min(minDepth, depth);
+			maxDepth = std::max(maxDepth, depth);
+		}
+		nearPlane = std::max(nearPlane, minDepth);
+		farPlane = std::max(nearPlane * 2.0, maxDepth);
 	}
-	else {
-		//farPlane = 130.0;   // Use far plane of 50 if at or below the threshold
-		farPlane = 8.0;
+}
+
+int FrustumPlanes::classify(const osg::BoundingBox& box) const {
+	bool inside = true;
+	for (int i = 0; i < 6; ++i) {
+		const osg::Vec3d& n = normals[i];
+		// 沿法线方向最远与最近的角点
+		osg::Vec3d farthest(n.x() >= 0.0 ? box.xMax() : box.xMin(), n.y() >= 0.0 ? box.yMax() : box.yMin(), n.z() >= 0.0 ? box.zMax() : box.zMin());
+		osg::Vec3d nearest(n.x() >= 0.0 ? box.xMin() : box.xMax(), n.y() >= 0.0 ? box.yMin() : box.yMax(), n.z() >= 0.0 ? box.zMin() : box.zMax());
+		if (n * farthest + offsets[i] < 0.0) return 0;
+		if (n * nearest + offsets[i] < 0.0) inside = false;
 	}
+	return inside ? 2 : 1;
+}
+
+FrustumPlanes Camera::calculateFrustumPlanes(const osg::BoundingBox& sceneBounds) const {
+	double nearPlane, farPlane;
+	calculateDepthRange(sceneBounds, nearPlane, farPlane);
+	const osg::Vec3d position = getCameraCenter();
+	const osg::Vec3d opticalAxis = normalizedImageCoordinatesToRay(osg::Vec3d(0.0, 0.0, 1.0));
+	// 平面向外放宽一点，避免 float 包围盒与射线采样点恰好落在边界上时被剔除
+	const double margin = 1e-4 * farPlane;
+
+	FrustumPlanes frustum;
+	std::vector<osg::Vec3d> cornerRays = calculateCornerRays();
+	osg::Vec3d centerRay = cornerRays[0] + cornerRays[1] + cornerRays[2] + cornerRays[3];
+	// 角点顺序为左上、右上、左下、右下，相邻两条射线与相机中心确定一个侧面
+	const int sides[4][2] = { { 0, 1 }, { 1, 3 }, { 3, 2 }, { 2, 0 } };
+	for (int i = 0; i < 4; ++i) {
+		osg::Vec3d normal = cornerRays[sides[i][0]] ^ cornerRays[sides[i][1]];
+		normal.normalize();
+		if (normal * centerRay < 0.0) normal = -normal;
+		frustum.normals[i] = normal;
+		frustum.offsets[i] = -(normal * position) + margin;
+	}
+	frustum.normals[4] = opticalAxis;
+	frustum.offsets[4] = -(opticalAxis * position) - nearPlane + margin;
+	frustum.normals[5] = -opticalAxis;
+	frustum.offsets[5] = opticalAxis * position + farPlane + margin;
+	return frustum;
+}
+
+osg::ref_ptr<osg::MatrixTransform> Camera::createFrustumGeometry(const osg::BoundingBox& sceneBounds) const {
+	double fovY = osg::DegreesToRadians(photoInfo.fovY); // Vertical field of view in radians
+	double aspectRatio = photoInfo.aspectRatio;
+	double nearPlane, farPlane;
+	calculateDepthRange(sceneBounds, nearPlane, farPlane);
 
 	double tanHalfFovY = tan(fovY / 2.0);
 	double tanHalfFovX = tanHalfFovY * aspectRatio;
@@ -266,7 +352,6 @@ std::vector<NamedBoundingBox> Camera::calculateIntersectingTiles(const osg::Boun
 	for (const NamedBoundingBox& tile : tileBoundingBoxes) {
 		if (frustumBBox.intersects(tile.bbox)) {
 			intersectingTiles.push_back(tile);
-			std::cout << "Intersected Tile: " << tile.name << std::endl;  // 输出相交的瓦片名称
 		}
 	}
 
@@ -0,0 +1,226 @@
+#include "CheckpointLog.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+static const char kCheckpointMagic[4] = { 'P', 'M', 'C', 'K' };
+static const uint32_t kCheckpointVersion = 1;
+// 两次 fsync 之间的最短间隔(秒)
+static const double kSyncInterval = 30.0;
+
+static uint32_t recordChecksum(const char* data, size_t size) {
+	// FNV-1a
+	uint32_t checksum = 2166136261u;
+	for (size_t i = 0; i < size; ++i) {
+		checksum = (checksum ^ static_cast<unsigned char>(data[i])) * 16777619u;
+	}
+	return checksum;
+}
+
+static void appendBytes(std::vector<char>& buffer, const void* data, size_t size) {
+	const char* bytes = static_cast<const char*>(data);
+	buffer.insert(buffer.end(), bytes, bytes + size);
+}
+
+// 长度字段为 u16，超长时报错而不是截断
+static void appendShortString(std::vector<char>& buffer, const std::string& value) {
+	if (value.size() > UINT16_MAX) {
+		throw std::runtime_error("Name too long for the checkpoint log (" + std::to_string(value.size()) + " bytes)");
+	}
+	uint16_t length = static_cast<uint16_t>(value.size());
+	appendBytes(buffer, &length, sizeof(length));
+	appendBytes(buffer, value.data(), length);
+}
+
+// 顺序读取内存中的字节，越界时返回 false
+class ByteReader {
+public:
+	ByteReader(const char* data, size_t size) : data(data), size(size) {}
+	template <typename T>
+	bool read(T& value) {
+		if (size - position < sizeof(T)) return false;
+		std::memcpy(&value, data + position, sizeof(T));
+		position += sizeof(T);
+		return true;
+	}
+	bool readString(std::string& value, size_t length) {
+		if (size - position < length) return false;
+		value.assign(data + position, length);
+		position += length;
+		return true;
+	}
+	bool readShortString(std::string& value) {
+		uint16_t length;
+		return read(length) && readString(value, length);
+	}
+	size_t offset() const { return position; }
+
+private:
+	const char* data;
+	size_t size;
+	size_t position = 0;
+};
+
+static std::vector<char> headerBytes(const std::string& runKey, const TileRegistry& registry) {
+	std::vector<char> header;
+	appendBytes(header, kCheckpointMagic, sizeof(kCheckpointMagic));
+	appendBytes(header, &kCheckpointVersion, sizeof(kCheckpointVersion));
+	uint32_t keyLength = static_cast<uint32_t>(runKey.size());
+	appendBytes(header, &keyLength, sizeof(keyLength));
+	appendBytes(header, runKey.data(), keyLength);
+	uint32_t numTiles = static_cast<uint32_t>(registry.size());
+	appendBytes(header, &numTiles, sizeof(numTiles));
+	for (const std::string& name : registry.getTileNames()) {
+		appendShortString(header, name);
+	}
+	return header;
+}
+
+static bool readRecord(ByteReader& reader, PhotoData& photoData) {
+	uint32_t payloadBytes, checksum;
+	ByteReader start = reader;
+	if (!reader.read(payloadBytes) || !reader.read(checksum)) return false;
+	std::string payload;
+	if (!reader.readString(payload, payloadBytes) || recordChecksum(payload.data(), payload.size()) != checksum) {
+		reader = start;
+		return false;
+	}
+	ByteReader record(payload.data(), payload.size());
+	int32_t index;
+	uint32_t numResults;
+	if (!record.read(index) || !record.readShortString(photoData.imagePath) || !record.read(numResults)) return false;
+	photoData.index = index;
+	photoData.intersectionResults.clear();
+	for (uint32_t i = 0; i < numResults; ++i) {
+		uint32_t tileId;
+		double percentage;
+		if (!record.read(tileId) || !record.read(percentage)) return false;
+		photoData.intersectionResults.push_back({ tileId, percentage });
+	}
+	return true;
+}
+
+CheckpointLog::CheckpointLog(const std::string& path, const std::string& runKey, const TileRegistry& registry, bool resume)
+	: path(path), lastSync(std::chrono::steady_clock::now()) {
+	const std::vector<char> header = headerBytes(runKey, registry);
+	std::ifstream in(path.c_str(), std::ios::binary);
+	if (resume && in) {
+		std::vector<char> contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		in.close();
+		if (contents.size() < header.size() || !std::equal(header.begin(), header.end(), contents.begin())) {
+			throw std::runtime_error("Checkpoint " + path + " was written with different parameters or tiles; delete it or run without --resume");
+		}
+		// 最后一条完整记录之后的内容是中断时写了一半的记录，截掉后继续追加
+		ByteReader reader(contents.data() + header.size(), contents.size() - header.size());
+		PhotoData photoData;
+		size_t validBytes = header.size();
+		while (readRecord(reader, photoData)) {
+			completed.insert(photoData.index);
+			validBytes = header.size() + reader.offset();
+		}
+		if (validBytes < contents.size()) {
+			std::cout << "Checkpoint: dropping " << contents.size() - validBytes << " bytes of an incomplete record" << std::endl;
+			std::filesystem::resize_file(path, validBytes);
+		}
+		file = std::fopen(path.c_str(), "ab");
+		std::cout << "Checkpoint: resuming with " << completed.size() << " completed photos from " << path << std::endl;
+	}
+	else {
+		in.close();
+		file = std::fopen(path.c_str(), "wb");
+		if (file) std::fwrite(header.data(), 1, header.size(), file);
+	}
+	if (!file) {
+		throw std::runtime_error("Unable to open checkpoint: " + path);
+	}
+	std::fflush(file);
+}
+
+CheckpointLog::~CheckpointLog() {
+	if (file) {
+		sync();
+		std::fclose(file);
+	}
+}
+
+void CheckpointLog::append(const PhotoData& photoData) {
+	auto start = std::chrono::steady_clock::now();
+	std::lock_guard<std::mutex> lock(mutex);
+	buffer.clear();
+	buffer.resize(2 * sizeof(uint32_t));
+	int32_t index = photoData.index;
+	uint32_t numResults = static_cast<uint32_t>(photoData.intersectionResults.size());
+	appendBytes(buffer, &index, sizeof(index));
+	appendShortString(buffer, photoData.imagePath);
+	appendBytes(buffer, &numResults, sizeof(numResults));
+	for (const TileIntersectionResult& result : photoData.intersectionResults) {
+		uint32_t tileId = result.tileId;
+		appendBytes(buffer, &tileId, sizeof(tileId));
+		appendBytes(buffer, &result.percentage, sizeof(result.percentage));
+	}
+	uint32_t payloadBytes = static_cast<uint32_t>(buffer.size() - 2 * sizeof(uint32_t));
+	uint32_t checksum = recordChecksum(buffer.data() + 2 * sizeof(uint32_t), payloadBytes);
+	std::memcpy(buffer.data(), &payloadBytes, sizeof(payloadBytes));
+	std::memcpy(buffer.data() + sizeof(payloadBytes), &checksum, sizeof(checksum));
+	// 一次 fwrite 加 fflush：记录进入内核页缓存，进程被杀时不会丢失
+	if (std::fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size() || std::fflush(file) != 0) {
+		throw std::runtime_error("Unable to write checkpoint: " + path);
+	}
+	completed.insert(photoData.index);
+	if (std::chrono::duration<double>(std::chrono::steady_clock::now() - lastSync).count() >= kSyncInterval) {
+		sync();
+	}
+	writeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void CheckpointLog::sync() {
+	std::fflush(file);
+#if defined(_WIN32)
+	_commit(_fileno(file));
+#else
+	fsync(fileno(file));
+#endif
+	lastSync = std::chrono::steady_clock::now();
+}
+
+std::vector<PhotoData> CheckpointLog::readPhotos() {
+	std::lock_guard<std::mutex> lock(mutex);
+	std::fflush(file);
+	std::ifstream in(path.c_str(), std::ios::binary);
+	std::vector<char> contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	ByteReader reader(contents.data(), contents.size());
+	// 跳过头部：魔数、版本、签名和 tile 表
+	char magic[4];
+	uint32_t version, keyLength, numTiles;
+	std::string skipped;
+	bool valid = reader.read(magic) && reader.read(version) && reader.read(keyLength) && reader.readString(skipped, keyLength)
+		&& reader.read(numTiles);
+	for (uint32_t i = 0; valid && i < numTiles; ++i) {
+		valid = reader.readShortString(skipped);
+	}
+	if (!valid) {
+		throw std::runtime_error("Corrupt checkpoint header: " + path);
+	}
+	// 同一照片出现多次时以最后一条为准
+	std::map<int, PhotoData> photos;
+	PhotoData photoData;
+	while (readRecord(reader, photoData)) {
+		photos[photoData.index] = photoData;
+	}
+	std::vector<PhotoData> sorted;
+	sorted.reserve(photos.size());
+	for (auto& entry : photos) {
+		sorted.push_back(std::move(entry.second));
+	}
+	return sorted;
+}
@@ -0,0 +1,285 @@
+#include "CoverageEngine.h"
+#include "TileMesh.h"
+#include "TileRasterizer.h"
+#include "HeightfieldEngine.h"
+#include "PhotoBvh.h"
+#include "ThreadPool.h"
+#include "TileCache.h"
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+bool isPhotoAboveScene(const Camera& camera, double heightThreshold) {
+	// -y 为相机中心的高度
+	return -camera.getCameraCenter().y() > (heightThreshold + 30);
+}
+
+PhotoRaySetup setupPhotoRays(Camera& camera, const osg::BoundingBox& sceneBounds,
+	const std::vector<NamedBoundingBox>& tileBoundingBoxes, const PipelineConfig& config) {
+	PhotoRaySetup setup;
+	setup.frustumTransform = camera.createFrustumGeometry(sceneBounds);
+	setup.frustumBBox = camera.calculateFrustumBoundingBox(setup.frustumTransform);
+	setup.intersectingTiles = camera.calculateIntersectingTiles(setup.frustumBBox, tileBoundingBoxes);
+	setup.rays = config.rayLength > 0.0
+		? camera.calculatePartialPixelRays(config.rayStep, config.rayLength)
+		: camera.calculateClippedPixelRays(config.rayStep, setup.intersectingTiles);
+	return setup;
+}
+
+std::vector<TileIntersectionResult> CoverageEngine::aggregate(const std::vector<TileId>& rayTiles,
+	const CoverageBatch& batch) const {
+	return aggregateTileCoverage(rayTiles, batch.intersectingTiles);
+}
+
+void CoverageEngine::writeTileCache(const std::string& /*path*/, const SceneBuilder& /*builder*/) const {
+	throw std::runtime_error(std::string("Engine ") + name() + " cannot write a tile cache");
+}
+
+// osg: 场景图线段求交，作为其他引擎的精度参考
+class OsgCoverageEngine : public CoverageEngine {
+public:
+	explicit OsgCoverageEngine(bool useTileGrid) : useTileGrid(useTileGrid) {}
+	const char* name() const override { return "osg"; }
+	void prepare(const SceneBuilder& builder) override {
+		tileNodes = &builder.getTileNodes();
+		tileGrid = useTileGrid && builder.getTileGrid().isValid() ? &builder.getTileGrid() : nullptr;
+	}
+	std::vector<TileId> traceBatch(const CoverageBatch& batch) const override {
+		return traceRayTiles(*tileNodes, batch.rays, batch.intersectingTiles, tileGrid);
+	}
+
+private:
+	bool useTileGrid;
+	const std::vector<osg::ref_ptr<osg::Node>>* tileNodes = nullptr;
+	const TileGrid* tileGrid = nullptr;
+};
+
+// osgkd: 仍在场景图上求交，但使用 KdTree 并把射线按 tile 成批放入 IntersectorGroup
+class OsgKdTreeCoverageEngine : public CoverageEngine {
+public:
+	const char* name() const override { return "osgkd"; }
+	void prepare(const SceneBuilder& builder) override {
+		tileNodes = &builder.getTileNodes();
+		if (!builder.getBuildKdTrees()) {
+			buildTileKdTrees(*tileNodes);
+		}
+	}
+	std::vector<TileId> traceBatch(const CoverageBatch& batch) const override {
+		return traceRayTilesBatched(*tileNodes, batch.rays, batch.intersectingTiles);
+	}
+	size_t accelerationBytesPerTriangle() const override { return 32; }
+
+private:
+	const std::vector<osg::ref_ptr<osg::Node>>* tileNodes = nullptr;
+};
+
+// bvh: 每个 tile 的三角网建 4 路或 8 路 BVH，每张照片先用视锥体裁剪出紧凑的顶层 BVH 再追踪射线。
+// 场景加载时 tile 一到达就在共享线程池中构建，与其余 tile 的读取重叠；
+// 附加了共享 tile 缓存时直接指向映射的三角网与 BVH，不构建也不需要场景图
+template <int Width>
+class BvhCoverageEngine : public CoverageEngine {
+public:
+	const char* name() const override { return "bvh"; }
+	void onTileLoaded(const std::string& tileName, osg::Node* tileNode) override {
+		std::unique_ptr<TileEntry> entry = buildEntry(tileNode);
+		std::lock_guard<std::mutex> lock(mutex);
+		loadedEntries[tileName] = std::move(entry);
+	}
+	void prepare(const SceneBuilder& builder) override {
+		sceneBounds = builder.getSceneBoundingBox();
+		const TileRegistry& registry = builder.getTileRegistry();
+		entries.resize(registry.size());
+		// 核外模式下已卸载的 tile 释放其 BVH；加载时未收到的 tile（如基准模式下加载后才创建引擎）在这里补建
+		TaskGroup tasks(ThreadPool::shared());
+		for (TileId id = 0; id < registry.size(); ++id) {
+			int cacheIndex = tileCache ? tileCache->findTile(registry.getTileName(id)) : -1;
+			if (cacheIndex >= 0) {
+				if (!entries[id]) {
+					entries[id].reset(new TileEntry());
+					tileCache->attach(cacheIndex, entries[id]->bvh);
+				}
+				continue;
+			}
+			osg::Node* tileNode = builder.getTileNodes()[id].get();
+			if (!tileNode) {
+				entries[id].reset();
+				continue;
+			}
+			auto it = loadedEntries.find(registry.getTileName(id));
+			if (it != loadedEntries.end()) {
+				entries[id] = std::move(it->second);
+				continue;
+			}
+			if (entries[id]) continue;
+			tasks.run([this, id, tileNode]() { entries[id] = buildEntry(tileNode); });
+		}
+		tasks.wait();
+		loadedEntries.clear();
+
+		tileBvhs.assign(entries.size(), nullptr);
+		stats.triangles = 0;
+		stats.memoryBytes = 0;
+		for (size_t id = 0; id < entries.size(); ++id) {
+			if (!entries[id]) continue;
+			tileBvhs[id] = &entries[id]->bvh;
+			stats.triangles += entries[id]->bvh.numTriangles;
+			stats.memoryBytes += entries[id]->bvh.bvh.memoryBytes();
+		}
+		std::cout << "BVH" << Width << ": " << stats.triangles << " triangles, "
+			<< (stats.triangles > 0 ? static_cast<double>(stats.memoryBytes) / stats.triangles : 0.0) << " bytes/triangle, "
+			<< stats.buildSeconds << " s accumulated build time" << std::endl;
+	}
+	std::vector<TileId> traceBatch(const CoverageBatch& batch) const override {
+		PhotoBvh<Width> photoBvh(tileBvhs, batch.intersectingTiles, batch.camera.calculateFrustumPlanes(sceneBounds));
+		return photoBvh.traceRays(batch.rays);
+	}
+	EngineBuildStats getBuildStats() const override { return stats; }
+	void releaseTiles(const std::vector<TileId>& ids) override {
+		for (TileId id : ids) {
+			if (id < tileBvhs.size()) tileBvhs[id] = nullptr;
+			if (id < entries.size()) entries[id].reset();
+		}
+	}
+	bool attachTileCache(const TileCache* cache) override {
+		tileCache = cache;
+		return true;
+	}
+	void writeTileCache(const std::string& path, const SceneBuilder& builder) const override {
+		::writeTileCache<Width>(path, builder, tileBvhs);
+	}
+	// 三角网副本约 48 字节，节点量化后 4 路约 20、8 路约 27 字节
+	size_t accelerationBytesPerTriangle() const override { return Width == 4 ? 68 : 75; }
+
+private:
+	struct TileEntry {
+		TileMesh mesh;       // 映射缓存时为空
+		TileBvh<Width> bvh;  // 指向 mesh 或缓存中的数组
+	};
+
+	std::unique_ptr<TileEntry> buildEntry(osg::Node* tileNode) {
+		std::unique_ptr<TileEntry> entry(new TileEntry());
+		entry->mesh = extractTileMesh(tileNode);
+		auto start = std::chrono::high_resolution_clock::now();
+		entry->bvh.build(entry->mesh, &ThreadPool::shared());
+		double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.buildSeconds += seconds;
+		return entry;
+	}
+
+	osg::BoundingBox sceneBounds;
+	const TileCache* tileCache = nullptr;
+	std::mutex mutex;
+	std::map<std::string, std::unique_ptr<TileEntry>> loadedEntries;
+	std::vector<std::unique_ptr<TileEntry>> entries;  // 以 TileId 为下标
+	std::vector<const TileBvh<Width>*> tileBvhs;
+	EngineBuildStats stats;
+};
+
+// raster: 软件光栅化 TileId 缓冲，采样点与射线一一对应
+class RasterCoverageEngine : public CoverageEngine {
+public:
+	const char* name() const override { return "raster"; }
+	// 核外模式每批 prepare 一次，只提取新换入的 tile，已常驻 tile 的三角网沿用
+	void prepare(const SceneBuilder& builder) override {
+		const std::vector<osg::ref_ptr<osg::Node>>& tileNodes = builder.getTileNodes();
+		meshes.resize(tileNodes.size());
+		extracted.resize(tileNodes.size(), 0);
+		std::vector<TileId> pending;
+		for (TileId id = 0; id < tileNodes.size(); ++id) {
+			if (!tileNodes[id]) {
+				meshes[id] = TileMesh();
+				extracted[id] = 0;
+			}
+			else if (!extracted[id]) {
+				pending.push_back(id);
+			}
+		}
+		TaskGroup tasks(ThreadPool::shared());
+		for (TileId id : pending) {
+			tasks.run([this, &tileNodes, id]() { meshes[id] = extractTileMesh(tileNodes[id].get()); });
+		}
+		tasks.wait();
+		for (TileId id : pending) extracted[id] = 1;
+		rasterizer.reset(new TileRasterizer(meshes));
+	}
+	std::vector<TileId> traceBatch(const CoverageBatch& batch) const override {
+		TileIdBuffer buffer;
+		rasterizer->rasterize(batch.camera, batch.intersectingTiles, batch.step, buffer);
+		std::vector<TileId> rayTiles;
+		rayTiles.reserve(static_cast<size_t>(buffer.cols) * buffer.rows);
+		for (int row = 0; row < buffer.rows; ++row) {
+			for (int col = 0; col < buffer.cols; ++col) {
+				rayTiles.push_back(buffer.at(col, row));
+			}
+		}
+		return rayTiles;
+	}
+	void releaseTiles(const std::vector<TileId>& ids) override {
+		for (TileId id : ids) {
+			if (id < meshes.size()) {
+				meshes[id] = TileMesh();
+				extracted[id] = 0;
+			}
+		}
+	}
+	size_t accelerationBytesPerTriangle() const override { return 48; }
+
+private:
+	std::vector<TileMesh> meshes;  // rasterizer 持有引用
+	std::vector<char> extracted;   // 以 TileId 为下标，meshes 中已有该 tile 的三角网
+	std::unique_ptr<TileRasterizer> rasterizer;
+};
+
+// dsm: 2.5D 高程网格步进，建好后释放三角网
+class HeightfieldCoverageEngine : public CoverageEngine {
+public:
+	explicit HeightfieldCoverageEngine(double cellSize) : cellSize(cellSize) {}
+	const char* name() const override { return "dsm"; }
+	// 核外模式每批 prepare 一次，统计只反映当前常驻的 tile
+	void prepare(const SceneBuilder& builder) override {
+		std::vector<TileMesh> meshes = extractTileMeshes(builder.getTileNodes());
+		stats = EngineBuildStats();
+		heightfield.reset();
+		auto start = std::chrono::high_resolution_clock::now();
+		heightfield.reset(new HeightfieldEngine(meshes, cellSize));
+		stats.buildSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		for (const TileMesh& mesh : meshes) {
+			stats.triangles += mesh.numTriangles();
+		}
+		stats.memoryBytes = heightfield->memoryBytes();
+	}
+	std::vector<TileId> traceBatch(const CoverageBatch& batch) const override {
+		return heightfield->traceRays(batch.rays);
+	}
+	EngineBuildStats getBuildStats() const override { return stats; }
+	// 格网大小取决于覆盖面积而非三角形数，prepare 之后按实测折算，之前用典型值
+	size_t accelerationBytesPerTriangle() const override {
+		return stats.triangles > 0 ? (stats.memoryBytes + stats.triangles - 1) / stats.triangles : kDefaultBytesPerTriangle;
+	}
+
+private:
+	static const size_t kDefaultBytesPerTriangle = 16;
+	double cellSize;
+	std::unique_ptr<HeightfieldEngine> heightfield;
+	EngineBuildStats stats;
+};
+
+std::unique_ptr<CoverageEngine> createCoverageEngine(const std::string& name, const PipelineConfig& config) {
+	if (name == "osg") return std::unique_ptr<CoverageEngine>(new OsgCoverageEngine(config.useTileGrid));
+	if (name == "osgkd") return std::unique_ptr<CoverageEngine>(new OsgKdTreeCoverageEngine());
+	if (name == "bvh") {
+		if (config.bvhWidth == 4) return std::unique_ptr<CoverageEngine>(new BvhCoverageEngine<4>());
+		return std::unique_ptr<CoverageEngine>(new BvhCoverageEngine<8>());
+	}
+	if (name == "raster") return std::unique_ptr<CoverageEngine>(new RasterCoverageEngine());
+	if (name == "dsm") return std::unique_ptr<CoverageEngine>(new HeightfieldCoverageEngine(config.dsmCellSize));
+	throw std::runtime_error("Unknown coverage engine: " + name);
+}
+
+const std::vector<std::string>& getCoverageEngineNames() {
+	static const std::vector<std::string> names = { "osg", "osgkd", "bvh", "raster", "dsm" };
+	return names;
+}
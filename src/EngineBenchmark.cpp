@@ -0,0 +1,176 @@
+#include "EngineBenchmark.h"
+#include "CoverageEngine.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+// 一张抽样照片的引擎输入，所有引擎共用，计时不包含视锥体与射线生成
+struct BenchmarkPhoto {
+	std::unique_ptr<Camera> camera;
+	std::vector<NamedBoundingBox> intersectingTiles;
+	std::vector<std::pair<osg::Vec3d, osg::Vec3d>> rays;
+};
+
+// 单个引擎在全部抽样照片上的累计结果
+struct EngineStats {
+	std::string name;
+	double prepareSeconds = 0.0;
+	double traceSeconds = 0.0;
+	size_t comparedRays = 0;    // 与参考逐射线对比的射线数，数量不一致的照片按两者较大值计
+	size_t mismatchedRays = 0;
+	double maxCoverageError = 0.0;
+	EngineBuildStats build;
+	std::vector<std::vector<TileId>> rayTiles;
+	std::vector<std::vector<TileIntersectionResult>> coverage;
+};
+
+static double secondsSince(std::chrono::high_resolution_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static std::vector<std::string> splitEngineNames(const std::string& list) {
+	std::vector<std::string> names;
+	std::stringstream ss(list);
+	std::string name;
+	while (std::getline(ss, name, ',')) {
+		if (!name.empty()) names.push_back(name);
+	}
+	return names;
+}
+
+// 在 [photoBegin, photoEnd) 内等间隔抽取照片，与 processPhoto 共用 setupPhotoRays 准备输入
+static std::vector<BenchmarkPhoto> samplePhotos(const PipelineConfig& config, const std::vector<PhotoInfo>& photoInfos,
+	const SceneBuilder& builder) {
+	const double heightThreshold = builder.calculateHeightThreshold();
+	const osg::BoundingBox sceneBounds = builder.getSceneBoundingBox();
+	const int photoBegin = std::max(0, config.photoBegin);
+	const int photoEnd = std::min(config.photoEnd, static_cast<int>(photoInfos.size()));
+	const int range = photoEnd - photoBegin;
+	const int count = std::min(range, std::max(1, config.benchPhotos));
+
+	std::vector<BenchmarkPhoto> photos;
+	for (int i = 0; i < count && range > 0; ++i) {
+		int photoIndex = photoBegin + static_cast<int>(static_cast<long long>(i) * range / count);
+		BenchmarkPhoto photo;
+		photo.camera.reset(new Camera(photoInfos[photoIndex]));
+		if (isPhotoAboveScene(*photo.camera, heightThreshold)) continue;
+
+		PhotoRaySetup setup = setupPhotoRays(*photo.camera, sceneBounds, builder.getTileBoundingBoxes(), config);
+		photo.intersectingTiles = std::move(setup.intersectingTiles);
+		photo.rays = std::move(setup.rays);
+		photos.push_back(std::move(photo));
+	}
+	return photos;
+}
+
+static EngineStats runEngine(const std::string& name, const PipelineConfig& config, const SceneBuilder& builder,
+	const std::vector<BenchmarkPhoto>& photos) {
+	EngineStats stats;
+	stats.name = name;
+	std::unique_ptr<CoverageEngine> engine = createCoverageEngine(name, config);
+
+	auto prepareStart = std::chrono::high_resolution_clock::now();
+	engine->prepare(builder);
+	stats.prepareSeconds = secondsSince(prepareStart);
+	stats.build = engine->getBuildStats();
+
+	for (const BenchmarkPhoto& photo : photos) {
+		CoverageBatch batch = { *photo.camera, photo.intersectingTiles, config.rayStep, photo.rays };
+		auto traceStart = std::chrono::high_resolution_clock::now();
+		std::vector<TileId> rayTiles = engine->traceBatch(batch);
+		std::vector<TileIntersectionResult> coverage = engine->aggregate(rayTiles, batch);
+		stats.traceSeconds += secondsSince(traceStart);
+		stats.rayTiles.push_back(std::move(rayTiles));
+		stats.coverage.push_back(std::move(coverage));
+	}
+	return stats;
+}
+
+// 逐射线与逐 tile 对比参考结果
+static void compareWithReference(EngineStats& stats, const EngineStats& reference) {
+	for (size_t photo = 0; photo < stats.rayTiles.size(); ++photo) {
+		const std::vector<TileId>& rayTiles = stats.rayTiles[photo];
+		const std::vector<TileId>& referenceRayTiles = reference.rayTiles[photo];
+		stats.comparedRays += std::max(rayTiles.size(), referenceRayTiles.size());
+		if (rayTiles.size() != referenceRayTiles.size()) {
+			// 采样点数量不一致时整张照片视为不一致
+			stats.mismatchedRays += std::max(rayTiles.size(), referenceRayTiles.size());
+		}
+		else {
+			for (size_t i = 0; i < rayTiles.size(); ++i) {
+				if (rayTiles[i] != referenceRayTiles[i]) ++stats.mismatchedRays;
+			}
+		}
+		const std::vector<TileIntersectionResult>& coverage = stats.coverage[photo];
+		const std::vector<TileIntersectionResult>& referenceCoverage = reference.coverage[photo];
+		for (size_t i = 0; i < coverage.size() && i < referenceCoverage.size(); ++i) {
+			stats.maxCoverageError = std::max(stats.maxCoverageError,
+				std::fabs(coverage[i].percentage - referenceCoverage[i].percentage));
+		}
+	}
+}
+
+// 每百万三角形的构建时间与每个三角形的加速结构字节数，引擎没有三角形统计时输出 -
+static void printBuildColumns(const EngineBuildStats& build) {
+	if (build.triangles == 0) {
+		std::cout << std::setw(14) << "-" << std::setw(12) << "-";
+		return;
+	}
+	std::cout << std::setw(14) << build.buildSeconds / (build.triangles / 1e6)
+		<< std::setw(12) << static_cast<double>(build.memoryBytes) / build.triangles;
+}
+
+bool runEngineBenchmark(const PipelineConfig& config, const std::vector<PhotoInfo>& photoInfos,
+	const SceneBuilder& builder) {
+	std::vector<BenchmarkPhoto> photos = samplePhotos(config, photoInfos, builder);
+	if (photos.empty()) {
+		std::cerr << "Benchmark: no photo in range [" << config.photoBegin << ", " << config.photoEnd << ")" << std::endl;
+		return false;
+	}
+
+	const std::string referenceName = getCoverageEngineNames().front();
+	std::vector<std::string> engineNames = splitEngineNames(config.benchEngines);
+	if (engineNames.empty()) {
+		engineNames.assign(getCoverageEngineNames().begin() + 1, getCoverageEngineNames().end());
+	}
+	std::cout << "Benchmark: " << photos.size() << " photos, ray step " << config.rayStep << std::endl;
+
+	EngineStats reference = runEngine(referenceName, config, builder, photos);
+	std::vector<EngineStats> results;
+	for (const std::string& name : engineNames) {
+		if (name == referenceName) continue;
+		std::cout << "Benchmark: running " << name << std::endl;
+		results.push_back(runEngine(name, config, builder, photos));
+		compareWithReference(results.back(), reference);
+	}
+
+	bool passed = true;
+	std::cout << std::left << std::setw(10) << "engine" << std::right
+		<< std::setw(12) << "prepare(s)" << std::setw(12) << "trace(s)" << std::setw(10) << "speedup"
+		<< std::setw(14) << "mismatch(%)" << std::setw(14) << "max err(%)"
+		<< std::setw(14) << "build(s/Mtri)" << std::setw(12) << "bytes/tri" << "  status" << std::endl;
+	std::cout << std::fixed << std::setprecision(4);
+	std::cout << std::left << std::setw(10) << reference.name << std::right
+		<< std::setw(12) << reference.prepareSeconds << std::setw(12) << reference.traceSeconds
+		<< std::setw(10) << 1.0 << std::setw(14) << 0.0 << std::setw(14) << 0.0;
+	printBuildColumns(reference.build);
+	std::cout << "  reference" << std::endl;
+	for (const EngineStats& stats : results) {
+		double mismatchRate = stats.comparedRays > 0 ? 100.0 * stats.mismatchedRays / stats.comparedRays : 0.0;
+		double speedup = stats.traceSeconds > 0.0 ? reference.traceSeconds / stats.traceSeconds : 0.0;
+		bool ok = mismatchRate <= config.benchMaxMismatch && stats.maxCoverageError <= config.benchMaxCoverageError;
+		passed = passed && ok;
+		std::cout << std::left << std::setw(10) << stats.name << std::right
+			<< std::setw(12) << stats.prepareSeconds << std::setw(12) << stats.traceSeconds
+			<< std::setw(10) << speedup << std::setw(14) << mismatchRate << std::setw(14) << stats.maxCoverageError;
+		printBuildColumns(stats.build);
+		std::cout << "  " << (ok ? "ok" : "FAIL") << std::endl;
+	}
+	std::cout.unsetf(std::ios::floatfield);
+	std::cout << std::setprecision(6);
+	return passed;
+}
@@ -0,0 +1,232 @@
+#include "HeightfieldEngine.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include "ThreadPool.h"
+
+static const float kEmptyHeight = -std::numeric_limits<float>::max();
+// 自动选取格网尺寸时场景最长边的格网数
+static const double kAutoCellsPerSide = 4096.0;
+
+// 场景坐标与 DSM 坐标的转换：地面 (x, z)，高程 -y
+static inline double heightOf(const osg::Vec3f& v) { return -v.y(); }
+
+HeightfieldEngine::HeightfieldEngine(const std::vector<TileMesh>& meshes, double cellSize, unsigned int numThreads)
+	: cellSize(cellSize), originX(0.0), originZ(0.0), columns(0), rows(0),
+	numThreads(numThreads > 0 ? numThreads : ThreadPool::shared().size()) {
+	osg::BoundingBox sceneBounds;
+	for (const TileMesh& mesh : meshes) {
+		sceneBounds.expandBy(mesh.bbox);
+	}
+	if (!sceneBounds.valid()) return;
+
+	double extentX = sceneBounds.xMax() - sceneBounds.xMin();
+	double extentZ = sceneBounds.zMax() - sceneBounds.zMin();
+	if (this->cellSize <= 0.0) {
+		this->cellSize = std::max(std::max(extentX, extentZ) / kAutoCellsPerSide, 1e-6);
+	}
+	originX = sceneBounds.xMin();
+	originZ = sceneBounds.zMin();
+	columns = std::max(1, static_cast<int>(std::ceil(extentX / this->cellSize)));
+	rows = std::max(1, static_cast<int>(std::ceil(extentZ / this->cellSize)));
+
+	levels.resize(1);
+	levels[0].columns = columns;
+	levels[0].rows = rows;
+	levels[0].maxHeight.assign(static_cast<size_t>(columns) * rows, kEmptyHeight);
+	cellTiles.assign(static_cast<size_t>(columns) * rows, kInvalidTileId);
+
+	// 按格网行分带，每个线程独占一条带，tile 接缝处不会产生写冲突
+	const int numBands = static_cast<int>(this->numThreads) * 4;
+	const int bandRows = (rows + numBands - 1) / numBands;
+	std::atomic<int> nextBand(0);
+	auto worker = [&]() {
+		for (int band = nextBand++; band < numBands; band = nextBand++) {
+			int rowBegin = band * bandRows;
+			int rowEnd = std::min(rows, rowBegin + bandRows);
+			if (rowBegin >= rowEnd) continue;
+			for (size_t tileId = 0; tileId < meshes.size(); ++tileId) {
+				const TileMesh& mesh = meshes[tileId];
+				if (!mesh.bbox.valid()) continue;
+				int meshRowBegin = static_cast<int>(std::floor((mesh.bbox.zMin() - originZ) / this->cellSize));
+				int meshRowEnd = static_cast<int>(std::floor((mesh.bbox.zMax() - originZ) / this->cellSize)) + 1;
+				if (meshRowEnd <= rowBegin || meshRowBegin >= rowEnd) continue;
+				rasterizeMesh(mesh, static_cast<TileId>(tileId), rowBegin, rowEnd);
+			}
+		}
+	};
+	{
+		TaskGroup tasks(ThreadPool::shared());
+		for (unsigned int i = 0; i < this->numThreads; ++i) {
+			tasks.run(worker);
+		}
+		tasks.wait();
+	}
+
+	buildPyramid();
+	std::cout << "Heightfield: " << columns << " x " << rows << " cells of " << this->cellSize << ", "
+		<< levels.size() << " levels, " << memoryBytes() / (1024.0 * 1024.0) << " MB" << std::endl;
+}
+
+// 把三角形自上而下投影到格网，格网中心落在三角形内时取插值高程；
+// 覆盖不到任何格网中心的小三角形用顶点高程写入所在格网
+void HeightfieldEngine::rasterizeMesh(const TileMesh& mesh, TileId tileId, int rowBegin, int rowEnd) {
+	std::vector<float>& heights = levels[0].maxHeight;
+	auto writeCell = [&](int col, int row, double height) {
+		size_t cell = static_cast<size_t>(row) * columns + col;
+		if (height > heights[cell]) {
+			heights[cell] = static_cast<float>(height);
+			cellTiles[cell] = tileId;
+		}
+	};
+
+	for (size_t t = 0; t < mesh.numTriangles(); ++t) {
+		double gx[3], gz[3], h[3];
+		for (int i = 0; i < 3; ++i) {
+			const osg::Vec3f& v = mesh.vertices[mesh.indices[t * 3 + i]];
+			gx[i] = (v.x() - originX) / cellSize;
+			gz[i] = (v.z() - originZ) / cellSize;
+			h[i] = heightOf(v);
+		}
+		double minZ = std::min({ gz[0], gz[1], gz[2] }), maxZ = std::max({ gz[0], gz[1], gz[2] });
+		if (maxZ < rowBegin || minZ >= rowEnd) continue;
+
+		for (int i = 0; i < 3; ++i) {
+			int col = std::min(columns - 1, std::max(0, static_cast<int>(gx[i])));
+			int row = std::min(rows - 1, std::max(0, static_cast<int>(gz[i])));
+			if (row >= rowBegin && row < rowEnd) writeCell(col, row, h[i]);
+		}
+
+		double area = (gx[1] - gx[0]) * (gz[2] - gz[0]) - (gz[1] - gz[0]) * (gx[2] - gx[0]);
+		if (std::fabs(area) < 1e-12) continue; // 竖直面在 DSM 中只保留顶点
+		double minX = std::min({ gx[0], gx[1], gx[2] }), maxX = std::max({ gx[0], gx[1], gx[2] });
+		int col0 = std::max(0, static_cast<int>(std::ceil(minX - 0.5)));
+		int col1 = std::min(columns - 1, static_cast<int>(std::floor(maxX - 0.5)));
+		int row0 = std::max(rowBegin, static_cast<int>(std::ceil(minZ - 0.5)));
+		int row1 = std::min(rowEnd - 1, static_cast<int>(std::floor(maxZ - 0.5)));
+		for (int row = row0; row <= row1; ++row) {
+			double pz = row + 0.5;
+			for (int col = col0; col <= col1; ++col) {
+				double px = col + 0.5;
+				double w0 = ((gx[1] - px) * (gz[2] - pz) - (gz[1] - pz) * (gx[2] - px)) / area;
+				double w1 = ((gx[2] - px) * (gz[0] - pz) - (gz[2] - pz) * (gx[0] - px)) / area;
+				double w2 = 1.0 - w0 - w1;
+				if (w0 < 0.0 || w1 < 0.0 || w2 < 0.0) continue;
+				writeCell(col, row, w0 * h[0] + w1 * h[1] + w2 * h[2]);
+			}
+		}
+	}
+}
+
+void HeightfieldEngine::buildPyramid() {
+	while (levels.back().columns > 1 || levels.back().rows > 1) {
+		const Level& fine = levels.back();
+		Level coarse;
+		coarse.columns = (fine.columns + 1) / 2;
+		coarse.rows = (fine.rows + 1) / 2;
+		coarse.maxHeight.assign(static_cast<size_t>(coarse.columns) * coarse.rows, kEmptyHeight);
+		for (int row = 0; row < fine.rows; ++row) {
+			for (int col = 0; col < fine.columns; ++col) {
+				float& parent = coarse.maxHeight[static_cast<size_t>(row / 2) * coarse.columns + col / 2];
+				parent = std::max(parent, fine.maxHeight[static_cast<size_t>(row) * fine.columns + col]);
+			}
+		}
+		levels.push_back(std::move(coarse));
+	}
+}
+
+size_t HeightfieldEngine::memoryBytes() const {
+	size_t bytes = cellTiles.size() * sizeof(TileId);
+	for (const Level& level : levels) {
+		bytes += level.maxHeight.size() * sizeof(float);
+	}
+	return bytes;
+}
+
+TileId HeightfieldEngine::traceRay(const osg::Vec3d& start, const osg::Vec3d& end) const {
+	if (levels.empty() || start == end) return kInvalidTileId;
+
+	// 转换到格网坐标：p(t) = (x0 + t * dx, z0 + t * dz)，高程 h(t) = h0 + t * dh，t ∈ [0, 1]
+	const double x0 = (start.x() - originX) / cellSize, dx = (end.x() - start.x()) / cellSize;
+	const double z0 = (start.z() - originZ) / cellSize, dz = (end.z() - start.z()) / cellSize;
+	const double h0 = -start.y(), dh = -(end.y() - start.y());
+
+	// 先裁剪到格网范围
+	double tBegin = 0.0, tEnd = 1.0;
+	const double origin[2] = { x0, z0 }, direction[2] = { dx, dz }, extent[2] = { double(columns), double(rows) };
+	for (int axis = 0; axis < 2; ++axis) {
+		if (direction[axis] == 0.0) {
+			if (origin[axis] < 0.0 || origin[axis] >= extent[axis]) return kInvalidTileId;
+			continue;
+		}
+		double t0 = (0.0 - origin[axis]) / direction[axis];
+		double t1 = (extent[axis] - origin[axis]) / direction[axis];
+		if (t0 > t1) std::swap(t0, t1);
+		tBegin = std::max(tBegin, t0);
+		tEnd = std::min(tEnd, t1);
+	}
+	if (tBegin > tEnd) return kInvalidTileId;
+
+	// 保证每步至少前进约 1e-6 个格网，避免停在格网边界上
+	const double planarSpeed = std::max(std::fabs(dx), std::fabs(dz));
+	const double tEpsilon = planarSpeed > 0.0 ? 1e-6 / planarSpeed : 0.0;
+	const int topLevel = static_cast<int>(levels.size()) - 1;
+	int level = topLevel;
+	double t = tBegin;
+	while (t <= tEnd) {
+		double tProbe = std::min(t + tEpsilon, tEnd);
+		int col = static_cast<int>(std::floor(x0 + tProbe * dx));
+		int row = static_cast<int>(std::floor(z0 + tProbe * dz));
+		if (col < 0 || row < 0 || col >= columns || row >= rows) break;
+
+		// 当前层节点覆盖 [col >> level << level, ...) 范围的原始格网
+		const int span = 1 << level;
+		const int nodeCol = col >> level, nodeRow = row >> level;
+		double tExit = tEnd;
+		if (dx > 0.0) tExit = std::min(tExit, ((nodeCol + 1) * span - x0) / dx);
+		else if (dx < 0.0) tExit = std::min(tExit, (nodeCol * span - x0) / dx);
+		if (dz > 0.0) tExit = std::min(tExit, ((nodeRow + 1) * span - z0) / dz);
+		else if (dz < 0.0) tExit = std::min(tExit, (nodeRow * span - z0) / dz);
+		tExit = std::max(tExit, tProbe);
+
+		const Level& current = levels[level];
+		float nodeHeight = current.maxHeight[static_cast<size_t>(nodeRow) * current.columns + nodeCol];
+		double rayLow = std::min(h0 + t * dh, h0 + tExit * dh);
+		if (rayLow > nodeHeight) {
+			// 射线在该节点范围内始终高于最高表面，跳过整个节点并回到更粗的层
+			if (tExit >= tEnd) break;
+			t = tExit;
+			level = std::min(level + 1, topLevel);
+		}
+		else if (level > 0) {
+			--level;
+		}
+		else {
+			return cellTiles[static_cast<size_t>(row) * columns + col];
+		}
+	}
+	return kInvalidTileId;
+}
+
+std::vector<TileId> HeightfieldEngine::traceRays(const std::vector<std::pair<osg::Vec3d, osg::Vec3d>>& rays) const {
+	std::vector<TileId> rayTiles(rays.size(), kInvalidTileId);
+	std::atomic<size_t> next(0);
+	const size_t batch = 256;
+	auto worker = [&]() {
+		for (size_t begin = next.fetch_add(batch); begin < rays.size(); begin = next.fetch_add(batch)) {
+			size_t end = std::min(rays.size(), begin + batch);
+			for (size_t i = begin; i < end; ++i) {
+				rayTiles[i] = traceRay(rays[i].first, rays[i].second);
+			}
+		}
+	};
+	// 照片本身已是共享线程池中的任务，射线批次在同一线程池中展开，不另开线程
+	TaskGroup tasks(ThreadPool::shared());
+	for (unsigned int i = 0; i < numThreads; ++i) {
+		tasks.run(worker);
+	}
+	tasks.wait();
+	return rayTiles;
+}
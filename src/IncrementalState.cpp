@@ -0,0 +1,183 @@
+#include "IncrementalState.h"
+#include <charconv>
+#include <type_traits>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+template <typename T>
+static void appendNumber(std::string& line, T value) {
+	char digits[32];
+	std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+	line.append(digits, result.ptr);
+}
+
+static void appendHash(std::string& line, uint64_t value) {
+	char digits[32];
+	std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value, 16);
+	line.append(digits, result.ptr);
+}
+
+// 逗号分隔的字段，最后一个字段可以包含逗号（名称、路径、签名）
+static const char* const kStateHeaderV2 = "# PhotoMapping incremental state v2";
+
+static std::vector<std::string> splitFields(const std::string& line, size_t numFields) {
+	std::vector<std::string> fields;
+	std::string::size_type start = 0;
+	while (fields.size() + 1 < numFields) {
+		std::string::size_type comma = line.find(',', start);
+		if (comma == std::string::npos) break;
+		fields.push_back(line.substr(start, comma - start));
+		start = comma + 1;
+	}
+	fields.push_back(line.substr(start));
+	return fields;
+}
+
+template <typename T>
+static T parseNumber(const std::string& field, const std::string& line, int base = 10) {
+	T value = T();
+	std::from_chars_result result;
+	if constexpr (std::is_floating_point<T>::value) {
+		result = std::from_chars(field.data(), field.data() + field.size(), value);
+	}
+	else {
+		result = std::from_chars(field.data(), field.data() + field.size(), value, base);
+	}
+	if (result.ec != std::errc() || result.ptr != field.data() + field.size()) {
+		throw std::runtime_error("Malformed incremental state line: " + line);
+	}
+	return value;
+}
+
+bool readIncrementalState(const std::string& path, IncrementalState& state) {
+	std::ifstream in(path.c_str());
+	if (!in) return false;
+	state = IncrementalState();
+	std::unordered_map<int, size_t> photoSlots;
+	std::string line;
+	// v1 的 tile 行没有文件签名，读回时签名为 0，下次运行会重新计算这些 tile 的内容哈希
+	bool hasStamps = false;
+	while (std::getline(in, line)) {
+		if (!line.empty() && line.back() == '\r') line.pop_back();
+		if (line == kStateHeaderV2) hasStamps = true;
+		if (line.empty() || line[0] == '#') continue;
+		if (line.size() < 2 || line[1] != ',') throw std::runtime_error("Malformed incremental state line: " + line);
+		const std::string body = line.substr(2);
+		switch (line[0]) {
+		case 'K':
+			state.runKey = body;
+			break;
+		case 'T': {
+			const size_t numFields = hasStamps ? 11 : 10;
+			std::vector<std::string> fields = splitFields(body, numFields);
+			if (fields.size() != numFields || parseNumber<size_t>(fields[0], line) != state.tiles.size()) {
+				throw std::runtime_error("Malformed incremental state line: " + line);
+			}
+			TileSummary tile;
+			size_t field = 1;
+			tile.contentHash = parseNumber<uint64_t>(fields[field++], line, 16);
+			if (hasStamps) tile.sourceStamp = parseNumber<uint64_t>(fields[field++], line, 16);
+			tile.triangles = parseNumber<size_t>(fields[field++], line);
+			float bounds[6];
+			for (int i = 0; i < 6; ++i) bounds[i] = parseNumber<float>(fields[field++], line);
+			tile.bbox = osg::BoundingBox(bounds[0], bounds[1], bounds[2], bounds[3], bounds[4], bounds[5]);
+			tile.name = fields[field];
+			state.tiles.push_back(tile);
+			break;
+		}
+		case 'P': {
+			std::vector<std::string> fields = splitFields(body, 5);
+			if (fields.size() != 5) throw std::runtime_error("Malformed incremental state line: " + line);
+			IncrementalPhoto photo;
+			photo.index = parseNumber<int>(fields[0], line);
+			photo.inputHash = parseNumber<uint64_t>(fields[1], line, 16);
+			photo.hasResult = fields[2] == "1";
+			std::istringstream dependencies(fields[3]);
+			std::string dependency;
+			while (dependencies >> dependency) {
+				TileId id = parseNumber<TileId>(dependency, line);
+				if (id >= state.tiles.size()) throw std::runtime_error("Unknown tile in incremental state line: " + line);
+				photo.dependencies.push_back(id);
+			}
+			photo.imagePath = fields[4];
+			photoSlots[photo.index] = state.photos.size();
+			state.photos.push_back(photo);
+			break;
+		}
+		case 'C': {
+			std::vector<std::string> fields = splitFields(body, 3);
+			if (fields.size() != 3) throw std::runtime_error("Malformed incremental state line: " + line);
+			auto slot = photoSlots.find(parseNumber<int>(fields[0], line));
+			TileId id = parseNumber<TileId>(fields[1], line);
+			if (slot == photoSlots.end() || id >= state.tiles.size()) {
+				throw std::runtime_error("Unknown photo or tile in incremental state line: " + line);
+			}
+			state.photos[slot->second].results.push_back({ id, parseNumber<double>(fields[2], line) });
+			break;
+		}
+		default:
+			throw std::runtime_error("Malformed incremental state line: " + line);
+		}
+	}
+	return true;
+}
+
+void writeIncrementalState(const std::string& path, const IncrementalState& state) {
+	const std::string temporary = path + ".tmp";
+	{
+		std::ofstream out(temporary.c_str());
+		if (!out) throw std::runtime_error("Unable to write incremental state: " + temporary);
+		out << kStateHeaderV2 << "\n";
+		out << "K," << state.runKey << "\n";
+		std::string line;
+		for (size_t id = 0; id < state.tiles.size(); ++id) {
+			const TileSummary& tile = state.tiles[id];
+			line = "T,";
+			appendNumber(line, id);
+			line += ',';
+			appendHash(line, tile.contentHash);
+			line += ',';
+			appendHash(line, tile.sourceStamp);
+			line += ',';
+			appendNumber(line, tile.triangles);
+			for (int i = 0; i < 6; ++i) {
+				line += ',';
+				appendNumber(line, i < 3 ? tile.bbox._min[i] : tile.bbox._max[i - 3]);
+			}
+			line += ',';
+			line += tile.name;
+			out << line << '\n';
+		}
+		for (const IncrementalPhoto& photo : state.photos) {
+			line = "P,";
+			appendNumber(line, photo.index);
+			line += ',';
+			appendHash(line, photo.inputHash);
+			line += photo.hasResult ? ",1," : ",0,";
+			for (size_t i = 0; i < photo.dependencies.size(); ++i) {
+				if (i > 0) line += ' ';
+				appendNumber(line, photo.dependencies[i]);
+			}
+			line += ',';
+			line += photo.imagePath;
+			out << line << '\n';
+			for (const TileIntersectionResult& result : photo.results) {
+				line = "C,";
+				appendNumber(line, photo.index);
+				line += ',';
+				appendNumber(line, result.tileId);
+				line += ',';
+				appendNumber(line, result.percentage);
+				out << line << '\n';
+			}
+		}
+		if (!out) throw std::runtime_error("Unable to write incremental state: " + temporary);
+	}
+	if (std::rename(temporary.c_str(), path.c_str()) != 0
+		&& (std::remove(path.c_str()) != 0 || std::rename(temporary.c_str(), path.c_str()) != 0)) {
+		throw std::runtime_error("Failed to rename " + temporary + " to " + path);
+	}
+}
@@ -0,0 +1,201 @@
+#include "MeshBvh.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+// 分箱 SAH 的箱数
+static const int kSahBins = 16;
+// 超过该深度后改为按中位数划分，保证深度不超过 kMaxBvhDepth
+static const uint32_t kMedianSplitDepth = 48;
+// 图元数超过该值的子树作为独立任务构建
+static const uint32_t kParallelBuildThreshold = 16384;
+
+namespace {
+
+struct BvhBuildContext {
+	const std::vector<osg::BoundingBox>& primitiveBounds;
+	std::vector<osg::Vec3f> centroids;
+	std::vector<uint32_t>& primitiveIndices;
+	std::vector<BvhNode>& nodes;
+	std::atomic<uint32_t> nodeCount;
+	uint32_t maxLeafSize;
+	TaskGroup* tasks;
+
+	BvhBuildContext(const std::vector<osg::BoundingBox>& primitiveBounds, std::vector<uint32_t>& primitiveIndices,
+		std::vector<BvhNode>& nodes, uint32_t maxLeafSize, TaskGroup* tasks)
+		: primitiveBounds(primitiveBounds), centroids(primitiveBounds.size()), primitiveIndices(primitiveIndices),
+		nodes(nodes), nodeCount(1), maxLeafSize(maxLeafSize), tasks(tasks) {}
+};
+
+struct SahBin {
+	osg::BoundingBox bounds;
+	uint32_t count = 0;
+};
+
+void buildNode(BvhBuildContext& context, uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t depth) {
+	osg::BoundingBox bounds, centroidBounds;
+	for (uint32_t i = first; i < first + count; ++i) {
+		uint32_t primitive = context.primitiveIndices[i];
+		bounds.expandBy(context.primitiveBounds[primitive]);
+		centroidBounds.expandBy(context.centroids[primitive]);
+	}
+	BvhNode& node = context.nodes[nodeIndex];
+	node.bounds = bounds;
+	node.first = first;
+	node.count = count;
+	if (count <= 1) return;
+
+	uint32_t* begin = context.primitiveIndices.data() + first;
+	uint32_t* end = begin + count;
+	uint32_t* middle = nullptr;
+
+	if (depth < kMedianSplitDepth) {
+		// 在三个轴上分箱，扫描求 SAH 代价最小的划分
+		float bestCost = std::numeric_limits<float>::max();
+		int bestAxis = -1, bestSplit = 0;
+		for (int axis = 0; axis < 3; ++axis) {
+			const float axisMin = centroidBounds._min[axis];
+			const float axisExtent = centroidBounds._max[axis] - axisMin;
+			if (axisExtent <= 0.0f) continue;
+			const float binScale = kSahBins / axisExtent;
+			SahBin bins[kSahBins];
+			for (uint32_t i = first; i < first + count; ++i) {
+				uint32_t primitive = context.primitiveIndices[i];
+				int bin = std::min(kSahBins - 1, static_cast<int>((context.centroids[primitive][axis] - axisMin) * binScale));
+				bins[bin].count++;
+				bins[bin].bounds.expandBy(context.primitiveBounds[primitive]);
+			}
+			float rightArea[kSahBins];
+			uint32_t rightCount[kSahBins];
+			osg::BoundingBox accumulated;
+			uint32_t accumulatedCount = 0;
+			for (int bin = kSahBins - 1; bin > 0; --bin) {
+				accumulated.expandBy(bins[bin].bounds);
+				accumulatedCount += bins[bin].count;
+				rightArea[bin] = accumulated.valid() ? bvhSurfaceArea(accumulated) : 0.0f;
+				rightCount[bin] = accumulatedCount;
+			}
+			accumulated.init();
+			accumulatedCount = 0;
+			for (int split = 1; split < kSahBins; ++split) {
+				accumulated.expandBy(bins[split - 1].bounds);
+				accumulatedCount += bins[split - 1].count;
+				if (accumulatedCount == 0 || rightCount[split] == 0) continue;
+				float cost = bvhSurfaceArea(accumulated) * accumulatedCount + rightArea[split] * rightCount[split];
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = split;
+				}
+			}
+		}
+
+		if (bestAxis >= 0) {
+			// 叶子代价为图元数，划分代价为 1 次遍历加上子节点按表面积加权的图元数
+			float nodeArea = bvhSurfaceArea(bounds);
+			float splitCost = 1.0f + (nodeArea > 0.0f ? bestCost / nodeArea : static_cast<float>(count));
+			if (count <= context.maxLeafSize && splitCost >= static_cast<float>(count)) return;
+
+			const float axisMin = centroidBounds._min[bestAxis];
+			const float binScale = kSahBins / (centroidBounds._max[bestAxis] - axisMin);
+			middle = std::partition(begin, end, [&](uint32_t primitive) {
+				int bin = std::min(kSahBins - 1, static_cast<int>((context.centroids[primitive][bestAxis] - axisMin) * binScale));
+				return bin < bestSplit;
+			});
+		}
+		else if (count <= context.maxLeafSize) {
+			return;  // 质心重合，无法划分
+		}
+	}
+	else if (count <= context.maxLeafSize) {
+		return;
+	}
+
+	if (!middle || middle == begin || middle == end) {
+		// 按最长轴的中位数划分，质心全部重合时等价于按下标对半
+		osg::Vec3f extent = centroidBounds._max - centroidBounds._min;
+		int axis = extent.x() >= extent.y() && extent.x() >= extent.z() ? 0 : (extent.y() >= extent.z() ? 1 : 2);
+		middle = begin + count / 2;
+		std::nth_element(begin, middle, end, [&](uint32_t a, uint32_t b) {
+			return context.centroids[a][axis] < context.centroids[b][axis];
+		});
+	}
+
+	const uint32_t leftCount = static_cast<uint32_t>(middle - begin);
+	const uint32_t children = context.nodeCount.fetch_add(2);
+	node.count = 0;
+	node.children[0] = children;
+	node.children[1] = children + 1;
+	if (context.tasks && leftCount > kParallelBuildThreshold) {
+		context.tasks->run([&context, children, first, leftCount, depth]() {
+			buildNode(context, children, first, leftCount, depth + 1);
+		});
+	}
+	else {
+		buildNode(context, children, first, leftCount, depth + 1);
+	}
+	buildNode(context, children + 1, first + leftCount, count - leftCount, depth + 1);
+}
+
+} // namespace
+
+void Bvh::build(const std::vector<osg::BoundingBox>& primitiveBounds, uint32_t maxLeafSize, ThreadPool* pool) {
+	nodes.clear();
+	primitiveIndices.resize(primitiveBounds.size());
+	if (primitiveBounds.empty()) return;
+
+	// 二叉树最多 2N - 1 个节点，预先分配后各任务按原子计数写入互不重叠的位置
+	nodes.resize(primitiveBounds.size() * 2);
+	const bool parallel = pool && primitiveBounds.size() > kParallelBuildThreshold;
+	TaskGroup tasks(parallel ? *pool : ThreadPool::shared());
+	BvhBuildContext context(primitiveBounds, primitiveIndices, nodes, std::max(1u, std::min(maxLeafSize, 255u)),
+		parallel ? &tasks : nullptr);
+	for (size_t i = 0; i < primitiveBounds.size(); ++i) {
+		primitiveIndices[i] = static_cast<uint32_t>(i);
+		context.centroids[i] = primitiveBounds[i].center();
+	}
+	buildNode(context, 0, 0, static_cast<uint32_t>(primitiveBounds.size()), 0);
+	tasks.wait();
+	nodes.resize(context.nodeCount.load());
+	nodes.shrink_to_fit();
+}
+
+BvhRay::BvhRay(const osg::Vec3d& start, const osg::Vec3d& end) : origin(start), direction(end - start) {
+	for (int axis = 0; axis < 3; ++axis) {
+		inverseDirection[axis] = direction[axis] != 0.0 ? 1.0 / direction[axis] : std::numeric_limits<double>::infinity();
+	}
+}
+
+bool intersectBvhBounds(const BvhRay& ray, const osg::BoundingBox& bounds, double tMax, double& tEnter) {
+	double t0 = 0.0, t1 = tMax;
+	for (int axis = 0; axis < 3; ++axis) {
+		double near = (bounds._min[axis] - ray.origin[axis]) * ray.inverseDirection[axis];
+		double far = (bounds._max[axis] - ray.origin[axis]) * ray.inverseDirection[axis];
+		// 方向分量为 0 且原点在板内时得到 NaN，此时该轴不限制区间
+		if (near > far) std::swap(near, far);
+		if (near > t0) t0 = near;
+		if (far < t1) t1 = far;
+		if (t0 > t1) return false;
+	}
+	tEnter = t0;
+	return true;
+}
+
+bool intersectBvhTriangle(const BvhRay& ray, const osg::Vec3d& v0, const osg::Vec3d& v1, const osg::Vec3d& v2, double& t) {
+	const osg::Vec3d edge1 = v1 - v0;
+	const osg::Vec3d edge2 = v2 - v0;
+	const osg::Vec3d p = ray.direction ^ edge2;
+	const double det = edge1 * p;
+	if (std::fabs(det) < 1e-20) return false;
+	const double inverseDet = 1.0 / det;
+	const osg::Vec3d s = ray.origin - v0;
+	const double u = (s * p) * inverseDet;
+	if (u < 0.0 || u > 1.0) return false;
+	const osg::Vec3d q = s ^ edge1;
+	const double v = (ray.direction * q) * inverseDet;
+	if (v < 0.0 || u + v > 1.0) return false;
+	t = (edge2 * q) * inverseDet;
+	return true;
+}
@@ -0,0 +1,84 @@
+#include "ModelMetadata.h"
+#include "tinyxml2.h"
+#include <stdexcept>
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <cmath>
+
+ModelMetadata loadModelMetadata(const std::string& metadataFile) {
+	ModelMetadata metadata;
+	metadata.srsOrigin[0] = metadata.srsOrigin[1] = metadata.srsOrigin[2] = 0.0;
+	metadata.hasOrigin = false;
+	if (!std::ifstream(metadataFile)) {
+		std::cout << "No model metadata at " << metadataFile << ", using zero SRS origin." << std::endl;
+		return metadata;
+	}
+
+	tinyxml2::XMLDocument doc;
+	if (doc.LoadFile(metadataFile.c_str()) != tinyxml2::XML_SUCCESS) {
+		throw std::runtime_error("Failed to load model metadata: " + metadataFile);
+	}
+	tinyxml2::XMLElement* root = doc.FirstChildElement("ModelMetadata");
+	if (!root) {
+		throw std::runtime_error("ModelMetadata element not found in " + metadataFile);
+	}
+	tinyxml2::XMLElement* srsElement = root->FirstChildElement("SRS");
+	if (srsElement && srsElement->GetText()) metadata.srs = srsElement->GetText();
+
+	tinyxml2::XMLElement* originElement = root->FirstChildElement("SRSOrigin");
+	if (originElement && originElement->GetText()) {
+		// 形如 "500000,2500000,0"，缺省的分量按 0 处理
+		std::stringstream ss(originElement->GetText());
+		std::string item;
+		int axis = 0;
+		while (axis < 3 && std::getline(ss, item, ',')) {
+			metadata.srsOrigin[axis++] = std::stod(item);
+		}
+		if (axis == 0) {
+			throw std::runtime_error("Invalid SRSOrigin in " + metadataFile);
+		}
+		metadata.hasOrigin = true;
+	}
+
+	std::cout << "Model SRS " << (metadata.srs.empty() ? "(unknown)" : metadata.srs) << ", origin ("
+		<< std::fixed << metadata.srsOrigin[0] << ", " << metadata.srsOrigin[1] << ", " << metadata.srsOrigin[2] << ")"
+		<< std::defaultfloat << std::endl;
+	return metadata;
+}
+
+PhotoFrame parsePhotoFrame(const std::string& name) {
+	if (name == "auto") return PhotoFrame::Auto;
+	if (name == "local") return PhotoFrame::Local;
+	if (name == "srs") return PhotoFrame::Srs;
+	throw std::runtime_error("photo-frame must be auto, local or srs");
+}
+
+bool convertPhotosToLocalFrame(std::vector<PhotoInfo>& photoInfos, const ModelMetadata& metadata, PhotoFrame frame,
+	const osg::BoundingBox& sceneBounds) {
+	if (frame == PhotoFrame::Local || !metadata.hasOrigin || photoInfos.empty()) return false;
+
+	if (frame == PhotoFrame::Auto) {
+		if (!sceneBounds.valid()) return false;
+		// 场景坐标 (x, -z, y) 对应 ENU (x, y, z)，只比较水平方向
+		double sceneX = sceneBounds.center().x(), sceneY = sceneBounds.center().z();
+		double meanX = 0.0, meanY = 0.0;
+		for (const PhotoInfo& info : photoInfos) {
+			meanX += info.pose.center[0];
+			meanY += info.pose.center[1];
+		}
+		meanX /= photoInfos.size();
+		meanY /= photoInfos.size();
+		double localDistance = std::hypot(meanX - sceneX, meanY - sceneY);
+		double srsDistance = std::hypot(meanX - metadata.srsOrigin[0] - sceneX, meanY - metadata.srsOrigin[1] - sceneY);
+		if (localDistance <= srsDistance) return false;
+	}
+
+	for (PhotoInfo& info : photoInfos) {
+		for (int axis = 0; axis < 3; ++axis) {
+			info.pose.center[axis] -= metadata.srsOrigin[axis];
+		}
+	}
+	std::cout << "Photo centers shifted by SRS origin into the mesh local frame." << std::endl;
+	return true;
+}
@@ -0,0 +1,84 @@
+#include "OutOfCorePlanner.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+// 把 16 位整数的各位间隔展开，用于交织出 Morton 码
+static uint32_t spreadBits(uint32_t value) {
+	value &= 0xFFFF;
+	value = (value | (value << 8)) & 0x00FF00FF;
+	value = (value | (value << 4)) & 0x0F0F0F0F;
+	value = (value | (value << 2)) & 0x33333333;
+	value = (value | (value << 1)) & 0x55555555;
+	return value;
+}
+
+std::vector<size_t> groundMortonOrder(const std::vector<double>& groundX, const std::vector<double>& groundZ) {
+	std::vector<size_t> order;
+	if (groundX.empty()) return order;
+	// 地面位置量化到 16 位后按 Morton 码排序
+	double minX = *std::min_element(groundX.begin(), groundX.end()), maxX = *std::max_element(groundX.begin(), groundX.end());
+	double minZ = *std::min_element(groundZ.begin(), groundZ.end()), maxZ = *std::max_element(groundZ.begin(), groundZ.end());
+	const double scaleX = maxX > minX ? 65535.0 / (maxX - minX) : 0.0;
+	const double scaleZ = maxZ > minZ ? 65535.0 / (maxZ - minZ) : 0.0;
+	std::vector<std::pair<uint32_t, size_t>> codes;
+	codes.reserve(groundX.size());
+	for (size_t i = 0; i < groundX.size(); ++i) {
+		uint32_t x = static_cast<uint32_t>((groundX[i] - minX) * scaleX);
+		uint32_t z = static_cast<uint32_t>((groundZ[i] - minZ) * scaleZ);
+		codes.push_back({ spreadBits(x) | (spreadBits(z) << 1), i });
+	}
+	std::sort(codes.begin(), codes.end());
+	for (const auto& code : codes) order.push_back(code.second);
+	return order;
+}
+
+std::vector<PhotoBatch> planPhotoBatches(const std::vector<PhotoWorkItem>& items, const std::vector<size_t>& tileBytes,
+	size_t budgetBytes) {
+	std::vector<PhotoBatch> batches;
+	if (items.empty()) return batches;
+
+	std::vector<double> groundX, groundZ;
+	for (const PhotoWorkItem& item : items) {
+		groundX.push_back(item.groundX);
+		groundZ.push_back(item.groundZ);
+	}
+	const std::vector<size_t> order = groundMortonOrder(groundX, groundZ);
+
+	std::vector<char> inBatch(tileBytes.size(), 0);
+	PhotoBatch current = { {}, {}, 0 };
+	auto closeBatch = [&]() {
+		for (TileId id : current.tiles) inBatch[id] = 0;
+		std::sort(current.tiles.begin(), current.tiles.end());
+		batches.push_back(std::move(current));
+		current = PhotoBatch{ {}, {}, 0 };
+	};
+
+	for (size_t index : order) {
+		const PhotoWorkItem& item = items[index];
+		size_t ownBytes = 0, addedBytes = 0;
+		for (TileId id : item.tiles) {
+			ownBytes += tileBytes[id];
+			if (!inBatch[id]) addedBytes += tileBytes[id];
+		}
+		if (ownBytes > budgetBytes) {
+			throw std::runtime_error("Photo #" + std::to_string(item.photoIndex) + " needs " + std::to_string(ownBytes >> 20)
+				+ " MB of tiles, more than the memory budget of " + std::to_string(budgetBytes >> 20) + " MB");
+		}
+		if (!current.photoIndices.empty() && current.estimatedBytes + addedBytes > budgetBytes) {
+			closeBatch();
+			addedBytes = ownBytes;
+		}
+		current.photoIndices.push_back(item.photoIndex);
+		current.estimatedBytes += addedBytes;
+		for (TileId id : item.tiles) {
+			if (inBatch[id]) continue;
+			inBatch[id] = 1;
+			current.tiles.push_back(id);
+		}
+	}
+	if (!current.photoIndices.empty()) closeBatch();
+	return batches;
+}
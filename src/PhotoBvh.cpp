@@ -0,0 +1,91 @@
+#include "PhotoBvh.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include "ThreadPool.h"
+
+// 部分位于视锥体内的节点最多细分到这一深度，避免保留的子树过多
+static const uint32_t kMaxCullDepth = 8;
+
+// 待裁剪的子节点引用及其包围盒
+struct CullEntry {
+	uint32_t ref;
+	uint32_t count;
+	osg::BoundingBox bounds;
+	uint32_t depth;
+};
+
+template <int Width>
+PhotoBvh<Width>::PhotoBvh(const std::vector<const TileBvh<Width>*>& tileBvhs,
+	const std::vector<NamedBoundingBox>& intersectingTiles, const FrustumPlanes& frustum)
+	: tileBvhs(tileBvhs), visitedNodes(0) {
+	std::vector<osg::BoundingBox> subtreeBounds;
+	std::vector<CullEntry> stack;
+	for (const NamedBoundingBox& tile : intersectingTiles) {
+		const TileBvh<Width>* tileBvh = tileBvhs[tile.id];
+		if (!tileBvh || tileBvh->bvh.empty()) continue;
+		const WideBvh<Width>& bvh = tileBvh->bvh;
+		stack.assign(1, CullEntry{ bvh.getRoot(), bvh.getRootCount(), bvh.getBounds(), 0 });
+		while (!stack.empty()) {
+			CullEntry entry = stack.back();
+			stack.pop_back();
+			++visitedNodes;
+			int side = frustum.classify(entry.bounds);
+			if (side == 0) continue;
+			if (side == 2 || (entry.ref & kBvhLeafFlag) || entry.depth >= kMaxCullDepth) {
+				subtrees.push_back({ tile.id, entry.ref, entry.count });
+				subtreeBounds.push_back(entry.bounds);
+				continue;
+			}
+			const typename WideBvh<Width>::Node& node = bvh.getNodes()[entry.ref];
+			for (int slot = 0; slot < Width; ++slot) {
+				if (node.children[slot] == kBvhEmptyChild) continue;
+				stack.push_back(CullEntry{ node.children[slot], node.counts[slot], node.childBounds(slot), entry.depth + 1 });
+			}
+		}
+	}
+	topLevel.build(subtreeBounds, 1);
+}
+
+template <int Width>
+TileId PhotoBvh<Width>::trace(const std::pair<osg::Vec3d, osg::Vec3d>& ray) const {
+	if (ray.first == ray.second || topLevel.empty()) return kInvalidTileId;
+	BvhRay bvhRay(ray.first, ray.second);
+	double tMax = 1.0;
+	TileId closestTile = kInvalidTileId;
+	traverseBvh(topLevel, bvhRay, 0, tMax, [&](uint32_t primitive, double& tNearest) {
+		const BvhSubtree& subtree = subtrees[primitive];
+		if (tileBvhs[subtree.tileId]->intersect(bvhRay, subtree.ref, subtree.count, tNearest)) {
+			closestTile = subtree.tileId;
+			return true;
+		}
+		return false;
+	});
+	return closestTile;
+}
+
+template <int Width>
+std::vector<TileId> PhotoBvh<Width>::traceRays(const std::vector<std::pair<osg::Vec3d, osg::Vec3d>>& rays,
+	unsigned int numThreads) const {
+	std::vector<TileId> rayTiles(rays.size(), kInvalidTileId);
+	if (numThreads == 0) numThreads = ThreadPool::shared().size();
+	const size_t batch = 256;
+	std::atomic<size_t> next(0);
+	auto worker = [&]() {
+		for (size_t begin = next.fetch_add(batch); begin < rays.size(); begin = next.fetch_add(batch)) {
+			size_t end = std::min(rays.size(), begin + batch);
+			for (size_t i = begin; i < end; ++i) {
+				rayTiles[i] = trace(rays[i]);
+			}
+		}
+	};
+	TaskGroup tasks(ThreadPool::shared());
+	for (unsigned int i = 0; i < numThreads; ++i) {
+		tasks.run(worker);
+	}
+	tasks.wait();
+	return rayTiles;
+}
+
+template class PhotoBvh<4>;
+template class PhotoBvh<8>;
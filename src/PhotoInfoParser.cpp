@@ -1,4 +1,5 @@
 #include "PhotoInfoParser.h"
+#include "ContentHash.h"
 #include <stdexcept>
 #include <cmath>
 #include <iostream>
@@ -7,6 +8,18 @@
 #define M_PI 3.14159265358979323846
 #endif
 
+uint64_t hashPhotoInfo(const PhotoInfo& photoInfo) {
+	uint64_t hash = hashString(photoInfo.imagePath, kHashSeed);
+	hash = hashValue(photoInfo.imageWidth, hash);
+	hash = hashValue(photoInfo.imageHeight, hash);
+	hash = hashValue(photoInfo.intrinsicMatrix, hash);
+	const DistortionCoefficients& distortion = photoInfo.distortion;
+	const double coefficients[5] = { distortion.k1, distortion.k2, distortion.k3, distortion.p1, distortion.p2 };
+	hash = hashValue(coefficients, hash);
+	hash = hashValue(photoInfo.pose.rotationMatrix, hash);
+	return hashValue(photoInfo.pose.center, hash);
+}
+
 PhotoInfoParser::PhotoInfoParser(const std::string& xmlFile) : xmlFile(xmlFile) {}
 
 std::vector<PhotoInfo> PhotoInfoParser::parsePhotoInfo() {
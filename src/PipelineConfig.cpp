@@ -0,0 +1,145 @@
+#include "PipelineConfig.h"
+#include <stdexcept>
+#include <iostream>
+
+static bool parseBool(const std::string& value) {
+	if (value == "1" || value == "true" || value == "on") return true;
+	if (value == "0" || value == "false" || value == "off") return false;
+	throw std::runtime_error("Invalid boolean value: " + value);
+}
+
+PipelineConfig parsePipelineConfig(int argc, char** argv) {
+	PipelineConfig config;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg(argv[i]);
+		if (arg.compare(0, 2, "--") != 0) {
+			throw std::runtime_error("Unexpected argument: " + arg);
+		}
+		std::string::size_type eq = arg.find('=');
+		std::string name = arg.substr(2, eq == std::string::npos ? std::string::npos : eq - 2);
+		// 不带值的开关等价于 =true
+		std::string value = eq == std::string::npos ? "true" : arg.substr(eq + 1);
+
+		if (name == "mode") config.mode = value;
+		else if (name == "xml") config.xmlFile = value;
+		else if (name == "mesh") config.meshFolder = value;
+		else if (name == "metadata") config.metadataFile = value;
+		else if (name == "photo-frame") config.photoFrame = value;
+		else if (name == "io-backend") config.ioBackend = value;
+		else if (name == "io-threads") config.ioThreads = std::stoi(value);
+		else if (name == "io-depth") config.ioDepth = std::stoi(value);
+		else if (name == "parse-threads") config.parseThreads = std::stoi(value);
+		else if (name == "load-buffer-mb") config.loadBufferMb = std::stoi(value);
+		else if (name == "memory-budget-mb") config.memoryBudgetMb = std::stoi(value);
+		else if (name == "shards") config.numShards = std::stoi(value);
+		else if (name == "shard") config.shardIndex = std::stoi(value);
+		else if (name == "shard-dir") config.shardDir = value;
+		else if (name == "tile-cache") config.tileCache = value;
+		else if (name == "checkpoint") config.checkpointFile = value;
+		else if (name == "resume") config.resume = parseBool(value);
+		else if (name == "incremental") config.incrementalFile = value;
+		else if (name == "result-cache") config.resultCacheDir = value;
+		else if (name == "result-cache-mb") config.resultCacheMb = std::stoi(value);
+		else if (name == "ray-labels") config.rayLabelsFile = value;
+		else if (name == "previous-xml") config.previousXmlFile = value;
+		else if (name == "previous-ray-labels") config.previousRayLabels = value;
+		else if (name == "delta-max-shift") config.deltaMaxShift = std::stod(value);
+		else if (name == "delta-max-rotation") config.deltaMaxRotation = std::stod(value);
+		else if (name == "delta-band") config.deltaBand = std::stoi(value);
+		else if (name == "output") config.outputCsv = value;
+		else if (name == "output-format") config.outputFormat = value;
+		else if (name == "coverage") config.computeCoverage = parseBool(value);
+		else if (name == "engine") config.coverageEngine = value;
+		else if (name == "tile-grid") config.useTileGrid = parseBool(value);
+		else if (name == "kdtree") config.buildKdTrees = parseBool(value);
+		else if (name == "bvh-width") config.bvhWidth = std::stoi(value);
+		else if (name == "dsm-cell") config.dsmCellSize = std::stod(value);
+		else if (name == "engine-report") config.engineReport = parseBool(value);
+		else if (name == "view") config.showViewer = parseBool(value);
+		else if (name == "bench-engines") config.benchEngines = value;
+		else if (name == "bench-photos") config.benchPhotos = std::stoi(value);
+		else if (name == "max-mismatch") config.benchMaxMismatch = std::stod(value);
+		else if (name == "max-coverage-error") config.benchMaxCoverageError = std::stod(value);
+		else if (name == "photo-begin") config.photoBegin = std::stoi(value);
+		else if (name == "photo-end") config.photoEnd = std::stoi(value);
+		else if (name == "ray-step") config.rayStep = std::stoi(value);
+		else if (name == "ray-length") config.rayLength = std::stod(value);
+		else if (name == "threshold") config.assignmentThreshold = std::stod(value);
+		else if (name == "refine") config.thresholdRefinement = parseBool(value);
+		else if (name == "coarse-step") config.coarseStep = std::stoi(value);
+		else if (name == "refine-band") config.refineBand = std::stod(value);
+		else if (name == "assign") config.assignTiles = parseBool(value);
+		else if (name == "assign-folder") config.assignFolder = value;
+		else if (name == "assign-input") config.assignInput = value;
+		else if (name == "link-mode") config.linkMode = value;
+		else if (name == "assign-threads") config.assignThreads = std::stoi(value);
+		else throw std::runtime_error("Unknown option: --" + name);
+	}
+
+	if (config.rayStep <= 0 || (config.thresholdRefinement && config.coarseStep < config.rayStep)) {
+		throw std::runtime_error("ray-step must be > 0, and coarse-step >= ray-step when refining");
+	}
+	if (config.photoBegin < 0) {
+		throw std::runtime_error("photo-begin must be >= 0");
+	}
+	if (config.mode != "run" && config.mode != "assign" && config.mode != "bench" && config.mode != "plan" && config.mode != "shard"
+		&& config.mode != "merge" && config.mode != "cache") {
+		throw std::runtime_error("mode must be run, assign, bench, plan, shard, merge or cache");
+	}
+	// 映射缓存时没有场景图，需要场景图的功能不能同时使用
+	if (!config.tileCache.empty() && (config.coverageEngine != "bvh" || config.memoryBudgetMb > 0 || config.thresholdRefinement
+		|| config.engineReport || config.mode == "bench")) {
+		throw std::runtime_error("tile-cache needs --engine=bvh and cannot be combined with memory-budget-mb, refine, engine-report or bench mode");
+	}
+	// 阈值细化只走 osg 场景图求交，其他引擎不会被使用
+	if (config.thresholdRefinement && config.coverageEngine != "osg") {
+		throw std::runtime_error("refine only supports --engine=osg");
+	}
+	if ((config.resume && config.checkpointFile.empty())
+		|| (!config.checkpointFile.empty() && !config.computeCoverage && !config.thresholdRefinement)) {
+		throw std::runtime_error("resume needs --checkpoint=<file>, and checkpoint needs --coverage or --refine");
+	}
+	if (!config.incrementalFile.empty() && ((config.mode != "run" && config.mode != "shard") || !config.checkpointFile.empty()
+		|| !config.tileCache.empty() || (!config.computeCoverage && !config.thresholdRefinement))) {
+		throw std::runtime_error("incremental needs run or shard mode with --coverage or --refine, without checkpoint or tile-cache");
+	}
+	// 结果缓存命中的照片不经过追踪，不能与依赖逐张追踪或另有结果来源的功能同用
+	if (!config.resultCacheDir.empty() && ((config.mode != "run" && config.mode != "shard") || config.resultCacheMb <= 0
+		|| (!config.computeCoverage && !config.thresholdRefinement) || !config.checkpointFile.empty() || !config.incrementalFile.empty()
+		|| !config.tileCache.empty() || !config.rayLabelsFile.empty() || !config.previousXmlFile.empty())) {
+		throw std::runtime_error("result-cache needs run or shard mode with --coverage or --refine and result-cache-mb > 0, "
+			"without checkpoint, incremental, tile-cache, ray-labels or previous-xml");
+	}
+	// 逐射线标签只在单遍采样时存在；raster 引擎按整幅采样网格光栅化，不能只重算部分射线
+	if ((!config.rayLabelsFile.empty() || !config.previousXmlFile.empty()) && (!config.computeCoverage || config.thresholdRefinement)) {
+		throw std::runtime_error("ray-labels and previous-xml need --coverage without --refine");
+	}
+	if (config.previousXmlFile.empty() != config.previousRayLabels.empty() || (!config.previousXmlFile.empty() && config.coverageEngine == "raster")) {
+		throw std::runtime_error("previous-xml and previous-ray-labels must be given together and need a ray-tracing engine");
+	}
+	if (config.deltaMaxShift < 0.0 || config.deltaMaxRotation < 0.0 || config.deltaBand < 0) {
+		throw std::runtime_error("delta-max-shift, delta-max-rotation and delta-band must be >= 0");
+	}
+	if (config.mode == "cache" && config.tileCache.empty()) {
+		throw std::runtime_error("cache mode needs --tile-cache=<file>");
+	}
+	if (config.numShards <= 0 || (config.mode == "shard" && (config.shardIndex < 0 || (!config.computeCoverage && !config.thresholdRefinement)))) {
+		throw std::runtime_error("shards must be > 0 and shard mode needs --shard=<index> and --coverage or --refine");
+	}
+	if (config.ioThreads <= 0 || config.ioDepth <= 0 || config.parseThreads < 0 || config.loadBufferMb <= 0) {
+		throw std::runtime_error("io-threads, io-depth and load-buffer-mb must be > 0, parse-threads >= 0");
+	}
+	if (config.ioBackend != "auto" && config.ioBackend != "uring" && config.ioBackend != "threads") {
+		throw std::runtime_error("io-backend must be auto, uring or threads");
+	}
+	if (config.photoFrame != "auto" && config.photoFrame != "local" && config.photoFrame != "srs") {
+		throw std::runtime_error("photo-frame must be auto, local or srs");
+	}
+	if (config.bvhWidth != 4 && config.bvhWidth != 8) {
+		throw std::runtime_error("bvh-width must be 4 or 8");
+	}
+	if (config.outputFormat != "sparse" && config.outputFormat != "binary" && config.outputFormat != "dense") {
+		throw std::runtime_error("output-format must be sparse, binary or dense");
+	}
+	return config;
+}
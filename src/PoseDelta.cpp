@@ -0,0 +1,167 @@
+#include "PoseDelta.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+PoseChange classifyPoseChange(const PhotoInfo& previous, const PhotoInfo& current, const PoseDeltaOptions& options) {
+	if (previous.imagePath != current.imagePath || previous.imageWidth != current.imageWidth || previous.imageHeight != current.imageHeight
+		|| std::memcmp(previous.intrinsicMatrix, current.intrinsicMatrix, sizeof(previous.intrinsicMatrix)) != 0
+		|| previous.distortion.k1 != current.distortion.k1 || previous.distortion.k2 != current.distortion.k2
+		|| previous.distortion.k3 != current.distortion.k3 || previous.distortion.p1 != current.distortion.p1
+		|| previous.distortion.p2 != current.distortion.p2) {
+		return PoseChange::Large;
+	}
+	if (std::memcmp(&previous.pose, &current.pose, sizeof(CameraPose)) == 0) {
+		return PoseChange::Unchanged;
+	}
+	double shift = 0.0;
+	for (int i = 0; i < 3; ++i) {
+		shift += (current.pose.center[i] - previous.pose.center[i]) * (current.pose.center[i] - previous.pose.center[i]);
+	}
+	// 两个旋转之间的夹角：cos θ = (trace(R1 R2^T) - 1) / 2
+	double trace = 0.0;
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j < 3; ++j) {
+			trace += previous.pose.rotationMatrix[i][j] * current.pose.rotationMatrix[i][j];
+		}
+	}
+	double angle = std::acos(std::min(1.0, std::max(-1.0, (trace - 1.0) / 2.0))) * 180.0 / M_PI;
+	return std::sqrt(shift) <= options.maxShift && angle <= options.maxRotationDegrees ? PoseChange::Small : PoseChange::Large;
+}
+
+std::vector<char> markLabelBoundaries(const std::vector<TileId>& labels, int cols, int rows, int radius) {
+	// 先标记与右侧或下方邻居不同的格子对，再把标记向四周膨胀 radius 格。
+	// 图像边缘同样视为边界：上次在画面外的候选 tile 可能从边缘移入
+	std::vector<char> edges(labels.size(), 0);
+	for (int row = 0; row < rows; ++row) {
+		for (int col = 0; col < cols; ++col) {
+			const size_t i = static_cast<size_t>(row) * cols + col;
+			if (row == 0 || col == 0 || row + 1 == rows || col + 1 == cols) edges[i] = 1;
+			if (col + 1 < cols && labels[i] != labels[i + 1]) edges[i] = edges[i + 1] = 1;
+			if (row + 1 < rows && labels[i] != labels[i + cols]) edges[i] = edges[i + cols] = 1;
+		}
+	}
+	// 可分离膨胀：先按行再按列
+	std::vector<char> horizontal(labels.size(), 0);
+	for (int row = 0; row < rows; ++row) {
+		int last = -radius - 1;
+		for (int col = 0; col < cols; ++col) {
+			if (edges[static_cast<size_t>(row) * cols + col]) last = col;
+			if (col - last <= radius) horizontal[static_cast<size_t>(row) * cols + col] = 1;
+		}
+		last = cols + radius + 1;
+		for (int col = cols - 1; col >= 0; --col) {
+			if (edges[static_cast<size_t>(row) * cols + col]) last = col;
+			if (last - col <= radius) horizontal[static_cast<size_t>(row) * cols + col] = 1;
+		}
+	}
+	std::vector<char> marks(labels.size(), 0);
+	for (int col = 0; col < cols; ++col) {
+		int last = -radius - 1;
+		for (int row = 0; row < rows; ++row) {
+			if (horizontal[static_cast<size_t>(row) * cols + col]) last = row;
+			if (row - last <= radius) marks[static_cast<size_t>(row) * cols + col] = 1;
+		}
+		last = rows + radius + 1;
+		for (int row = rows - 1; row >= 0; --row) {
+			if (horizontal[static_cast<size_t>(row) * cols + col]) last = row;
+			if (last - row <= radius) marks[static_cast<size_t>(row) * cols + col] = 1;
+		}
+	}
+	return marks;
+}
+
+PoseDeltaTracer::PoseDeltaTracer(std::vector<PhotoInfo> previousPhotos, std::unordered_map<int, PhotoRayLabels> previousLabels,
+	const osg::BoundingBox& sceneBounds, const PoseDeltaOptions& options)
+	: previousPhotos(std::move(previousPhotos)), previousLabels(std::move(previousLabels)), sceneBounds(sceneBounds), options(options) {}
+
+std::vector<TileId> PoseDeltaTracer::trace(const CoverageEngine& engine, const CoverageBatch& batch, int photoIndex) const {
+	totalRays += batch.rays.size();
+	auto traceAll = [&]() {
+		++fullPhotos;
+		tracedRays += batch.rays.size();
+		return engine.traceBatch(batch);
+	};
+	const PhotoInfo& current = batch.camera.getPhotoInfo();
+	auto labelsIt = previousLabels.find(photoIndex);
+	if (photoIndex < 0 || photoIndex >= static_cast<int>(previousPhotos.size()) || labelsIt == previousLabels.end()) {
+		return traceAll();
+	}
+	const PhotoRayLabels& previous = labelsIt->second;
+	const int cols = (current.imageWidth + batch.step - 1) / batch.step;
+	const int rows = (current.imageHeight + batch.step - 1) / batch.step;
+	// 采样网格或候选 tile 变化时旧标签不可比
+	std::vector<TileId> candidates;
+	for (const NamedBoundingBox& tile : batch.intersectingTiles) candidates.push_back(tile.id);
+	std::vector<TileId> previousCandidates = previous.candidates;
+	std::sort(candidates.begin(), candidates.end());
+	std::sort(previousCandidates.begin(), previousCandidates.end());
+	if (static_cast<int>(previous.cols) != cols || static_cast<int>(previous.rows) != rows || batch.rays.size() != previous.cols * previous.rows
+		|| candidates != previousCandidates) {
+		return traceAll();
+	}
+
+	PoseChange change = classifyPoseChange(previousPhotos[photoIndex], current, options);
+	if (change == PoseChange::Large) {
+		return traceAll();
+	}
+	std::vector<TileId> labels = previous.decode();
+	if (change == PoseChange::Unchanged) {
+		++unchangedPhotos;
+		return labels;
+	}
+
+	// 图像上的最大像素位移：旋转 θ 在主点处约移动 f·θ 像素，离轴角 α 处放大到 f·θ/cos²α，取最远的图像角点；
+	// 平移 d 在最近深度 z 处约移动 f·d/z 像素，同样按角点放大。最近深度取相机中心到场景包围盒的距离
+	// （相机在包围盒内时边界带覆盖整幅图像，相当于整张重算）
+	const PhotoInfo& before = previousPhotos[photoIndex];
+	double shift = 0.0, trace = 0.0;
+	for (int i = 0; i < 3; ++i) {
+		shift += (current.pose.center[i] - before.pose.center[i]) * (current.pose.center[i] - before.pose.center[i]);
+		for (int j = 0; j < 3; ++j) trace += before.pose.rotationMatrix[i][j] * current.pose.rotationMatrix[i][j];
+	}
+	shift = std::sqrt(shift);
+	const double angle = std::acos(std::min(1.0, std::max(-1.0, (trace - 1.0) / 2.0)));
+	const osg::Vec3d center = batch.camera.getCameraCenter();
+	double depth = 0.0;
+	for (int axis = 0; axis < 3; ++axis) {
+		double outside = std::max(0.0, std::max(sceneBounds._min[axis] - center[axis], center[axis] - sceneBounds._max[axis]));
+		depth += outside * outside;
+	}
+	depth = std::sqrt(depth);
+	const double fx = current.intrinsicMatrix[0][0], fy = current.intrinsicMatrix[1][1];
+	const double cx = current.intrinsicMatrix[0][2], cy = current.intrinsicMatrix[1][2];
+	const double dx = std::max(cx, current.imageWidth - cx) / fx, dy = std::max(cy, current.imageHeight - cy) / fy;
+	const double cornerScale = 1.0 + dx * dx + dy * dy;  // 1 / cos²α
+	const double pixels = depth > 0.0 ? std::max(fx, fy) * cornerScale * (angle + shift / depth)
+		: static_cast<double>(std::max(current.imageWidth, current.imageHeight));
+	const int radius = static_cast<int>(std::ceil(pixels / batch.step)) + options.band;
+
+	std::vector<char> marks = markLabelBoundaries(labels, cols, rows, radius);
+	std::vector<std::pair<osg::Vec3d, osg::Vec3d>> rays;
+	std::vector<size_t> slots;
+	for (size_t i = 0; i < marks.size(); ++i) {
+		if (!marks[i]) continue;
+		rays.push_back(batch.rays[i]);
+		slots.push_back(i);
+	}
+	++smallPhotos;
+	tracedRays += rays.size();
+	if (!rays.empty()) {
+		CoverageBatch subset = { batch.camera, batch.intersectingTiles, batch.step, rays };
+		std::vector<TileId> traced = engine.traceBatch(subset);
+		for (size_t i = 0; i < slots.size(); ++i) labels[slots[i]] = traced[i];
+	}
+	return labels;
+}
+
+void PoseDeltaTracer::printSummary() const {
+	std::cout << "Pose delta: " << unchangedPhotos << " photos unchanged, " << smallPhotos << " updated near label boundaries, "
+		<< fullPhotos << " fully retraced; " << tracedRays << " of " << totalRays << " rays traced ("
+		<< (totalRays > 0 ? 100.0 * tracedRays / totalRays : 0.0) << "%)" << std::endl;
+}
@@ -0,0 +1,60 @@
+#include "ProcessMemory.h"
+#include <fstream>
+#include <string>
+#include <sstream>
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#if defined(_MSC_VER)
+#pragma comment(lib, "psapi.lib")
+#endif
+#endif
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#if defined(__linux__)
+// 读取 /proc/self/status 中以 kB 为单位的字段
+static size_t readStatusField(const std::string& field) {
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line)) {
+		if (line.compare(0, field.size(), field) != 0 || line.size() <= field.size() || line[field.size()] != ':') continue;
+		std::istringstream value(line.substr(field.size() + 1));
+		size_t kilobytes = 0;
+		value >> kilobytes;
+		return kilobytes * 1024;
+	}
+	return 0;
+}
+#endif
+
+size_t currentResidentBytes() {
+#if defined(__linux__)
+	return readStatusField("VmRSS");
+#elif defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return counters.WorkingSetSize;
+	return 0;
+#else
+	return 0;
+#endif
+}
+
+size_t peakResidentBytes() {
+#if defined(__linux__)
+	return readStatusField("VmHWM");
+#elif defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return counters.PeakWorkingSetSize;
+	return 0;
+#else
+	return 0;
+#endif
+}
+
+void releaseFreedMemory() {
+#if defined(__GLIBC__)
+	malloc_trim(0);
+#endif
+}
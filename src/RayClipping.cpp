@@ -0,0 +1,51 @@
+#include "RayClipping.h"
+#include <algorithm>
+#include <limits>
+
+bool intersectRayBox(const osg::Vec3d& origin, const osg::Vec3d& direction, const osg::BoundingBox& bbox,
+	double& tmin, double& tmax) {
+	if (!bbox.valid()) return false;
+
+	const double boxMin[3] = { bbox.xMin(), bbox.yMin(), bbox.zMin() };
+	const double boxMax[3] = { bbox.xMax(), bbox.yMax(), bbox.zMax() };
+	double t0 = 0.0;
+	double t1 = std::numeric_limits<double>::max();
+	for (int axis = 0; axis < 3; ++axis) {
+		if (direction[axis] == 0.0) {
+			// 与该轴平行：起点必须位于 slab 内
+			if (origin[axis] < boxMin[axis] || origin[axis] > boxMax[axis]) return false;
+			continue;
+		}
+		double invDir = 1.0 / direction[axis];
+		double tNear = (boxMin[axis] - origin[axis]) * invDir;
+		double tFar = (boxMax[axis] - origin[axis]) * invDir;
+		if (tNear > tFar) std::swap(tNear, tFar);
+		t0 = std::max(t0, tNear);
+		t1 = std::min(t1, tFar);
+		if (t0 > t1) return false;
+	}
+	tmin = t0;
+	tmax = t1;
+	return true;
+}
+
+bool clipRayToTiles(const osg::Vec3d& origin, const osg::Vec3d& direction, const std::vector<NamedBoundingBox>& tiles,
+	double& tmin, double& tmax) {
+	bool hit = false;
+	double clippedMin = std::numeric_limits<double>::max();
+	double clippedMax = 0.0;
+	// 包围盒的高度范围即该 tile 的高程范围，逐个求交后取并集
+	for (const NamedBoundingBox& tile : tiles) {
+		double t0, t1;
+		if (intersectRayBox(origin, direction, tile.bbox, t0, t1)) {
+			clippedMin = std::min(clippedMin, t0);
+			clippedMax = std::max(clippedMax, t1);
+			hit = true;
+		}
+	}
+	if (hit) {
+		tmin = clippedMin;
+		tmax = clippedMax;
+	}
+	return hit;
+}
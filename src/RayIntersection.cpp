@@ -1,17 +1,26 @@
 #include "RayIntersection.h"
 #include <osgUtil/IntersectVisitor>
-#include <osg/LineSegment>
 #include <osg/MatrixTransform>
 #include <thread>
 #include <vector>
-#include <mutex>
 #include <map>
+#include <algorithm>
 #include <osg/Vec3d>
 
-typedef std::map<osg::Vec3d, IntersectionDetail> IntersectionResults;
+// 射线检测的最大长度
+static const double kMaxRayLength = 1000.0;
 
-RayIntersection::RayIntersection(osg::ref_ptr<osg::Group> sceneRoot, const std::map<std::string, osg::BoundingBox>& tileBoundingBoxes)
-	: sceneRoot(sceneRoot), tileBoundingBoxes(tileBoundingBoxes) {}
+RayIntersection::RayIntersection(osg::ref_ptr<osg::Group> sceneRoot, const std::vector<NamedBoundingBox>& tileBoundingBoxes)
+	: sceneRoot(sceneRoot) {
+	std::vector<osg::BoundingBox> tileBoxes;
+	tileIds.reserve(tileBoundingBoxes.size());
+	tileBoxes.reserve(tileBoundingBoxes.size());
+	for (const auto& tile : tileBoundingBoxes) {
+		tileIds.push_back(tile.id);
+		tileBoxes.push_back(tile.bbox);
+	}
+	broadPhase.build(tileBoxes);
+}
 
 osg::ref_ptr<osg::Node> getNodeByName(osg::Group* group, const std::string& name) {
 	if (!group) return nullptr;
@@ -24,47 +33,60 @@ osg::ref_ptr<osg::Node> getNodeByName(osg::Group* group, const std::string& name
 	return nullptr;
 }
 
-void processSegment(int start, int end, const std::vector<osg::Vec3d>& rays, const osg::Vec3& cameraCenter,
-	const std::map<std::string, osg::BoundingBox>& tileBoundingBoxes, osg::Group* sceneRoot,
-	IntersectionResults& results, std::mutex& mutex) {
-	for (int i = start; i < end; ++i) {
-		const auto& rayDirection = rays[i];
-		IntersectionDetail detail;
-		osg::ref_ptr<osg::LineSegment> lineSegment = new osg::LineSegment(cameraCenter, cameraCenter + rayDirection * 1000.0);
-
-		for (const auto& tile : tileBoundingBoxes) {
-			const std::string& tileName = tile.first;
-			const osg::BoundingBox& bbox = tile.second;
+// 每个线程独占 [start, end) 内的 spans，命中的 TileId 写入线程自己的缓冲区，无需加锁
+static void processSegment(size_t start, size_t end, const std::vector<osg::Vec3d>& rays, const osg::Vec3d& cameraCenter,
+	const TileBroadPhase& broadPhase, const std::vector<TileId>& tileIds,
+	std::vector<RayHitSpan>& spans, std::vector<TileId>& localTileIds) {
+	std::vector<TileHit> hits;
+	for (size_t i = start; i < end; ++i) {
+		RayHitSpan& span = spans[i];
+		span.offset = static_cast<uint32_t>(localTileIds.size());
 
-			if (lineSegment->intersect(bbox)) {
-				detail.tileNames.push_back(tileName);
-			}
-		}
-
-		if (!detail.tileNames.empty()) {
-			std::lock_guard<std::mutex> lock(mutex);
-			results[rayDirection] = detail;
+		broadPhase.intersect(cameraCenter, rays[i], 0.0f, static_cast<float>(kMaxRayLength), hits);
+		for (const TileHit& hit : hits) {
+			localTileIds.push_back(tileIds[hit.tileId]);
 		}
+		span.count = static_cast<uint32_t>(localTileIds.size()) - span.offset;
 	}
 }
 
-IntersectionResults RayIntersection::calculateIntersections(const osg::Vec3& cameraCenter, const std::vector<osg::Vec3d>& rays) {
+IntersectionResults RayIntersection::calculateIntersections(const osg::Vec3d& cameraCenter, const std::vector<osg::Vec3d>& rays) {
 	IntersectionResults rayTileIntersections;
-	std::mutex mapMutex;
-	unsigned int numThreads = std::thread::hardware_concurrency();
-	unsigned int blockSize = rays.size() / numThreads;
+	rayTileIntersections.spans.resize(rays.size());
+
+	unsigned int numThreads = std::max(1u, std::thread::hardware_concurrency());
+	size_t blockSize = rays.size() / numThreads;
+	std::vector<std::vector<TileId>> localTileIds(numThreads);
 	std::vector<std::thread> threads;
+	const osg::Vec3d& center = cameraCenter;
 
 	for (unsigned int i = 0; i < numThreads; ++i) {
-		int start = i * blockSize;
-		int end = (i == numThreads - 1) ? rays.size() : start + blockSize;
-		threads.emplace_back(processSegment, start, end, std::ref(rays), std::ref(cameraCenter),
-			std::ref(tileBoundingBoxes), sceneRoot.get(), std::ref(rayTileIntersections), std::ref(mapMutex));
+		size_t start = i * blockSize;
+		size_t end = (i == numThreads - 1) ? rays.size() : start + blockSize;
+		localTileIds[i].reserve(end - start);
+		threads.emplace_back(processSegment, start, end, std::cref(rays), std::cref(center),
+			std::cref(broadPhase), std::cref(tileIds), std::ref(rayTileIntersections.spans), std::ref(localTileIds[i]));
 	}
 
 	for (auto& thread : threads) {
 		thread.join();
 	}
 
+	// 按线程顺序拼接各自的缓冲区，结果与线程调度无关
+	size_t totalHits = 0;
+	for (const auto& ids : localTileIds) {
+		totalHits += ids.size();
+	}
+	rayTileIntersections.tileIds.reserve(totalHits);
+	for (unsigned int i = 0; i < numThreads; ++i) {
+		uint32_t base = static_cast<uint32_t>(rayTileIntersections.tileIds.size());
+		size_t start = i * blockSize;
+		size_t end = (i == numThreads - 1) ? rays.size() : start + blockSize;
+		for (size_t r = start; r < end; ++r) {
+			rayTileIntersections.spans[r].offset += base;
+		}
+		rayTileIntersections.tileIds.insert(rayTileIntersections.tileIds.end(), localTileIds[i].begin(), localTileIds[i].end());
+	}
+
 	return rayTileIntersections;
-}
\ No newline at end of file
+}
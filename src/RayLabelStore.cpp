@@ -0,0 +1,213 @@
+#include "RayLabelStore.h"
+#include "ContentHash.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+static const char kRayLabelMagic[4] = { 'P', 'M', 'R', 'L' };
+static const uint32_t kRayLabelVersion = 2;
+
+static void appendBytes(std::vector<char>& buffer, const void* data, size_t size) {
+	const char* bytes = static_cast<const char*>(data);
+	buffer.insert(buffer.end(), bytes, bytes + size);
+}
+
+template <typename T>
+static void appendValue(std::vector<char>& buffer, T value) {
+	appendBytes(buffer, &value, sizeof(value));
+}
+
+std::vector<TileId> PhotoRayLabels::decode() const {
+	std::vector<TileId> labels;
+	labels.reserve(static_cast<size_t>(cols) * rows);
+	for (const auto& run : runs) {
+		labels.insert(labels.end(), run.second, run.first);
+	}
+	return labels;
+}
+
+// 照片记录的键：运行参数与候选 tile（按编号排列）的名称和内容哈希，任一变化时旧标签不可沿用
+static uint64_t recordKey(const std::string& runKey, std::vector<TileId> candidates, const SceneBuilder& builder) {
+	std::sort(candidates.begin(), candidates.end());
+	uint64_t hash = hashString(runKey, kHashSeed);
+	hash = hashValue(candidates.size(), hash);
+	for (TileId id : candidates) {
+		hash = hashString(builder.getTileRegistry().getTileName(id), hash);
+		hash = hashValue(builder.getTileContentHashes()[id], hash);
+	}
+	return hash;
+}
+
+RayLabelWriter::RayLabelWriter(const std::string& filename, const std::string& runKey, const SceneBuilder& builder)
+	: file(nullptr), filename(filename), runKey(runKey), builder(builder) {
+	const TileRegistry& registry = builder.getTileRegistry();
+	if (builder.getTileContentHashes().size() != registry.size()) {
+		throw std::runtime_error("Ray labels need tile content hashes");
+	}
+	std::vector<char> header;
+	appendBytes(header, kRayLabelMagic, sizeof(kRayLabelMagic));
+	appendValue(header, kRayLabelVersion);
+	appendValue(header, static_cast<uint32_t>(runKey.size()));
+	appendBytes(header, runKey.data(), runKey.size());
+	appendValue(header, static_cast<uint32_t>(registry.size()));
+	for (TileId id = 0; id < registry.size(); ++id) {
+		const std::string& name = registry.getTileName(id);
+		// 长度字段为 u16，超长时报错而不是写出错位的文件
+		if (name.size() > UINT16_MAX) {
+			throw std::runtime_error("Tile name too long for the ray label file (" + std::to_string(name.size()) + " bytes)");
+		}
+		appendValue(header, static_cast<uint16_t>(name.size()));
+		appendBytes(header, name.data(), name.size());
+		appendValue(header, builder.getTileContentHashes()[id]);
+	}
+	file = std::fopen(filename.c_str(), "wb");
+	if (!file) {
+		throw std::runtime_error("无法打开文件：" + filename);
+	}
+	if (std::fwrite(header.data(), 1, header.size(), file) != header.size()) {
+		std::fclose(file);
+		throw std::runtime_error("Failed to write ray labels: " + filename);
+	}
+}
+
+RayLabelWriter::~RayLabelWriter() {
+	if (file) std::fclose(file);
+}
+
+void RayLabelWriter::close() {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!file) return;
+	const bool failed = std::fclose(file) != 0;
+	file = nullptr;
+	if (failed) {
+		throw std::runtime_error("Failed to write ray labels: " + filename);
+	}
+}
+
+void RayLabelWriter::writePhoto(int photoIndex, uint32_t cols, uint32_t rows, const std::vector<NamedBoundingBox>& candidates,
+	const std::vector<TileId>& labels) {
+	if (labels.size() != static_cast<size_t>(cols) * rows) {
+		throw std::runtime_error("Ray labels of photo #" + std::to_string(photoIndex) + " do not match its sampling grid");
+	}
+	std::vector<TileId> candidateIds;
+	for (const NamedBoundingBox& tile : candidates) candidateIds.push_back(tile.id);
+	std::vector<char> record;
+	appendValue(record, static_cast<int32_t>(photoIndex));
+	appendValue(record, recordKey(runKey, candidateIds, builder));
+	appendValue(record, cols);
+	appendValue(record, rows);
+	appendValue(record, static_cast<uint32_t>(candidates.size()));
+	for (const NamedBoundingBox& tile : candidates) {
+		appendValue(record, static_cast<uint32_t>(tile.id));
+	}
+	const size_t runCountOffset = record.size();
+	appendValue(record, uint32_t(0));
+	uint32_t numRuns = 0;
+	for (size_t i = 0; i < labels.size();) {
+		size_t end = i + 1;
+		while (end < labels.size() && labels[end] == labels[i]) ++end;
+		appendValue(record, static_cast<uint32_t>(labels[i]));
+		appendValue(record, static_cast<uint32_t>(end - i));
+		++numRuns;
+		i = end;
+	}
+	std::memcpy(record.data() + runCountOffset, &numRuns, sizeof(numRuns));
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!file || std::fwrite(record.data(), 1, record.size(), file) != record.size()) {
+		throw std::runtime_error("Failed to write ray labels: " + filename);
+	}
+}
+
+template <typename T>
+static void readValue(std::istream& in, T& value, const std::string& filename) {
+	if (!in.read(reinterpret_cast<char*>(&value), sizeof(T))) {
+		throw std::runtime_error("Truncated ray label file: " + filename);
+	}
+}
+
+std::unordered_map<int, PhotoRayLabels> readRayLabels(const std::string& filename, const std::string& runKey, const SceneBuilder& builder) {
+	const TileRegistry& registry = builder.getTileRegistry();
+	std::ifstream in(filename, std::ios::binary);
+	if (!in.is_open()) {
+		throw std::runtime_error("无法打开文件：" + filename);
+	}
+	char magic[sizeof(kRayLabelMagic)];
+	uint32_t version, numTiles;
+	readValue(in, magic, filename);
+	readValue(in, version, filename);
+	if (std::memcmp(magic, kRayLabelMagic, sizeof(magic)) != 0 || version != kRayLabelVersion) {
+		throw std::runtime_error("Not a ray label file: " + filename);
+	}
+	uint32_t keyLength;
+	readValue(in, keyLength, filename);
+	std::string fileKey(keyLength, '\0');
+	if (keyLength > 0 && !in.read(&fileKey[0], keyLength)) {
+		throw std::runtime_error("Truncated ray label file: " + filename);
+	}
+	if (fileKey != runKey) {
+		std::cerr << "Warning: " << filename << " was written with different parameters, retracing all photos" << std::endl;
+		return {};
+	}
+	// 文件中的 tileId 到当前编号，未击中的标签保持 kInvalidTileId；内容已变化的 tile 与不存在的 tile 一样视为未知
+	readValue(in, numTiles, filename);
+	std::vector<TileId> tileIds(numTiles);
+	for (uint32_t i = 0; i < numTiles; ++i) {
+		uint16_t length;
+		readValue(in, length, filename);
+		std::string name(length, '\0');
+		if (length > 0 && !in.read(&name[0], length)) {
+			throw std::runtime_error("Truncated ray label file: " + filename);
+		}
+		uint64_t contentHash;
+		readValue(in, contentHash, filename);
+		TileId id = registry.findTile(name);
+		tileIds[i] = id != kInvalidTileId && id < builder.getTileContentHashes().size()
+			&& builder.getTileContentHashes()[id] == contentHash ? id : kInvalidTileId;
+	}
+	auto remap = [&tileIds](uint32_t id, bool& known) {
+		if (id == kInvalidTileId) return kInvalidTileId;
+		if (id >= tileIds.size() || tileIds[id] == kInvalidTileId) {
+			known = false;
+			return kInvalidTileId;
+		}
+		return tileIds[id];
+	};
+
+	// 中断的运行可能在末尾留下写了一半的记录，丢弃它，之前完整的照片照常使用
+	auto read = [&in](auto& value) { return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value))); };
+	std::unordered_map<int, PhotoRayLabels> photos;
+	int32_t photoIndex;
+	bool truncated = false;
+	while (!truncated && read(photoIndex)) {
+		PhotoRayLabels labels;
+		bool known = true;
+		uint64_t storedKey = 0;
+		uint32_t numCandidates = 0, numRuns = 0;
+		truncated = !read(storedKey) || !read(labels.cols) || !read(labels.rows) || !read(numCandidates);
+		for (uint32_t i = 0; !truncated && i < numCandidates; ++i) {
+			uint32_t id;
+			truncated = !read(id);
+			labels.candidates.push_back(remap(id, known));
+		}
+		truncated = truncated || !read(numRuns);
+		size_t numLabels = 0;
+		for (uint32_t i = 0; !truncated && i < numRuns; ++i) {
+			uint32_t id, length;
+			truncated = !read(id) || !read(length);
+			labels.runs.push_back({ remap(id, known), length });
+			numLabels += length;
+		}
+		if (!truncated && known && numLabels == static_cast<size_t>(labels.cols) * labels.rows
+			&& storedKey == recordKey(runKey, labels.candidates, builder)) {
+			photos[photoIndex] = std::move(labels);
+		}
+	}
+	if (truncated) {
+		std::cerr << "Warning: dropped a truncated record at the end of " << filename << std::endl;
+	}
+	return photos;
+}
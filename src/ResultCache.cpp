@@ -0,0 +1,198 @@
+#include "ResultCache.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include "ContentHash.h"
+#include "IncrementalState.h"
+
+namespace fs = std::filesystem;
+
+static const char kResultCacheMagic[4] = { 'P', 'M', 'R', 'C' };
+static const uint32_t kResultCacheVersion = 1;
+static const char* const kEntryExtension = ".res";
+
+ResultCache::ResultCache(const std::string& directory, const std::string& parametersKey, uint64_t maxBytes)
+	: directory(directory), parametersKey(parametersKey), maxBytes(maxBytes) {
+	std::error_code error;
+	fs::create_directories(directory, error);
+	if (!fs::is_directory(directory, error)) {
+		throw std::runtime_error("Unable to create result cache directory: " + directory);
+	}
+	size_t entries = 0;
+	for (const fs::directory_entry& entry : fs::directory_iterator(directory, error)) {
+		if (entry.path().extension() != kEntryExtension) continue;
+		totalBytes += entry.file_size(error);
+		++entries;
+	}
+	std::cout << "Result cache " << directory << ": " << entries << " entries, " << (totalBytes >> 20) << " of "
+		<< (maxBytes >> 20) << " MB" << std::endl;
+}
+
+uint64_t ResultCache::photoKey(const PhotoInfo& photoInfo, const std::vector<TileId>& tiles, const SceneBuilder& builder) const {
+	uint64_t hash = hashString(parametersKey, kHashSeed);
+	hash = hashValue(hashPhotoInfo(photoInfo), hash);
+	hash = hashValue(tiles.size(), hash);
+	for (TileId id : tiles) {
+		hash = hashString(builder.getTileRegistry().getTileName(id), hash);
+		hash = hashValue(builder.getTileContentHashes()[id], hash);
+	}
+	return hash;
+}
+
+std::string ResultCache::entryPath(uint64_t key) const {
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+	return (fs::path(directory) / (std::string(name) + kEntryExtension)).string();
+}
+
+bool ResultCache::lookup(uint64_t key, const TileRegistry& registry, std::vector<TileIntersectionResult>& results) {
+	const std::string path = entryPath(key);
+	std::ifstream in(path.c_str(), std::ios::binary);
+	char magic[4];
+	uint32_t version = 0, count = 0;
+	uint64_t storedKey = 0;
+	bool valid = in && in.read(magic, sizeof(magic)) && std::memcmp(magic, kResultCacheMagic, sizeof(magic)) == 0
+		&& in.read(reinterpret_cast<char*>(&version), sizeof(version)) && version == kResultCacheVersion
+		&& in.read(reinterpret_cast<char*>(&storedKey), sizeof(storedKey)) && storedKey == key
+		&& in.read(reinterpret_cast<char*>(&count), sizeof(count));
+	std::vector<TileIntersectionResult> entryResults;
+	for (uint32_t i = 0; valid && i < count; ++i) {
+		uint16_t length = 0;
+		std::string name;
+		TileIntersectionResult result;
+		valid = static_cast<bool>(in.read(reinterpret_cast<char*>(&length), sizeof(length)));
+		name.resize(length);
+		valid = valid && in.read(&name[0], length) && in.read(reinterpret_cast<char*>(&result.percentage), sizeof(result.percentage));
+		result.tileId = valid ? registry.findTile(name) : kInvalidTileId;
+		valid = valid && result.tileId != kInvalidTileId;
+		entryResults.push_back(result);
+	}
+	in.close();
+	if (!valid) {
+		++misses;
+		return false;
+	}
+	// 刷新修改时间作为最近使用时间
+	std::error_code error;
+	fs::last_write_time(path, fs::file_time_type::clock::now(), error);
+	results.swap(entryResults);
+	++hits;
+	return true;
+}
+
+void ResultCache::store(uint64_t key, const TileRegistry& registry, const std::vector<TileIntersectionResult>& results) {
+	std::vector<char> bytes(kResultCacheMagic, kResultCacheMagic + sizeof(kResultCacheMagic));
+	auto append = [&bytes](const void* data, size_t size) {
+		bytes.insert(bytes.end(), static_cast<const char*>(data), static_cast<const char*>(data) + size);
+	};
+	const uint32_t count = static_cast<uint32_t>(results.size());
+	append(&kResultCacheVersion, sizeof(kResultCacheVersion));
+	append(&key, sizeof(key));
+	append(&count, sizeof(count));
+	for (const TileIntersectionResult& result : results) {
+		const std::string& name = registry.getTileName(result.tileId);
+		// 长度字段为 u16，名称过长时不缓存该照片，而不是写出截断的名称
+		if (name.size() > UINT16_MAX) {
+			std::cerr << "Warning: tile name too long for the result cache, skipping entry" << std::endl;
+			return;
+		}
+		const uint16_t length = static_cast<uint16_t>(name.size());
+		append(&length, sizeof(length));
+		append(name.data(), length);
+		append(&result.percentage, sizeof(result.percentage));
+	}
+
+	// 多个进程可能共享缓存目录，先写各自的临时文件再改名，读者只会看到完整的结果
+	const std::string path = entryPath(key);
+	const uint64_t writer = hashValue(std::chrono::steady_clock::now().time_since_epoch().count(),
+		hashValue(std::hash<std::thread::id>()(std::this_thread::get_id()), kHashSeed));
+	const std::string temporary = path + "." + std::to_string(writer) + ".tmp";
+	{
+		std::ofstream out(temporary.c_str(), std::ios::binary | std::ios::trunc);
+		if (!out.write(bytes.data(), bytes.size())) {
+			std::cerr << "Warning: unable to write result cache entry " << temporary << std::endl;
+			return;
+		}
+	}
+	std::lock_guard<std::mutex> lock(mutex);
+	std::error_code error;
+	const bool replaced = fs::exists(path, error);
+	if (std::rename(temporary.c_str(), path.c_str()) != 0
+		&& (std::remove(path.c_str()) != 0 || std::rename(temporary.c_str(), path.c_str()) != 0)) {
+		std::remove(temporary.c_str());
+		return;
+	}
+	if (!replaced) totalBytes += bytes.size();
+	++stored;
+	if (totalBytes > maxBytes) evict();
+}
+
+void ResultCache::evict() {
+	// 重新扫描目录，其他进程写入的结果也计入总大小
+	struct Entry {
+		fs::path path;
+		fs::file_time_type lastUse;
+		uint64_t bytes;
+	};
+	std::vector<Entry> entries;
+	std::error_code error;
+	totalBytes = 0;
+	for (const fs::directory_entry& entry : fs::directory_iterator(directory, error)) {
+		if (entry.path().extension() != kEntryExtension) continue;
+		Entry item = { entry.path(), entry.last_write_time(error), entry.file_size(error) };
+		if (error) continue;
+		totalBytes += item.bytes;
+		entries.push_back(item);
+	}
+	std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.lastUse < b.lastUse; });
+	const uint64_t target = maxBytes / 10 * 9;
+	for (const Entry& entry : entries) {
+		if (totalBytes <= target) break;
+		if (fs::remove(entry.path, error)) {
+			totalBytes -= entry.bytes;
+			++evicted;
+		}
+	}
+}
+
+std::vector<TileSummary> ResultCache::readTileIndex() const {
+	IncrementalState state;
+	try {
+		readIncrementalState((fs::path(directory) / "tiles.txt").string(), state);
+	}
+	catch (const std::exception& e) {
+		// 摘要只用于跳过解析，损坏时全部重新扫描
+		std::cerr << "Warning: ignoring result cache tile index: " << e.what() << std::endl;
+		state.tiles.clear();
+	}
+	return state.tiles;
+}
+
+void ResultCache::writeTileIndex(const SceneBuilder& builder) const {
+	IncrementalState state;
+	const TileRegistry& registry = builder.getTileRegistry();
+	for (TileId id = 0; id < registry.size(); ++id) {
+		TileSummary tile;
+		tile.name = registry.getTileName(id);
+		tile.bbox = builder.getTileBoundingBoxes()[id].bbox;
+		tile.triangles = builder.getTileTriangleCounts()[id];
+		tile.contentHash = builder.getTileContentHashes()[id];
+		tile.sourceStamp = builder.getTileSourceStamps()[id];
+		state.tiles.push_back(tile);
+	}
+	writeIncrementalState((fs::path(directory) / "tiles.txt").string(), state);
+}
+
+void ResultCache::printSummary() const {
+	std::cout << "Result cache: " << hits << " hits, " << misses << " misses, " << stored << " stored, " << evicted
+		<< " evicted, " << (totalBytes >> 20) << " MB in use" << std::endl;
+}
@@ -0,0 +1,323 @@
+#include "ResultWriter.h"
+#include <charconv>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+// 缓冲区超过该大小时写入文件
+static const size_t kFlushThreshold = 1 << 20;
+static const char kBinaryMagic[4] = { 'P', 'M', 'S', 'R' };
+static const uint32_t kBinaryVersion = 1;
+
+template <typename T>
+static void appendNumber(std::vector<char>& buffer, T value) {
+	char digits[32];
+	std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+	buffer.insert(buffer.end(), digits, result.ptr);
+}
+
+static void appendPercentage(std::vector<char>& buffer, double value) {
+	char digits[32];
+	std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::fixed, 5);
+	buffer.insert(buffer.end(), digits, result.ptr);
+}
+
+// 文本格式的名称与路径字段：含逗号、引号或换行时按 CSV 规则加双引号，内部引号写两次
+static void appendField(std::vector<char>& buffer, const std::string& value) {
+	if (value.find_first_of(",\"\r\n") == std::string::npos) {
+		buffer.insert(buffer.end(), value.begin(), value.end());
+		return;
+	}
+	buffer.push_back('"');
+	for (char c : value) {
+		if (c == '"') buffer.push_back('"');
+		buffer.push_back(c);
+	}
+	buffer.push_back('"');
+}
+
+// 二进制格式的名称与路径以 u16 记录长度，超长时报错而不是截断
+static uint16_t shortLength(const std::string& value) {
+	if (value.size() > UINT16_MAX) {
+		throw std::runtime_error("Name too long for the binary result format (" + std::to_string(value.size()) + " bytes): "
+			+ value.substr(0, 64) + "...");
+	}
+	return static_cast<uint16_t>(value.size());
+}
+
+SparseResultWriter::SparseResultWriter(const std::string& filename, const TileRegistry& registry, ResultFormat format)
+	: file(nullptr), filename(filename), format(format) {
+	buffer.reserve(kFlushThreshold + 4096);
+
+	// tile 表，读取方据此把 tileId 解析为名称
+	if (format == ResultFormat::SparseBinary) {
+		appendBytes(kBinaryMagic, sizeof(kBinaryMagic));
+		appendBytes(&kBinaryVersion, sizeof(kBinaryVersion));
+		uint32_t numTiles = static_cast<uint32_t>(registry.size());
+		appendBytes(&numTiles, sizeof(numTiles));
+		for (const std::string& name : registry.getTileNames()) {
+			uint16_t length = shortLength(name);
+			appendBytes(&length, sizeof(length));
+			appendBytes(name.data(), length);
+		}
+	}
+	else {
+		const std::vector<std::string>& names = registry.getTileNames();
+		for (size_t id = 0; id < names.size(); ++id) {
+			buffer.push_back('T');
+			buffer.push_back(',');
+			appendNumber(buffer, id);
+			buffer.push_back(',');
+			appendField(buffer, names[id]);
+			buffer.push_back('\n');
+		}
+	}
+	// tile 表完整生成后才创建文件，名称超长时不会留下空文件
+	file = std::fopen(filename.c_str(), format == ResultFormat::SparseBinary ? "wb" : "w");
+	if (!file) {
+		throw std::runtime_error("无法打开文件：" + filename);
+	}
+	try {
+		flushLocked();
+	}
+	catch (...) {
+		std::fclose(file);
+		throw;
+	}
+}
+
+SparseResultWriter::~SparseResultWriter() {
+	// 析构时不能抛出异常；写入错误由 flush() 报告
+	if (!buffer.empty()) std::fwrite(buffer.data(), 1, buffer.size(), file);
+	std::fclose(file);
+}
+
+void SparseResultWriter::writePhoto(const PhotoData& photoData) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (format == ResultFormat::SparseBinary) {
+		appendBinary(photoData);
+	}
+	else {
+		appendText(photoData);
+	}
+	if (buffer.size() >= kFlushThreshold) {
+		flushLocked();
+	}
+}
+
+void SparseResultWriter::flush() {
+	std::lock_guard<std::mutex> lock(mutex);
+	flushLocked();
+	if (std::fflush(file) != 0) {
+		throw std::runtime_error("Failed to write results: " + filename);
+	}
+}
+
+void SparseResultWriter::appendText(const PhotoData& photoData) {
+	buffer.push_back('P');
+	buffer.push_back(',');
+	appendNumber(buffer, photoData.index);
+	buffer.push_back(',');
+	appendField(buffer, photoData.imagePath);
+	buffer.push_back('\n');
+	for (const TileIntersectionResult& result : photoData.intersectionResults) {
+		if (result.percentage <= 0.0) continue;
+		buffer.push_back('C');
+		buffer.push_back(',');
+		appendNumber(buffer, photoData.index);
+		buffer.push_back(',');
+		appendNumber(buffer, result.tileId);
+		buffer.push_back(',');
+		appendPercentage(buffer, result.percentage);
+		buffer.push_back('\n');
+	}
+}
+
+void SparseResultWriter::appendBinary(const PhotoData& photoData) {
+	int32_t index = photoData.index;
+	uint16_t pathLength = shortLength(photoData.imagePath);
+	uint32_t nonZero = 0;
+	for (const TileIntersectionResult& result : photoData.intersectionResults) {
+		if (result.percentage > 0.0) ++nonZero;
+	}
+	appendBytes(&index, sizeof(index));
+	appendBytes(&pathLength, sizeof(pathLength));
+	appendBytes(photoData.imagePath.data(), pathLength);
+	appendBytes(&nonZero, sizeof(nonZero));
+	for (const TileIntersectionResult& result : photoData.intersectionResults) {
+		if (result.percentage <= 0.0) continue;
+		uint32_t tileId = result.tileId;
+		float percentage = static_cast<float>(result.percentage);
+		appendBytes(&tileId, sizeof(tileId));
+		appendBytes(&percentage, sizeof(percentage));
+	}
+}
+
+void SparseResultWriter::appendBytes(const void* data, size_t size) {
+	const char* bytes = static_cast<const char*>(data);
+	buffer.insert(buffer.end(), bytes, bytes + size);
+}
+
+void SparseResultWriter::flushLocked() {
+	if (!buffer.empty()) {
+		const bool written = std::fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+		buffer.clear();
+		if (!written) {
+			throw std::runtime_error("Failed to write results: " + filename);
+		}
+	}
+}
+
+template <typename T>
+static void readValue(std::istream& in, T& value, const std::string& filename) {
+	if (!in.read(reinterpret_cast<char*>(&value), sizeof(T))) {
+		throw std::runtime_error("Truncated result file: " + filename);
+	}
+}
+
+static std::string readShortString(std::istream& in, const std::string& filename) {
+	uint16_t length;
+	readValue(in, length, filename);
+	std::string value(length, '\0');
+	if (length > 0 && !in.read(&value[0], length)) {
+		throw std::runtime_error("Truncated result file: " + filename);
+	}
+	return value;
+}
+
+static void readBinaryResults(std::istream& in, const std::string& filename, SparseResults& results) {
+	uint32_t version, numTiles;
+	readValue(in, version, filename);
+	if (version != kBinaryVersion) {
+		throw std::runtime_error("Unsupported result file version: " + filename);
+	}
+	readValue(in, numTiles, filename);
+	for (uint32_t i = 0; i < numTiles; ++i) {
+		results.tileNames.push_back(readShortString(in, filename));
+	}
+
+	int32_t index;
+	while (in.read(reinterpret_cast<char*>(&index), sizeof(index))) {
+		PhotoData photoData;
+		photoData.index = index;
+		photoData.imagePath = readShortString(in, filename);
+		uint32_t nonZero;
+		readValue(in, nonZero, filename);
+		photoData.intersectionResults.reserve(nonZero);
+		for (uint32_t i = 0; i < nonZero; ++i) {
+			uint32_t tileId;
+			float percentage;
+			readValue(in, tileId, filename);
+			readValue(in, percentage, filename);
+			photoData.intersectionResults.push_back({ tileId, percentage });
+		}
+		results.photos.push_back(std::move(photoData));
+	}
+}
+
+// 读取从 start 开始直到行尾的最后一个字段；以双引号开头时按 CSV 规则解析，字段内的换行会继续读取后续行。
+// 行尾的 '\r' 只在引号外去掉，引号内的原样保留
+static std::string readLastField(std::istream& in, std::string& line, std::string::size_type start, const std::string& filename) {
+	if (start >= line.size() || line[start] != '"') {
+		std::string value = line.substr(start);
+		if (!value.empty() && value.back() == '\r') value.pop_back();
+		return value;
+	}
+	std::string value;
+	std::string::size_type position = start + 1;
+	for (;;) {
+		if (position >= line.size()) {
+			// 引号内的换行
+			std::string next;
+			if (!std::getline(in, next)) {
+				throw std::runtime_error("Unterminated quoted field in " + filename);
+			}
+			value.push_back('\n');
+			line = next;
+			position = 0;
+			continue;
+		}
+		char c = line[position++];
+		if (c != '"') {
+			value.push_back(c);
+		}
+		else if (position < line.size() && line[position] == '"') {
+			value.push_back('"');
+			++position;
+		}
+		else if (position == line.size() || (position + 1 == line.size() && line[position] == '\r')) {
+			return value;
+		}
+		else {
+			throw std::runtime_error("Malformed quoted field in " + filename + ": " + line);
+		}
+	}
+}
+
+static void readTextResults(std::istream& in, const std::string& filename, SparseResults& results) {
+	// 照片序号到 photos 下标，C 记录可能与其 P 记录不相邻（例如合并后的文件）
+	std::unordered_map<int, size_t> photoSlots;
+	std::string line;
+	while (std::getline(in, line)) {
+		if (line.empty() || line == "\r") continue;
+		if (line.size() < 2 || line[1] != ',') {
+			throw std::runtime_error("Malformed line in " + filename + ": " + line);
+		}
+		std::string::size_type second = line.find(',', 2);
+		if (second == std::string::npos) {
+			throw std::runtime_error("Malformed line in " + filename + ": " + line);
+		}
+		switch (line[0]) {
+		case 'T':
+			results.tileNames.push_back(readLastField(in, line, second + 1, filename));
+			break;
+		case 'P': {
+			PhotoData photoData;
+			photoData.index = std::stoi(line.substr(2, second - 2));
+			photoData.imagePath = readLastField(in, line, second + 1, filename);
+			photoSlots[photoData.index] = results.photos.size();
+			results.photos.push_back(std::move(photoData));
+			break;
+		}
+		case 'C': {
+			std::string::size_type third = line.find(',', second + 1);
+			if (third == std::string::npos) {
+				throw std::runtime_error("Malformed line in " + filename + ": " + line);
+			}
+			int index = std::stoi(line.substr(2, second - 2));
+			auto slot = photoSlots.find(index);
+			if (slot == photoSlots.end()) {
+				throw std::runtime_error("Coverage record before photo record in " + filename + ": " + line);
+			}
+			TileId tileId = static_cast<TileId>(std::stoul(line.substr(second + 1, third - second - 1)));
+			double percentage = std::stod(line.substr(third + 1));
+			results.photos[slot->second].intersectionResults.push_back({ tileId, percentage });
+			break;
+		}
+		default:
+			throw std::runtime_error("Malformed line in " + filename + ": " + line);
+		}
+	}
+}
+
+SparseResults readSparseResults(const std::string& filename) {
+	std::ifstream in(filename, std::ios::binary);
+	if (!in.is_open()) {
+		throw std::runtime_error("无法打开文件：" + filename);
+	}
+	SparseResults results;
+	char magic[sizeof(kBinaryMagic)] = {};
+	in.read(magic, sizeof(magic));
+	if (in.gcount() == sizeof(magic) && std::memcmp(magic, kBinaryMagic, sizeof(magic)) == 0) {
+		readBinaryResults(in, filename, results);
+	}
+	else {
+		in.clear();
+		in.seekg(0);
+		readTextResults(in, filename, results);
+	}
+	return results;
+}
@@ -8,12 +8,19 @@
 #include <osg/LineWidth>
 #include <osg/Geometry>
 #include <thread>
-#include <mutex>
 #include <limits>
 #include <vector>
 #include <osgUtil/IntersectionVisitor>
 #include <osgUtil/LineSegmentIntersector>
 #include <osg/MatrixTransform>
+#include <osg/KdTree>
+#include <atomic>
+#include "ThreadPool.h"
+#include "TileLoader.h"
+#include "ContentHash.h"
+#include <cstdlib>
+#include <fstream>
+#include <memory>
 
 BBoxPrinter::BBoxPrinter() : osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN) {}
 
@@ -27,7 +34,63 @@ osg::BoundingBox BBoxPrinter::getTotalBoundingBox() const {
 	return totalBoundingBox;
 }
 
-SceneBuilder::SceneBuilder() {}
+SceneBuilder::SceneBuilder() : buildKdTrees(false) {}
+
+// 只扫描 obj 文本中的顶点与面行，得到与加载后节点一致的包围盒和三角形数，不构建场景图。
+// osgDB 的 obj 插件默认把顶点 (x, y, z) 转为 (x, -z, y)，这里按同样的方式换算；多边形面按扇形计为 n-2 个三角形
+static bool summarizeObjFile(const std::string& file, osg::BoundingBox& box, size_t& triangles) {
+	std::ifstream in(file.c_str(), std::ios::binary);
+	if (!in.is_open()) return false;
+	auto scanLine = [&](const char* begin, const char* end) {
+		while (begin < end && (*begin == ' ' || *begin == '\t')) ++begin;
+		if (end - begin < 2 || (begin[1] != ' ' && begin[1] != '\t')) return;
+		if (begin[0] == 'v') {
+			// 行总以换行符或字符串结尾的 '\0' 结束，strtof 不会越过本行
+			const char* cursor = begin + 2;
+			float xyz[3];
+			for (int axis = 0; axis < 3; ++axis) {
+				char* next = nullptr;
+				xyz[axis] = std::strtof(cursor, &next);
+				if (next == cursor) return;
+				cursor = next;
+			}
+			box.expandBy(osg::Vec3(xyz[0], -xyz[2], xyz[1]));
+		}
+		else if (begin[0] == 'f') {
+			size_t corners = 0;
+			bool inToken = false;
+			for (const char* c = begin + 1; c < end; ++c) {
+				bool space = *c == ' ' || *c == '\t' || *c == '\r';
+				if (!space && !inToken) ++corners;
+				inToken = !space;
+			}
+			if (corners >= 3) triangles += corners - 2;
+		}
+	};
+	std::vector<char> chunk(1 << 20);
+	std::string carry;
+	while (in) {
+		in.read(chunk.data(), chunk.size());
+		const char* begin = chunk.data();
+		const char* end = begin + in.gcount();
+		const char* lineStart = begin;
+		for (const char* c = begin; c < end; ++c) {
+			if (*c != '\n') continue;
+			if (!carry.empty()) {
+				carry.append(lineStart, c);
+				scanLine(carry.data(), carry.data() + carry.size());
+				carry.clear();
+			}
+			else {
+				scanLine(lineStart, c);
+			}
+			lineStart = c + 1;
+		}
+		carry.append(lineStart, end);
+	}
+	scanLine(carry.data(), carry.data() + carry.size());
+	return true;
+}
 
 static std::string removeTrailingSlash(const std::string& path) {
 	if (!path.empty() && path.back() == '/') {
@@ -42,12 +105,11 @@ static std::string replaceBackslashes(const std::string& path) {
 	return correctedPath;
 }
 
-osg::ref_ptr<osg::Group> SceneBuilder::buildScene(const std::string& meshFolderPath) {
-	osg::ref_ptr<osg::Group> root = new osg::Group();
+void SceneBuilder::listTileFolders(const std::string& meshFolderPath, std::vector<std::string>& tileFolderNames,
+	std::vector<std::vector<std::string>>& tileFiles) const {
 	DIR* dir;
 	struct dirent* ent;
-	std::mutex mutex;
-	std::vector<std::thread> threads;
+	tileFolderNames.clear();
 
 	std::string correctedMeshFolderPath = replaceBackslashes(removeTrailingSlash(meshFolderPath));
 	if ((dir = opendir(correctedMeshFolderPath.c_str())) != NULL) {
@@ -60,52 +122,344 @@ osg::ref_ptr<osg::Group> SceneBuilder::buildScene(const std::string& meshFolderP
 			if (!S_ISDIR(path_stat.st_mode)) {
 				continue; // Not a directory, skip this entry
 			}
+			tileFolderNames.push_back(entryName);
+		}
+		closedir(dir);
+	}
+	// 按名称排序，使 tile 编号与目录遍历顺序无关
+	std::sort(tileFolderNames.begin(), tileFolderNames.end());
 
-			threads.emplace_back([&, tileFolderPath, entryName] {
-				DIR* tileDir = opendir(tileFolderPath.c_str());
-				if (tileDir) {
-					struct dirent* tileEnt;
-					while ((tileEnt = readdir(tileDir)) != NULL) {
-						std::string tileEntryName(tileEnt->d_name);
-						if (tileEntryName == "." || tileEntryName == "..") continue;
-						if (tileEntryName.substr(tileEntryName.find_last_of(".") + 1) == "obj") {
-							std::string objFilePath = tileFolderPath + "/" + tileEntryName;
-							osg::ref_ptr<osg::Node> tileNode = osgDB::readNodeFile(objFilePath);
-							if (tileNode) {
-								BBoxPrinter bboxPrinter;
-								tileNode->accept(bboxPrinter);
-								osg::BoundingBox bbox = bboxPrinter.getTotalBoundingBox();
-
-								std::lock_guard<std::mutex> lock(mutex);
-								tileBoundingBoxes.push_back({ entryName, bbox });
-
-								tileNode->setName(entryName); // Set the name of the tile node
-								std::cout << "Adding tile node: " << tileNode->getName() << std::endl; // Debug print
-								root->addChild(tileNode);
-							}
-						}
-					}
-					closedir(tileDir);
+	// 目录列举作为共享线程池中的任务，结果写入各自的槽位；文件名排序保证加载顺序确定
+	tileFiles.assign(tileFolderNames.size(), std::vector<std::string>());
+	TaskGroup tasks(ThreadPool::shared());
+	for (size_t slot = 0; slot < tileFolderNames.size(); ++slot) {
+		tasks.run([&, slot] {
+			std::string tileFolderPath = correctedMeshFolderPath + "/" + tileFolderNames[slot];
+			DIR* tileDir = opendir(tileFolderPath.c_str());
+			if (!tileDir) return;
+			struct dirent* tileEnt;
+			while ((tileEnt = readdir(tileDir)) != NULL) {
+				std::string tileEntryName(tileEnt->d_name);
+				if (tileEntryName == "." || tileEntryName == "..") continue;
+				if (tileEntryName.substr(tileEntryName.find_last_of(".") + 1) == "obj") {
+					tileFiles[slot].push_back(tileFolderPath + "/" + tileEntryName);
 				}
-				});
+			}
+			closedir(tileDir);
+			std::sort(tileFiles[slot].begin(), tileFiles[slot].end());
+			});
+	}
+	tasks.wait();
+}
+
+void SceneBuilder::loadTileGroups(const std::vector<std::string>& tileFolderNames, const std::vector<std::vector<std::string>>& tileFiles,
+	const std::function<void(size_t, osg::ref_ptr<osg::Group>, const osg::BoundingBox&)>& onTile) const {
+	std::vector<std::string> files;
+	std::vector<size_t> fileTiles;
+	std::vector<size_t> firstFile(tileFolderNames.size() + 1, 0);
+	for (size_t slot = 0; slot < tileFolderNames.size(); ++slot) {
+		firstFile[slot] = files.size();
+		for (const std::string& file : tileFiles[slot]) {
+			files.push_back(file);
+			fileTiles.push_back(slot);
 		}
-		closedir(dir);
 	}
+	firstFile[tileFolderNames.size()] = files.size();
 
-	for (auto& thread : threads) {
-		thread.join();
+	// 读取与解析由 TileLoader 分别限流；每个文件的结果写入预分配槽位，tile 的最后一个文件完成时组装该 tile
+	std::vector<osg::ref_ptr<osg::Node>> fileNodes(files.size());
+	std::vector<osg::BoundingBox> fileBoxes(files.size());
+	std::unique_ptr<std::atomic<size_t>[]> remainingFiles(new std::atomic<size_t>[tileFolderNames.size()]);
+	for (size_t slot = 0; slot < tileFolderNames.size(); ++slot) {
+		remainingFiles[slot] = firstFile[slot + 1] - firstFile[slot];
 	}
 
+	TileLoader loader(loadOptions);
+	TileLoadStats loadStats = loader.load(files, [&](size_t fileIndex, osg::ref_ptr<osg::Node> tileNode) {
+		if (tileNode) {
+			BBoxPrinter bboxPrinter;
+			tileNode->accept(bboxPrinter);
+			fileBoxes[fileIndex] = bboxPrinter.getTotalBoundingBox();
+			if (buildKdTrees) {
+				osg::ref_ptr<osg::KdTreeBuilder> kdTreeBuilder = new osg::KdTreeBuilder();
+				tileNode->accept(*kdTreeBuilder);
+			}
+			fileNodes[fileIndex] = tileNode;
+		}
+		const size_t slot = fileTiles[fileIndex];
+		if (--remainingFiles[slot] != 0) return;
+
+		// 子节点按文件名顺序加入，与完成顺序无关
+		osg::ref_ptr<osg::Group> tileGroup;
+		osg::BoundingBox tileBox;
+		for (size_t file = firstFile[slot]; file < firstFile[slot + 1]; ++file) {
+			if (!fileNodes[file]) continue;
+			if (!tileGroup) {
+				tileGroup = new osg::Group();
+				tileGroup->setName(tileFolderNames[slot]); // Set the name of the tile node
+			}
+			tileGroup->addChild(fileNodes[file]);
+			tileBox.expandBy(fileBoxes[file]);
+			fileNodes[file] = nullptr;
+		}
+		if (tileGroup) {
+			onTile(slot, tileGroup, tileBox);
+		}
+		});
+	const double megabytes = loadStats.bytesRead / (1024.0 * 1024.0);
+	std::cout << "Loaded " << loadStats.files - loadStats.failed << "/" << loadStats.files << " tile files ("
+		<< megabytes << " MB) in " << loadStats.seconds << " s; reads via " << loadStats.backend << " finished in "
+		<< loadStats.readSeconds << " s (" << (loadStats.readSeconds > 0.0 ? megabytes / loadStats.readSeconds : 0.0)
+		<< " MB/s)." << std::endl;
+}
+
+void SceneBuilder::finishRegistration() {
+	// 包围盒按 TileId 顺序注册，可直接作为网格的输入
+	std::vector<osg::BoundingBox> boxes;
+	for (const auto& item : tileBoundingBoxes) {
+		boxes.push_back(item.bbox);
+	}
+	tileGrid.build(tileRegistry.getTileNames(), boxes);
+}
+
+osg::ref_ptr<osg::Group> SceneBuilder::buildScene(const std::string& meshFolderPath) {
+	osg::ref_ptr<osg::Group> root = new osg::Group();
+	std::vector<std::string> tileFolderNames;
+	std::vector<std::vector<std::string>> tileFiles;
+	listTileFolders(meshFolderPath, tileFolderNames, tileFiles);
+
+	std::vector<osg::ref_ptr<osg::Group>> loadedTiles(tileFolderNames.size());
+	std::vector<osg::BoundingBox> loadedBoxes(tileFolderNames.size());
+	loadTileGroups(tileFolderNames, tileFiles, [&](size_t slot, osg::ref_ptr<osg::Group> tileGroup, const osg::BoundingBox& tileBox) {
+		loadedTiles[slot] = tileGroup;
+		loadedBoxes[slot] = tileBox;
+		if (tileLoadedCallback) {
+			tileLoadedCallback(tileFolderNames[slot], tileGroup.get());
+		}
+		});
+
+	// 只为成功加载的 tile 分配编号
+	for (size_t slot = 0; slot < tileFolderNames.size(); ++slot) {
+		if (!loadedTiles[slot]) continue;
+		TileId id = tileRegistry.registerTile(tileFolderNames[slot]);
+		tileBoundingBoxes.push_back({ id, loadedBoxes[slot] });
+		tileNodes.push_back(loadedTiles[slot]);
+		tileFilePaths.push_back(tileFiles[slot]);
+		std::cout << "Adding tile node: " << loadedTiles[slot]->getName() << std::endl; // Debug print
+		root->addChild(loadedTiles[slot]);
+	}
+	finishRegistration();
+
 	return root;
 }
 
+void SceneBuilder::scanScene(const std::string& meshFolderPath, const std::vector<TileSummary>* knownTiles) {
+	std::vector<std::string> tileFolderNames;
+	std::vector<std::vector<std::string>> tileFiles;
+	listTileFolders(meshFolderPath, tileFolderNames, tileFiles);
+
+	std::vector<osg::BoundingBox> scannedBoxes(tileFolderNames.size());
+	std::vector<size_t> scannedTriangles(tileFolderNames.size(), 0);
+	std::vector<char> scanned(tileFolderNames.size(), 0);
+	std::vector<uint64_t> hashes(tileFolderNames.size(), 0);
+	std::vector<uint64_t> stamps(tileFolderNames.size(), 0);
+	// 给定已知摘要时计算各 tile 的内容哈希：文件签名（名称、大小、修改时间）与摘要一致的 tile 直接沿用摘要中的哈希，
+	// 只有签名变化的 tile 才读取全部内容；名称与哈希都一致的 tile 沿用摘要，不再扫描
+	size_t reused = 0, hashed = 0;
+	if (knownTiles) {
+		std::map<std::string, const TileSummary*> known;
+		for (const TileSummary& summary : *knownTiles) {
+			known[summary.name] = &summary;
+		}
+		std::atomic<size_t> hashedTiles(0);
+		TaskGroup tasks(ThreadPool::shared());
+		for (size_t slot = 0; slot < tileFolderNames.size(); ++slot) {
+			auto it = known.find(tileFolderNames[slot]);
+			const TileSummary* summary = it == known.end() ? nullptr : it->second;
+			tasks.run([&, slot, summary] {
+				stamps[slot] = tileSourceStamp(tileFiles[slot]);
+				if (summary && summary->sourceStamp != 0 && summary->sourceStamp == stamps[slot]) {
+					hashes[slot] = summary->contentHash;
+					return;
+				}
+				hashes[slot] = tileContentHash(tileFiles[slot]);
+				++hashedTiles;
+				});
+		}
+		tasks.wait();
+		hashed = hashedTiles;
+		for (size_t slot = 0; slot < tileFolderNames.size(); ++slot) {
+			auto it = known.find(tileFolderNames[slot]);
+			if (tileFiles[slot].empty() || it == known.end() || it->second->contentHash != hashes[slot]) continue;
+			scannedBoxes[slot] = it->second->bbox;
+			scannedTriangles[slot] = it->second->triangles;
+			scanned[slot] = 1;
+			++reused;
+		}
+	}
+
+	// 其余 tile 只扫描 obj 文本得到包围盒和三角形数，不解析成场景图
+	{
+		TaskGroup tasks(ThreadPool::shared());
+		for (size_t slot = 0; slot < tileFolderNames.size(); ++slot) {
+			if (scanned[slot]) continue;
+			tasks.run([&, slot] {
+				osg::BoundingBox tileBox;
+				size_t triangles = 0;
+				for (const std::string& file : tileFiles[slot]) {
+					summarizeObjFile(file, tileBox, triangles);
+				}
+				if (!tileBox.valid() || triangles == 0) return;
+				scannedBoxes[slot] = tileBox;
+				scannedTriangles[slot] = triangles;
+				scanned[slot] = 1;
+				});
+		}
+		tasks.wait();
+	}
+
+	for (size_t slot = 0; slot < tileFolderNames.size(); ++slot) {
+		if (!scanned[slot]) continue;
+		TileId id = tileRegistry.registerTile(tileFolderNames[slot]);
+		tileBoundingBoxes.push_back({ id, scannedBoxes[slot] });
+		tileNodes.push_back(nullptr);
+		tileFilePaths.push_back(tileFiles[slot]);
+		tileTriangles.push_back(scannedTriangles[slot]);
+		tileContentHashes.push_back(hashes[slot]);
+		tileSourceStamps.push_back(knownTiles ? stamps[slot] : tileSourceStamp(tileFiles[slot]));
+	}
+	finishRegistration();
+	std::cout << "Scanned " << tileBoundingBoxes.size() << " tiles without keeping them resident";
+	if (knownTiles) {
+		std::cout << ", " << reused << " unchanged since the previous run, " << hashed << " hashed";
+	}
+	std::cout << "." << std::endl;
+}
+
+uint64_t tileSourceStamp(const std::vector<std::string>& files) {
+	uint64_t stamp = kHashSeed;
+	for (const std::string& file : files) {
+		struct stat fileStat;
+		int64_t sizeAndTime[2] = { -1, -1 };
+		if (stat(file.c_str(), &fileStat) == 0) {
+			sizeAndTime[0] = static_cast<int64_t>(fileStat.st_size);
+			sizeAndTime[1] = static_cast<int64_t>(fileStat.st_mtime);
+		}
+		stamp = hashValue(sizeAndTime, hashString(file, stamp));
+	}
+	return stamp;
+}
+
+uint64_t tileContentHash(const std::vector<std::string>& files) {
+	uint64_t hash = kHashSeed;
+	std::vector<char> chunk(1 << 20);
+	for (const std::string& file : files) {
+		// 只计入文件名而不计入目录，整个 mesh 目录搬迁后哈希不变
+		hash = hashString(file.substr(file.find_last_of('/') + 1), hash);
+		std::ifstream in(file.c_str(), std::ios::binary);
+		while (in) {
+			in.read(chunk.data(), chunk.size());
+			hash = hashBytes(chunk.data(), static_cast<size_t>(in.gcount()), hash);
+		}
+	}
+	return hash;
+}
+
+void SceneBuilder::computeTileContentHashes() {
+	tileContentHashes.resize(tileFilePaths.size(), 0);
+	TaskGroup tasks(ThreadPool::shared());
+	for (size_t id = 0; id < tileFilePaths.size(); ++id) {
+		if (tileContentHashes[id] != 0) continue;
+		tasks.run([this, id] { tileContentHashes[id] = tileContentHash(tileFilePaths[id]); });
+	}
+	tasks.wait();
+}
+
+bool SceneBuilder::restoreScene(const std::string& meshFolderPath, const std::vector<TileSummary>& summaries) {
+	std::vector<std::string> tileFolderNames;
+	std::vector<std::vector<std::string>> tileFiles;
+	listTileFolders(meshFolderPath, tileFolderNames, tileFiles);
+
+	// 缓存只记录加载成功的 tile，目录中其余含 obj 文件的 tile 说明缓存已过期
+	std::map<std::string, size_t> slots;
+	for (size_t slot = 0; slot < tileFolderNames.size(); ++slot) {
+		if (!tileFiles[slot].empty()) slots[tileFolderNames[slot]] = slot;
+	}
+	if (slots.size() != summaries.size()) return false;
+	for (const TileSummary& summary : summaries) {
+		auto it = slots.find(summary.name);
+		if (it == slots.end() || tileSourceStamp(tileFiles[it->second]) != summary.sourceStamp) return false;
+	}
+
+	for (const TileSummary& summary : summaries) {
+		TileId id = tileRegistry.registerTile(summary.name);
+		tileBoundingBoxes.push_back({ id, summary.bbox });
+		tileNodes.push_back(nullptr);
+		tileFilePaths.push_back(tileFiles[slots[summary.name]]);
+		tileTriangles.push_back(summary.triangles);
+		tileSourceStamps.push_back(summary.sourceStamp);
+	}
+	finishRegistration();
+	std::cout << "Restored " << tileBoundingBoxes.size() << " tiles from the tile cache." << std::endl;
+	return true;
+}
+
+void SceneBuilder::loadTiles(const std::vector<TileId>& ids) {
+	std::vector<TileId> missing;
+	std::vector<std::string> names;
+	std::vector<std::vector<std::string>> files;
+	for (TileId id : ids) {
+		if (id >= tileNodes.size() || tileNodes[id]) continue;
+		missing.push_back(id);
+		names.push_back(tileRegistry.getTileName(id));
+		files.push_back(tileFilePaths[id]);
+	}
+	if (missing.empty()) return;
+	// 每个 tile 只写自己的槽位，不需要加锁
+	loadTileGroups(names, files, [&](size_t slot, osg::ref_ptr<osg::Group> tileGroup, const osg::BoundingBox&) {
+		tileNodes[missing[slot]] = tileGroup;
+		if (tileLoadedCallback) {
+			tileLoadedCallback(names[slot], tileGroup.get());
+		}
+		});
+}
+
+void SceneBuilder::unloadTiles(const std::vector<TileId>& ids) {
+	for (TileId id : ids) {
+		if (id < tileNodes.size()) tileNodes[id] = nullptr;
+	}
+}
+
+void buildTileKdTrees(const std::vector<osg::ref_ptr<osg::Node>>& tileNodes) {
+	std::atomic<size_t> nextTile(0);
+	auto worker = [&]() {
+		osg::ref_ptr<osg::KdTreeBuilder> kdTreeBuilder = new osg::KdTreeBuilder();
+		for (size_t tile = nextTile++; tile < tileNodes.size(); tile = nextTile++) {
+			if (tileNodes[tile]) tileNodes[tile]->accept(*kdTreeBuilder);
+		}
+	};
+	TaskGroup tasks(ThreadPool::shared());
+	for (unsigned int i = 0; i < ThreadPool::shared().size(); ++i) {
+		tasks.run(worker);
+	}
+	tasks.wait();
+}
+
 const std::vector<NamedBoundingBox>& SceneBuilder::getTileBoundingBoxes() const {
 	return tileBoundingBoxes;
 }
 
+osg::BoundingBox SceneBuilder::getSceneBoundingBox() const {
+	osg::BoundingBox sceneBounds;
+	for (const auto& item : tileBoundingBoxes) {
+		sceneBounds.expandBy(item.bbox);
+	}
+	return sceneBounds;
+}
+
 void SceneBuilder::printTileBoundingBoxes() const {
 	for (const auto& item : tileBoundingBoxes) {
-		const std::string& tileName = item.name;
+		const std::string& tileName = tileRegistry.getTileName(item.id);
 		const osg::BoundingBox& bbox = item.bbox;
 		std::cout << "Tile: " << tileName << " BBox: ["
 			<< bbox.xMin() << ", " << bbox.yMin() << ", " << bbox.zMin() << "] - ["
@@ -0,0 +1,212 @@
+#include "ShardPlanner.h"
+#include "ContentHash.h"
+#include "OutOfCorePlanner.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+ShardManifest planShards(const std::vector<PhotoCost>& photos, int numShards) {
+	if (numShards <= 0) throw std::runtime_error("shards must be > 0");
+	ShardManifest manifest;
+	manifest.shardPhotos.resize(numShards);
+	manifest.shardCosts.assign(numShards, 0.0);
+
+	std::vector<double> groundX, groundZ;
+	double totalCost = 0.0;
+	for (const PhotoCost& photo : photos) {
+		groundX.push_back(photo.groundX);
+		groundZ.push_back(photo.groundZ);
+		totalCost += photo.cost;
+	}
+	// 第 k 个分片结束于累计开销达到 (k + 1) / N 的位置，保证每个分片连续且开销接近
+	double accumulated = 0.0;
+	for (size_t index : groundMortonOrder(groundX, groundZ)) {
+		const PhotoCost& photo = photos[index];
+		double middle = accumulated + 0.5 * photo.cost;
+		int shard = totalCost > 0.0 ? static_cast<int>(middle * numShards / totalCost) : 0;
+		shard = std::min(numShards - 1, std::max(0, shard));
+		manifest.shardPhotos[shard].push_back(photo.photoIndex);
+		manifest.shardCosts[shard] += photo.cost;
+		accumulated += photo.cost;
+	}
+	for (auto& shardPhotos : manifest.shardPhotos) {
+		std::sort(shardPhotos.begin(), shardPhotos.end());
+	}
+	return manifest;
+}
+
+static std::string manifestPath(const std::string& shardDir) {
+	return shardDir + "/manifest.txt";
+}
+
+static std::string donePath(const std::string& shardDir, int shard) {
+	return shardDir + "/shard_" + std::to_string(shard) + ".done";
+}
+
+// 先写临时文件再改名，其它进程不会读到写了一半的文件
+static void replaceFile(const std::string& temporary, const std::string& target) {
+	std::remove(target.c_str());
+	if (std::rename(temporary.c_str(), target.c_str()) != 0) {
+		throw std::runtime_error("Failed to rename " + temporary + " to " + target);
+	}
+}
+
+// 分片照片列表的签名，写入 .done 标记，合并时据此识别旧清单留下的结果
+static uint64_t shardPhotosHash(const std::vector<int>& photoIndices) {
+	std::vector<int> sorted(photoIndices);
+	std::sort(sorted.begin(), sorted.end());
+	return hashBytes(sorted.data(), sorted.size() * sizeof(int), hashValue(sorted.size(), kHashSeed));
+}
+
+// 重新规划时删除旧清单留下的分片结果与标记，避免合并时混入
+static void removeShardOutputs(const std::string& shardDir) {
+	namespace fs = std::filesystem;
+	std::error_code error;
+	for (fs::directory_iterator it(shardDir, error), end; !error && it != end; it.increment(error)) {
+		const std::string name = it->path().filename().string();
+		if (name.compare(0, 6, "shard_") != 0) continue;
+		const std::string::size_type dot = name.find('.');
+		if (dot == std::string::npos) continue;
+		const std::string suffix = name.substr(dot);
+		if (suffix == ".done" || suffix == ".done.tmp" || suffix == ".part" || suffix == ".part.tmp") {
+			std::error_code removeError;
+			fs::remove(it->path(), removeError);
+		}
+	}
+}
+
+void writeShardManifest(const std::string& shardDir, const ShardManifest& manifest) {
+	removeShardOutputs(shardDir);
+	const std::string path = manifestPath(shardDir);
+	const std::string temporary = path + ".tmp";
+	{
+		std::ofstream out(temporary.c_str());
+		if (!out) throw std::runtime_error("Unable to write shard manifest: " + path);
+		out << "# PhotoMapping shard manifest v1\n";
+		out << "xml," << manifest.xmlFile << "\n";
+		out << "mesh," << manifest.meshFolder << "\n";
+		out << "shards," << manifest.shardPhotos.size() << "\n";
+		out.precision(17);
+		for (size_t shard = 0; shard < manifest.shardPhotos.size(); ++shard) {
+			out << "# shard " << shard << ": " << manifest.shardPhotos[shard].size() << " photos, cost " << manifest.shardCosts[shard] << "\n";
+		}
+		for (size_t shard = 0; shard < manifest.shardPhotos.size(); ++shard) {
+			for (int photoIndex : manifest.shardPhotos[shard]) {
+				out << "S," << shard << "," << photoIndex << "\n";
+			}
+		}
+		if (!out) throw std::runtime_error("Unable to write shard manifest: " + path);
+	}
+	replaceFile(temporary, path);
+}
+
+ShardManifest readShardManifest(const std::string& shardDir) {
+	const std::string path = manifestPath(shardDir);
+	std::ifstream in(path.c_str());
+	if (!in) throw std::runtime_error("Unable to open shard manifest: " + path);
+	ShardManifest manifest;
+	std::string line;
+	while (std::getline(in, line)) {
+		if (line.empty() || line[0] == '#') continue;
+		std::string::size_type comma = line.find(',');
+		if (comma == std::string::npos) throw std::runtime_error("Malformed shard manifest line: " + line);
+		std::string key = line.substr(0, comma);
+		std::string value = line.substr(comma + 1);
+		if (key == "xml") manifest.xmlFile = value;
+		else if (key == "mesh") manifest.meshFolder = value;
+		else if (key == "shards") {
+			manifest.shardPhotos.resize(std::stoi(value));
+			manifest.shardCosts.assign(manifest.shardPhotos.size(), 0.0);
+		}
+		else if (key == "S") {
+			std::string::size_type second = value.find(',');
+			if (second == std::string::npos) throw std::runtime_error("Malformed shard manifest line: " + line);
+			int shard = std::stoi(value.substr(0, second));
+			if (shard < 0 || shard >= static_cast<int>(manifest.shardPhotos.size())) {
+				throw std::runtime_error("Shard index out of range in manifest: " + line);
+			}
+			manifest.shardPhotos[shard].push_back(std::stoi(value.substr(second + 1)));
+		}
+		else throw std::runtime_error("Unknown shard manifest key: " + key);
+	}
+	return manifest;
+}
+
+std::string shardResultPath(const std::string& shardDir, int shard) {
+	return shardDir + "/shard_" + std::to_string(shard) + ".part";
+}
+
+void commitShardResult(const std::string& shardDir, int shard, const std::vector<int>& photoIndices) {
+	replaceFile(shardResultPath(shardDir, shard) + ".tmp", shardResultPath(shardDir, shard));
+	const std::string done = donePath(shardDir, shard);
+	const std::string temporary = done + ".tmp";
+	{
+		std::ofstream out(temporary.c_str());
+		out << photoIndices.size() << "\n" << shardPhotosHash(photoIndices) << "\n";
+		if (!out) throw std::runtime_error("Unable to write shard marker: " + done);
+	}
+	replaceFile(temporary, done);
+}
+
+SparseResults mergeShardResults(const std::string& shardDir, const ShardManifest& manifest) {
+	std::vector<int> missing;
+	for (size_t shard = 0; shard < manifest.shardPhotos.size(); ++shard) {
+		std::ifstream marker(donePath(shardDir, static_cast<int>(shard)).c_str());
+		if (!marker) {
+			missing.push_back(static_cast<int>(shard));
+			continue;
+		}
+		// 标记记录分片完成时的照片数与照片列表签名，与当前清单不一致说明是旧清单的结果
+		size_t numPhotos = 0;
+		uint64_t photosHash = 0;
+		if (!(marker >> numPhotos >> photosHash) || numPhotos != manifest.shardPhotos[shard].size()
+			|| photosHash != shardPhotosHash(manifest.shardPhotos[shard])) {
+			throw std::runtime_error("Shard " + std::to_string(shard) + " was computed for a different manifest; rerun it");
+		}
+	}
+	if (!missing.empty()) {
+		std::ostringstream message;
+		message << missing.size() << " shard(s) not finished:";
+		for (int shard : missing) message << " " << shard;
+		throw std::runtime_error(message.str());
+	}
+
+	// 各分片的 tile 表可能不同（加载失败的 tile 不编号），按名称重新编号，名称按字典序与 SceneBuilder 一致
+	std::vector<SparseResults> parts;
+	std::map<std::string, TileId> tileIds;
+	for (size_t shard = 0; shard < manifest.shardPhotos.size(); ++shard) {
+		parts.push_back(readSparseResults(shardResultPath(shardDir, static_cast<int>(shard))));
+		for (const std::string& name : parts.back().tileNames) tileIds[name] = 0;
+		// 高于阈值的照片不写结果，因此分片结果只能是清单照片的子集，且每张照片至多一次
+		std::vector<int> expected(manifest.shardPhotos[shard]);
+		std::sort(expected.begin(), expected.end());
+		std::vector<int> seen;
+		for (const PhotoData& photo : parts.back().photos) seen.push_back(photo.index);
+		std::sort(seen.begin(), seen.end());
+		if (std::adjacent_find(seen.begin(), seen.end()) != seen.end()
+			|| !std::includes(expected.begin(), expected.end(), seen.begin(), seen.end())) {
+			throw std::runtime_error("Shard " + std::to_string(shard) + " result does not match its photos in the manifest; rerun it");
+		}
+	}
+	SparseResults merged;
+	for (auto& entry : tileIds) {
+		entry.second = static_cast<TileId>(merged.tileNames.size());
+		merged.tileNames.push_back(entry.first);
+	}
+	for (SparseResults& part : parts) {
+		for (PhotoData& photo : part.photos) {
+			for (TileIntersectionResult& result : photo.intersectionResults) {
+				result.tileId = tileIds[part.tileNames[result.tileId]];
+			}
+			merged.photos.push_back(std::move(photo));
+		}
+	}
+	std::sort(merged.photos.begin(), merged.photos.end(), [](const PhotoData& a, const PhotoData& b) { return a.index < b.index; });
+	std::cout << "Merged " << merged.photos.size() << " photos from " << parts.size() << " shards." << std::endl;
+	return merged;
+}
@@ -0,0 +1,109 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int numThreads) : stopping(false) {
+	if (numThreads == 0) numThreads = std::max(1u, std::thread::hardware_concurrency());
+	for (unsigned int i = 0; i < numThreads; ++i) {
+		workers.emplace_back([this]() { workerLoop(); });
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	condition.notify_all();
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(std::move(task));
+	}
+	condition.notify_one();
+}
+
+void ThreadPool::workerLoop() {
+	for (;;) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+			if (tasks.empty()) return;
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		task();
+	}
+}
+
+ThreadPool& ThreadPool::shared() {
+	static ThreadPool pool;
+	return pool;
+}
+
+void TaskGroup::run(std::function<void()> task) {
+	{
+		std::lock_guard<std::mutex> lock(state->mutex);
+		state->tasks.push_back(std::move(task));
+		++state->pending;
+	}
+	state->condition.notify_all();
+	std::shared_ptr<State> shared = state;
+	// 任务可能已被等待的线程取走，此时入口直接返回
+	pool.submit([shared]() { runOne(*shared, false); });
+}
+
+bool TaskGroup::runOne(State& state, bool fromBack) {
+	std::function<void()> task;
+	{
+		std::lock_guard<std::mutex> lock(state.mutex);
+		if (state.tasks.empty()) return false;
+		if (fromBack) {
+			task = std::move(state.tasks.back());
+			state.tasks.pop_back();
+		}
+		else {
+			task = std::move(state.tasks.front());
+			state.tasks.pop_front();
+		}
+	}
+	std::exception_ptr error;
+	try {
+		task();
+	}
+	catch (...) {
+		error = std::current_exception();
+	}
+	{
+		std::lock_guard<std::mutex> lock(state.mutex);
+		if (error && !state.error) state.error = error;
+		--state.pending;
+	}
+	state.condition.notify_all();
+	return true;
+}
+
+void TaskGroup::waitNoThrow() {
+	for (;;) {
+		// 先协助执行本组尚未开始的任务，其余正在工作线程上执行的任务完成时被唤醒
+		if (runOne(*state, true)) continue;
+		std::unique_lock<std::mutex> lock(state->mutex);
+		if (state->pending == 0) return;
+		state->condition.wait(lock, [this]() { return state->pending == 0 || !state->tasks.empty(); });
+	}
+}
+
+void TaskGroup::wait() {
+	waitNoThrow();
+	std::lock_guard<std::mutex> lock(state->mutex);
+	if (state->error) {
+		std::exception_ptr pendingError = state->error;
+		state->error = nullptr;
+		std::rethrow_exception(pendingError);
+	}
+}
@@ -0,0 +1,221 @@
+#include "TileAssignment.h"
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#if defined(__linux__)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <linux/fs.h>
+#endif
+
+namespace fs = std::filesystem;
+
+LinkMode parseLinkMode(const std::string& name) {
+	if (name == "hardlink") return LinkMode::Hardlink;
+	if (name == "reflink") return LinkMode::Reflink;
+	if (name == "symlink") return LinkMode::Symlink;
+	if (name == "copy") return LinkMode::Copy;
+	throw std::runtime_error("link-mode must be hardlink, reflink, symlink or copy");
+}
+
+// 真正的数据复制；Linux 上用 copy_file_range 在内核内完成
+static bool copyImage(const std::string& source, const std::string& target) {
+#if defined(__linux__)
+	int in = open(source.c_str(), O_RDONLY | O_CLOEXEC);
+	if (in < 0) return false;
+	struct stat sourceStat;
+	if (fstat(in, &sourceStat) != 0) {
+		close(in);
+		return false;
+	}
+	int out = open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, sourceStat.st_mode & 0777);
+	if (out < 0) {
+		close(in);
+		return false;
+	}
+	off_t remaining = sourceStat.st_size;
+	bool ok = true;
+	while (remaining > 0) {
+		ssize_t copied = copy_file_range(in, nullptr, out, nullptr, static_cast<size_t>(remaining), 0);
+		if (copied <= 0) {
+			ok = false;
+			break;
+		}
+		remaining -= copied;
+	}
+	close(in);
+	close(out);
+	if (ok) return true;
+	// 旧内核不支持跨文件系统的 copy_file_range，退回到标准库复制
+#endif
+	std::error_code ec;
+	return fs::copy_file(source, target, fs::copy_options::overwrite_existing, ec);
+}
+
+#if defined(__linux__)
+static std::error_code reflinkImage(const std::string& source, const std::string& target) {
+	int in = open(source.c_str(), O_RDONLY | O_CLOEXEC);
+	if (in < 0) return std::error_code(errno, std::generic_category());
+	int out = open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (out < 0) {
+		std::error_code ec(errno, std::generic_category());
+		close(in);
+		return ec;
+	}
+	std::error_code ec;
+	if (ioctl(out, FICLONE, in) != 0) {
+		ec = std::error_code(errno, std::generic_category());
+	}
+	close(in);
+	close(out);
+	if (ec) unlink(target.c_str());
+	return ec;
+}
+#endif
+
+// 链接失败的原因是否只是目标文件系统不支持（跨设备、无权限建链接、不支持该操作），
+// 只有这些情况才值得退回到复制；源文件不存在、无访问权限、磁盘已满等错误复制同样会失败，直接报告
+static bool linkUnsupported(const std::error_code& ec) {
+	return ec == std::errc::cross_device_link
+		|| ec == std::errc::operation_not_permitted
+		|| ec == std::errc::operation_not_supported
+		|| ec == std::errc::not_supported
+		|| ec == std::errc::function_not_supported
+		|| ec == std::errc::too_many_links;
+}
+
+// 返回 true 表示以链接方式完成，false 表示退回到了复制；两者都失败时抛出异常
+static bool materializeImage(const std::string& source, const std::string& target, LinkMode mode) {
+	std::error_code ec;
+	// 目标已指向源文件（上次运行留下的链接，或输出目录就是照片目录）时删除它会丢失原照片
+	if (fs::equivalent(source, target, ec)) return true;
+	ec.clear();
+	fs::remove(target, ec);
+	switch (mode) {
+	case LinkMode::Hardlink:
+		fs::create_hard_link(source, target, ec);
+		if (!ec) return true;
+		if (!linkUnsupported(ec)) {
+			throw std::runtime_error("hardlink failed: " + source + " -> " + target + ": " + ec.message());
+		}
+		break;
+	case LinkMode::Reflink:
+#if defined(__linux__)
+		ec = reflinkImage(source, target);
+		if (!ec) return true;
+		// FICLONE 在文件系统不支持 reflink 时也可能返回 EINVAL
+		if (!linkUnsupported(ec) && ec != std::errc::invalid_argument) {
+			throw std::runtime_error("reflink failed: " + source + " -> " + target + ": " + ec.message());
+		}
+#endif
+		break;
+	case LinkMode::Symlink:
+		fs::create_symlink(fs::absolute(source), target, ec);
+		if (!ec) return true;
+		throw std::runtime_error("symlink failed: " + target + ": " + ec.message());
+	case LinkMode::Copy:
+		break;
+	}
+	if (!copyImage(source, target)) {
+		throw std::runtime_error("copy failed: " + source + " -> " + target);
+	}
+	return false;
+}
+
+static std::string imageFileName(std::string imagePath) {
+	std::replace(imagePath.begin(), imagePath.end(), '\\', '/');
+	return fs::path(imagePath).filename().string();
+}
+
+TileAssignmentStats assignPhotosToTiles(
+	const std::vector<PhotoData>& photos,
+	const std::vector<std::string>& tileNames,
+	const TileAssignmentOptions& options) {
+	// 按 tile 汇总超过阈值的照片，照片按序号排列保证输出稳定
+	std::vector<const PhotoData*> sortedPhotos;
+	sortedPhotos.reserve(photos.size());
+	for (const PhotoData& photoData : photos) {
+		sortedPhotos.push_back(&photoData);
+	}
+	std::sort(sortedPhotos.begin(), sortedPhotos.end(), [](const PhotoData* a, const PhotoData* b) {
+		return a->index < b->index;
+	});
+	std::vector<std::vector<const PhotoData*>> tilePhotos(tileNames.size());
+	for (const PhotoData* photoData : sortedPhotos) {
+		for (const TileIntersectionResult& result : photoData->intersectionResults) {
+			if (result.percentage > options.threshold && result.tileId < tileNames.size()) {
+				tilePhotos[result.tileId].push_back(photoData);
+			}
+		}
+	}
+
+	TileAssignmentStats stats;
+	std::atomic<size_t> nextTile(0), linked(0), copied(0), failed(0);
+	auto worker = [&]() {
+		for (size_t tileId = nextTile++; tileId < tileNames.size(); tileId = nextTile++) {
+			fs::path folder = fs::path(options.outputFolder) / tileNames[tileId];
+			std::error_code ec;
+			fs::create_directories(folder, ec);
+			if (ec) {
+				std::cerr << "无法创建目录：" << folder.string() << std::endl;
+				failed += tilePhotos[tileId].size();
+				continue;
+			}
+			std::ofstream indexFile((folder / "photo_indices.txt").string());
+			// 不同目录下的同名照片会落到同一个目标文件，后者不能静默覆盖前者
+			std::unordered_map<std::string, int> usedNames;
+			for (const PhotoData* photoData : tilePhotos[tileId]) {
+				std::string fileName = imageFileName(photoData->imagePath);
+				auto inserted = usedNames.emplace(fileName, photoData->index);
+				if (!inserted.second) {
+					std::cerr << "照片文件名冲突，跳过：" << photoData->imagePath << "（与照片 " << inserted.first->second
+						<< " 同名，tile " << tileNames[tileId] << "）" << std::endl;
+					++failed;
+					continue;
+				}
+				indexFile << photoData->index << "\n";
+				std::string target = (folder / fileName).string();
+				try {
+					if (materializeImage(photoData->imagePath, target, options.linkMode)) {
+						++linked;
+					}
+					else {
+						++copied;
+					}
+				}
+				catch (const std::exception& e) {
+					std::cerr << e.what() << std::endl;
+					++failed;
+				}
+			}
+		}
+	};
+
+	unsigned int numThreads = options.numThreads > 0 ? options.numThreads : std::max(1u, std::thread::hardware_concurrency());
+	std::vector<std::thread> threads;
+	for (unsigned int i = 0; i < numThreads; ++i) {
+		threads.emplace_back(worker);
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	for (const auto& list : tilePhotos) {
+		stats.assignedPairs += list.size();
+	}
+	stats.linked = linked;
+	stats.copied = copied;
+	stats.failed = failed;
+	std::cout << "Tile assignment: " << stats.assignedPairs << " photo/tile pairs, " << stats.linked << " linked, "
+		<< stats.copied << " copied, " << stats.failed << " failed." << std::endl;
+	return stats;
+}
@@ -0,0 +1,135 @@
+#include "TileBroadPhase.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static const size_t kLaneWidth = 8;
+
+// 方向分量为 0 时用极小值代替，保证倒数为有限的大数而不是 inf * 0
+static float safeInverse(double d) {
+	const double kEpsilon = 1e-30;
+	if (std::fabs(d) < kEpsilon) d = d < 0.0 ? -kEpsilon : kEpsilon;
+	return static_cast<float>(1.0 / d);
+}
+
+#if defined(__AVX2__)
+static int lowestSetBit(int mask) {
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, static_cast<unsigned long>(mask));
+	return static_cast<int>(index);
+#else
+	return __builtin_ctz(static_cast<unsigned int>(mask));
+#endif
+}
+#endif
+
+TileBroadPhase::TileBroadPhase() : numBoxes(0), localOrigin(0.0, 0.0, 0.0) {}
+
+TileBroadPhase::TileBroadPhase(const std::vector<osg::BoundingBox>& boxes) : numBoxes(0), localOrigin(0.0, 0.0, 0.0) {
+	build(boxes);
+}
+
+void TileBroadPhase::build(const std::vector<osg::BoundingBox>& boxes) {
+	numBoxes = boxes.size();
+	size_t padded = (numBoxes + kLaneWidth - 1) / kLaneWidth * kLaneWidth;
+	// 无效包围盒与补齐通道存为空盒，但 [+inf, -inf] 的 slab 区间是 (-inf, +inf)，会被当作命中，
+	// 因此另用 validMask 排除
+	const float inf = std::numeric_limits<float>::infinity();
+	minX.assign(padded, inf); minY.assign(padded, inf); minZ.assign(padded, inf);
+	maxX.assign(padded, -inf); maxY.assign(padded, -inf); maxZ.assign(padded, -inf);
+	validMask.assign(padded, 0);
+	// 局部原点取所有有效包围盒并集的中心
+	osg::BoundingBox bounds;
+	for (size_t i = 0; i < numBoxes; ++i) {
+		if (boxes[i].valid()) bounds.expandBy(boxes[i]);
+	}
+	localOrigin = bounds.valid() ? osg::Vec3d(bounds.center()) : osg::Vec3d(0.0, 0.0, 0.0);
+	for (size_t i = 0; i < numBoxes; ++i) {
+		const osg::BoundingBox& bbox = boxes[i];
+		if (!bbox.valid()) continue;
+		validMask[i] = -1;
+		minX[i] = static_cast<float>(bbox.xMin() - localOrigin.x());
+		minY[i] = static_cast<float>(bbox.yMin() - localOrigin.y());
+		minZ[i] = static_cast<float>(bbox.zMin() - localOrigin.z());
+		maxX[i] = static_cast<float>(bbox.xMax() - localOrigin.x());
+		maxY[i] = static_cast<float>(bbox.yMax() - localOrigin.y());
+		maxZ[i] = static_cast<float>(bbox.zMax() - localOrigin.z());
+	}
+}
+
+void TileBroadPhase::intersect(const osg::Vec3d& origin, const osg::Vec3d& direction, float tmin, float tmax,
+	std::vector<TileHit>& hits) const {
+	hits.clear();
+	const float ox = static_cast<float>(origin.x() - localOrigin.x());
+	const float oy = static_cast<float>(origin.y() - localOrigin.y());
+	const float oz = static_cast<float>(origin.z() - localOrigin.z());
+	const float ix = safeInverse(direction.x());
+	const float iy = safeInverse(direction.y());
+	const float iz = safeInverse(direction.z());
+
+#if defined(__AVX2__)
+	const __m256 vox = _mm256_set1_ps(ox), voy = _mm256_set1_ps(oy), voz = _mm256_set1_ps(oz);
+	const __m256 vix = _mm256_set1_ps(ix), viy = _mm256_set1_ps(iy), viz = _mm256_set1_ps(iz);
+	const __m256 vtmin = _mm256_set1_ps(tmin), vtmax = _mm256_set1_ps(tmax);
+
+	for (size_t base = 0; base < numBoxes; base += kLaneWidth) {
+		__m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&minX[base]), vox), vix);
+		__m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&maxX[base]), vox), vix);
+		__m256 tNear = _mm256_max_ps(vtmin, _mm256_min_ps(t0, t1));
+		__m256 tFar = _mm256_min_ps(vtmax, _mm256_max_ps(t0, t1));
+
+		t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&minY[base]), voy), viy);
+		t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&maxY[base]), voy), viy);
+		tNear = _mm256_max_ps(tNear, _mm256_min_ps(t0, t1));
+		tFar = _mm256_min_ps(tFar, _mm256_max_ps(t0, t1));
+
+		t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&minZ[base]), voz), viz);
+		t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&maxZ[base]), voz), viz);
+		tNear = _mm256_max_ps(tNear, _mm256_min_ps(t0, t1));
+		tFar = _mm256_min_ps(tFar, _mm256_max_ps(t0, t1));
+
+		// 无效包围盒与最后一组中补齐的通道不参与结果
+		__m256i valid = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&validMask[base]));
+		__m256 hitMask = _mm256_and_ps(_mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ), _mm256_castsi256_ps(valid));
+		int mask = _mm256_movemask_ps(hitMask);
+		if (mask == 0) continue;
+
+		alignas(32) float nearValues[kLaneWidth];
+		alignas(32) float farValues[kLaneWidth];
+		_mm256_store_ps(nearValues, tNear);
+		_mm256_store_ps(farValues, tFar);
+		while (mask) {
+			int lane = lowestSetBit(mask);
+			mask &= mask - 1;
+			hits.push_back({ static_cast<uint32_t>(base + lane), nearValues[lane], farValues[lane] });
+		}
+	}
+#else
+	for (size_t i = 0; i < numBoxes; ++i) {
+		if (!validMask[i]) continue;
+		float t0 = (minX[i] - ox) * ix, t1 = (maxX[i] - ox) * ix;
+		float tNear = std::max(tmin, std::min(t0, t1));
+		float tFar = std::min(tmax, std::max(t0, t1));
+		t0 = (minY[i] - oy) * iy; t1 = (maxY[i] - oy) * iy;
+		tNear = std::max(tNear, std::min(t0, t1));
+		tFar = std::min(tFar, std::max(t0, t1));
+		t0 = (minZ[i] - oz) * iz; t1 = (maxZ[i] - oz) * iz;
+		tNear = std::max(tNear, std::min(t0, t1));
+		tFar = std::min(tFar, std::max(t0, t1));
+		if (tNear <= tFar) {
+			hits.push_back({ static_cast<uint32_t>(i), tNear, tFar });
+		}
+	}
+#endif
+
+	std::sort(hits.begin(), hits.end(), [](const TileHit& a, const TileHit& b) {
+		return a.tEnter < b.tEnter || (a.tEnter == b.tEnter && a.tileId < b.tileId);
+	});
+}
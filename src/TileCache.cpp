@@ -0,0 +1,242 @@
+#include "TileCache.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char kTileCacheMagic[4] = { 'P', 'M', 'T', 'C' };
+static const uint32_t kTileCacheVersion = 1;
+static const uint64_t kTileCacheAlignment = 64;
+
+struct TileCacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t bvhWidth;
+	uint32_t nodeBytes;
+	uint64_t numTiles;
+	uint64_t fileBytes;  // 检测截断的文件
+};
+
+struct TileCacheRecord {
+	uint64_t sourceStamp;
+	uint64_t triangles;
+	float bbox[6];
+	float bvhBounds[6];
+	uint32_t root;
+	uint32_t rootCount;
+	uint64_t nameOffset, nameLength;
+	uint64_t verticesOffset, numVertices;
+	uint64_t indicesOffset, numIndices;
+	uint64_t nodesOffset, numNodes;
+	uint64_t primitivesOffset, numPrimitives;
+};
+
+static void boxToFloats(const osg::BoundingBox& box, float values[6]) {
+	for (int axis = 0; axis < 3; ++axis) {
+		values[axis] = box._min[axis];
+		values[axis + 3] = box._max[axis];
+	}
+}
+
+static osg::BoundingBox floatsToBox(const float values[6]) {
+	return osg::BoundingBox(values[0], values[1], values[2], values[3], values[4], values[5]);
+}
+
+TileCache::~TileCache() {
+	if (!data) return;
+#if defined(_WIN32)
+	UnmapViewOfFile(data);
+	CloseHandle(static_cast<HANDLE>(mappingHandle));
+#else
+	munmap(const_cast<char*>(data), size);
+#endif
+}
+
+std::unique_ptr<TileCache> TileCache::open(const std::string& path, int bvhWidth) {
+	std::unique_ptr<TileCache> cache(new TileCache());
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) return nullptr;
+	LARGE_INTEGER fileSize;
+	HANDLE mapping = GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0
+		? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+	CloseHandle(file);
+	if (!mapping) return nullptr;
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view) {
+		CloseHandle(mapping);
+		return nullptr;
+	}
+	cache->data = static_cast<const char*>(view);
+	cache->size = static_cast<size_t>(fileSize.QuadPart);
+	cache->mappingHandle = mapping;
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return nullptr;
+	struct stat fileStat;
+	void* view = fstat(fd, &fileStat) == 0 && fileStat.st_size > 0
+		? mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+	// 映射建立后即可关闭文件描述符
+	close(fd);
+	if (view == MAP_FAILED) return nullptr;
+	cache->data = static_cast<const char*>(view);
+	cache->size = static_cast<size_t>(fileStat.st_size);
+#endif
+
+	// 校验头部与每条记录的数组范围，不合格的文件视为不存在
+	if (cache->size < sizeof(TileCacheHeader)) return nullptr;
+	TileCacheHeader header;
+	std::memcpy(&header, cache->data, sizeof(header));
+	const size_t nodeBytes = bvhWidth == 4 ? sizeof(WideBvhNode<4>) : sizeof(WideBvhNode<8>);
+	if (std::memcmp(header.magic, kTileCacheMagic, 4) != 0 || header.version != kTileCacheVersion
+		|| header.bvhWidth != static_cast<uint32_t>(bvhWidth) || header.nodeBytes != nodeBytes || header.fileBytes != cache->size
+		|| header.numTiles > (cache->size - sizeof(header)) / sizeof(TileCacheRecord)) {
+		return nullptr;
+	}
+	auto inRange = [&](uint64_t offset, uint64_t count, uint64_t elementBytes) {
+		return offset <= cache->size && count <= (cache->size - offset) / elementBytes;
+	};
+	const TileCacheRecord* records = reinterpret_cast<const TileCacheRecord*>(cache->data + sizeof(header));
+	for (uint64_t index = 0; index < header.numTiles; ++index) {
+		const TileCacheRecord& record = records[index];
+		if (!inRange(record.nameOffset, record.nameLength, 1) || !inRange(record.verticesOffset, record.numVertices, sizeof(osg::Vec3f))
+			|| !inRange(record.indicesOffset, record.numIndices, sizeof(uint32_t)) || !inRange(record.nodesOffset, record.numNodes, nodeBytes)
+			|| !inRange(record.primitivesOffset, record.numPrimitives, sizeof(uint32_t))) {
+			return nullptr;
+		}
+		TileSummary summary;
+		summary.name.assign(cache->data + record.nameOffset, record.nameLength);
+		summary.bbox = floatsToBox(record.bbox);
+		summary.triangles = record.triangles;
+		summary.sourceStamp = record.sourceStamp;
+		cache->tileIndices[summary.name] = static_cast<int>(cache->tiles.size());
+		cache->tiles.push_back(summary);
+	}
+	std::cout << "Mapped tile cache " << path << ": " << cache->tiles.size() << " tiles, " << (cache->size >> 20) << " MB" << std::endl;
+	return cache;
+}
+
+int TileCache::findTile(const std::string& name) const {
+	auto it = tileIndices.find(name);
+	return it == tileIndices.end() ? -1 : it->second;
+}
+
+template <int Width>
+void TileCache::attach(size_t index, TileBvh<Width>& tileBvh) const {
+	const TileCacheRecord& record = reinterpret_cast<const TileCacheRecord*>(data + sizeof(TileCacheHeader))[index];
+	tileBvh.vertices = reinterpret_cast<const osg::Vec3f*>(data + record.verticesOffset);
+	tileBvh.indices = reinterpret_cast<const uint32_t*>(data + record.indicesOffset);
+	tileBvh.numVertices = record.numVertices;
+	tileBvh.numTriangles = record.numIndices / 3;
+	tileBvh.bvh.attach(reinterpret_cast<const WideBvhNode<Width>*>(data + record.nodesOffset), record.numNodes,
+		reinterpret_cast<const uint32_t*>(data + record.primitivesOffset), record.numPrimitives,
+		floatsToBox(record.bvhBounds), record.root, record.rootCount);
+}
+
+template <int Width>
+void writeTileCache(const std::string& path, const SceneBuilder& builder, const std::vector<const TileBvh<Width>*>& tileBvhs) {
+	const TileRegistry& registry = builder.getTileRegistry();
+	std::vector<TileId> ids;
+	for (TileId id = 0; id < registry.size() && id < tileBvhs.size(); ++id) {
+		if (tileBvhs[id]) ids.push_back(id);
+	}
+
+	// 先排好所有数组的偏移，再顺序写出
+	TileCacheHeader header;
+	std::memcpy(header.magic, kTileCacheMagic, 4);
+	header.version = kTileCacheVersion;
+	header.bvhWidth = Width;
+	header.nodeBytes = sizeof(WideBvhNode<Width>);
+	header.numTiles = ids.size();
+	uint64_t offset = sizeof(TileCacheHeader) + ids.size() * sizeof(TileCacheRecord);
+	auto place = [&offset](uint64_t bytes) {
+		offset = (offset + kTileCacheAlignment - 1) / kTileCacheAlignment * kTileCacheAlignment;
+		uint64_t placed = offset;
+		offset += bytes;
+		return placed;
+	};
+	std::vector<TileCacheRecord> records(ids.size());
+	for (size_t index = 0; index < ids.size(); ++index) {
+		const TileBvh<Width>& tileBvh = *tileBvhs[ids[index]];
+		TileCacheRecord& record = records[index];
+		std::memset(&record, 0, sizeof(record));
+		record.sourceStamp = tileSourceStamp(builder.getTileFilePaths()[ids[index]]);
+		record.triangles = tileBvh.numTriangles;
+		boxToFloats(builder.getTileBoundingBoxes()[ids[index]].bbox, record.bbox);
+		boxToFloats(tileBvh.bvh.getBounds(), record.bvhBounds);
+		record.root = tileBvh.bvh.getRoot();
+		record.rootCount = tileBvh.bvh.getRootCount();
+		record.nameLength = registry.getTileName(ids[index]).size();
+		record.nameOffset = place(record.nameLength);
+		record.numVertices = tileBvh.numVertices;
+		record.verticesOffset = place(record.numVertices * sizeof(osg::Vec3f));
+		record.numIndices = tileBvh.numTriangles * 3;
+		record.indicesOffset = place(record.numIndices * sizeof(uint32_t));
+		record.numNodes = tileBvh.bvh.numNodes();
+		record.nodesOffset = place(record.numNodes * sizeof(WideBvhNode<Width>));
+		record.numPrimitives = tileBvh.bvh.numPrimitives();
+		record.primitivesOffset = place(record.numPrimitives * sizeof(uint32_t));
+	}
+	header.fileBytes = offset;
+
+	// 多个进程可能同时发现缓存缺失而各自写出，临时文件按进程与线程区分，改名前互不干扰
+#if defined(_WIN32)
+	const unsigned long processId = GetCurrentProcessId();
+#else
+	const unsigned long processId = static_cast<unsigned long>(getpid());
+#endif
+	const std::string temporary = path + "." + std::to_string(processId) + "."
+		+ std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+	{
+		std::ofstream out(temporary.c_str(), std::ios::binary | std::ios::trunc);
+		if (!out) throw std::runtime_error("Unable to write tile cache: " + temporary);
+		uint64_t written = 0;
+		auto write = [&](uint64_t at, const void* bytes, uint64_t count) {
+			static const char padding[kTileCacheAlignment] = {};
+			out.write(padding, static_cast<std::streamsize>(at - written));
+			out.write(static_cast<const char*>(bytes), static_cast<std::streamsize>(count));
+			written = at + count;
+		};
+		write(0, &header, sizeof(header));
+		write(written, records.data(), records.size() * sizeof(TileCacheRecord));
+		for (size_t index = 0; index < ids.size(); ++index) {
+			const TileBvh<Width>& tileBvh = *tileBvhs[ids[index]];
+			const TileCacheRecord& record = records[index];
+			write(record.nameOffset, registry.getTileName(ids[index]).data(), record.nameLength);
+			write(record.verticesOffset, tileBvh.vertices, record.numVertices * sizeof(osg::Vec3f));
+			write(record.indicesOffset, tileBvh.indices, record.numIndices * sizeof(uint32_t));
+			write(record.nodesOffset, tileBvh.bvh.getNodes(), record.numNodes * sizeof(WideBvhNode<Width>));
+			write(record.primitivesOffset, tileBvh.bvh.getPrimitiveIndices(), record.numPrimitives * sizeof(uint32_t));
+		}
+		out.close();
+		if (!out) {
+			std::remove(temporary.c_str());
+			throw std::runtime_error("Unable to write tile cache: " + temporary);
+		}
+	}
+	// POSIX 上改名直接替换旧文件；Windows 上目标存在时改名失败，先删除再改名
+	if (std::rename(temporary.c_str(), path.c_str()) != 0
+		&& (std::remove(path.c_str()) != 0 || std::rename(temporary.c_str(), path.c_str()) != 0)) {
+		std::remove(temporary.c_str());
+		throw std::runtime_error("Failed to rename " + temporary + " to " + path);
+	}
+	std::cout << "Wrote tile cache " << path << ": " << ids.size() << " tiles, " << (header.fileBytes >> 20) << " MB" << std::endl;
+}
+
+template void TileCache::attach<4>(size_t, TileBvh<4>&) const;
+template void TileCache::attach<8>(size_t, TileBvh<8>&) const;
+template void writeTileCache<4>(const std::string&, const SceneBuilder&, const std::vector<const TileBvh<4>*>&);
+template void writeTileCache<8>(const std::string&, const SceneBuilder&, const std::vector<const TileBvh<8>*>&);
@@ -0,0 +1,161 @@
+#include "TileGrid.h"
+#include <cstdlib>
+#include <iostream>
+
+static const long long kMaxGridCells = 16LL * 1024 * 1024;
+
+// 读取一个可带正负号的十进制整数，成功时 pos 移到数字之后
+static bool parseGridNumber(const std::string& name, size_t& pos, int& value) {
+	size_t begin = pos;
+	if (pos < name.size() && (name[pos] == '+' || name[pos] == '-')) ++pos;
+	size_t digits = pos;
+	while (pos < name.size() && name[pos] >= '0' && name[pos] <= '9') ++pos;
+	if (pos == digits) return false;
+	value = std::atoi(name.substr(begin, pos - begin).c_str());
+	return true;
+}
+
+bool parseTileGridName(const std::string& name, int& gridX, int& gridY) {
+	const std::string prefix = "Tile_";
+	if (name.compare(0, prefix.size(), prefix) != 0) return false;
+	size_t pos = prefix.size();
+	if (!parseGridNumber(name, pos, gridX)) return false;
+	if (pos >= name.size() || name[pos] != '_') return false;
+	++pos;
+	if (!parseGridNumber(name, pos, gridY)) return false;
+	return pos == name.size();
+}
+
+// 最小二乘拟合 center = offset + pitch * index，返回最大残差；编号只有一个取值时 pitch 为 0
+static double fitGridAxis(const std::vector<int>& indices, const std::vector<double>& centers, double& offset, double& pitch) {
+	const size_t n = indices.size();
+	double meanIndex = 0.0, meanCenter = 0.0;
+	for (size_t i = 0; i < n; ++i) {
+		meanIndex += indices[i];
+		meanCenter += centers[i];
+	}
+	meanIndex /= n;
+	meanCenter /= n;
+	double covariance = 0.0, variance = 0.0;
+	for (size_t i = 0; i < n; ++i) {
+		covariance += (indices[i] - meanIndex) * (centers[i] - meanCenter);
+		variance += (indices[i] - meanIndex) * (indices[i] - meanIndex);
+	}
+	pitch = variance > 0.0 ? covariance / variance : 0.0;
+	offset = meanCenter - pitch * meanIndex;
+	double residual = 0.0;
+	for (size_t i = 0; i < n; ++i) {
+		residual = std::max(residual, std::fabs(centers[i] - offset - pitch * indices[i]));
+	}
+	return residual;
+}
+
+TileGrid::TileGrid()
+	: valid(false), columns(0), rows(0), originX(0.0), originZ(0.0), cellSizeX(0.0), cellSizeZ(0.0),
+	minGridX(0), minGridY(0), gridColumns(0), gridRows(0) {}
+
+void TileGrid::build(const std::vector<std::string>& names, const std::vector<osg::BoundingBox>& boxes) {
+	*this = TileGrid();
+
+	std::vector<int> gridXs, gridYs;
+	std::vector<double> centerXs, centerZs;
+	std::vector<TileId> ids;
+	double maxExtentX = 0.0, maxExtentZ = 0.0;
+	osg::BoundingBox bounds;
+	for (size_t id = 0; id < names.size() && id < boxes.size(); ++id) {
+		int gridX, gridY;
+		if (!parseTileGridName(names[id], gridX, gridY)) {
+			std::cout << "Tile grid disabled: " << names[id] << " does not follow Tile_XXXX_YYYY." << std::endl;
+			return;
+		}
+		const osg::BoundingBox& box = boxes[id];
+		if (!box.valid()) continue;
+		gridXs.push_back(gridX);
+		gridYs.push_back(gridY);
+		centerXs.push_back(box.center().x());
+		centerZs.push_back(box.center().z());
+		ids.push_back(static_cast<TileId>(id));
+		maxExtentX = std::max(maxExtentX, static_cast<double>(box.xMax() - box.xMin()));
+		maxExtentZ = std::max(maxExtentZ, static_cast<double>(box.zMax() - box.zMin()));
+		bounds.expandBy(box);
+	}
+	if (ids.empty()) return;
+
+	// 名称的两个编号分别对应地面的哪条轴由拟合残差决定
+	double offsetXX, pitchXX, offsetYZ, pitchYZ, offsetXZ, pitchXZ, offsetYX, pitchYX;
+	double direct = std::max(fitGridAxis(gridXs, centerXs, offsetXX, pitchXX), fitGridAxis(gridYs, centerZs, offsetYZ, pitchYZ));
+	double swapped = std::max(fitGridAxis(gridXs, centerZs, offsetXZ, pitchXZ), fitGridAxis(gridYs, centerXs, offsetYX, pitchYX));
+	const bool swapAxes = swapped < direct;
+	double offsetX = swapAxes ? offsetYX : offsetXX, pitchX = swapAxes ? pitchYX : pitchXX;
+	double offsetZ = swapAxes ? offsetXZ : offsetYZ, pitchZ = swapAxes ? pitchXZ : pitchYZ;
+	const double residual = swapAxes ? swapped : direct;
+
+	// 只有一行或一列时该方向的间距取包围盒尺寸
+	cellSizeX = pitchX != 0.0 ? std::fabs(pitchX) : maxExtentX;
+	cellSizeZ = pitchZ != 0.0 ? std::fabs(pitchZ) : maxExtentZ;
+	if (!(cellSizeX > 0.0) || !(cellSizeZ > 0.0) || residual > 0.25 * std::min(cellSizeX, cellSizeZ)) {
+		std::cout << "Tile grid disabled: tile positions do not match their grid names." << std::endl;
+		return;
+	}
+
+	// 格线位于相邻 tile 中心之间，网格向外扩展到覆盖所有包围盒
+	const double latticeX = offsetX - 0.5 * cellSizeX, latticeZ = offsetZ - 0.5 * cellSizeZ;
+	originX = latticeX + std::floor((bounds.xMin() - latticeX) / cellSizeX) * cellSizeX;
+	originZ = latticeZ + std::floor((bounds.zMin() - latticeZ) / cellSizeZ) * cellSizeZ;
+	columns = std::max(1, static_cast<int>(std::ceil((bounds.xMax() - originX) / cellSizeX)));
+	rows = std::max(1, static_cast<int>(std::ceil((bounds.zMax() - originZ) / cellSizeZ)));
+	if (static_cast<long long>(columns) * rows > kMaxGridCells) {
+		std::cout << "Tile grid disabled: " << columns << "x" << rows << " cells is too large." << std::endl;
+		return;
+	}
+
+	// 两遍计数建立 CSR 形式的格子 tile 列表
+	auto cellRange = [&](const osg::BoundingBox& box, int& x0, int& x1, int& z0, int& z1) {
+		x0 = std::max(0, static_cast<int>(std::floor((box.xMin() - originX) / cellSizeX)));
+		x1 = std::min(columns - 1, static_cast<int>(std::floor((box.xMax() - originX) / cellSizeX)));
+		z0 = std::max(0, static_cast<int>(std::floor((box.zMin() - originZ) / cellSizeZ)));
+		z1 = std::min(rows - 1, static_cast<int>(std::floor((box.zMax() - originZ) / cellSizeZ)));
+	};
+	cellStart.assign(static_cast<size_t>(columns) * rows + 1, 0);
+	for (TileId id : ids) {
+		int x0, x1, z0, z1;
+		cellRange(boxes[id], x0, x1, z0, z1);
+		for (int z = z0; z <= z1; ++z)
+			for (int x = x0; x <= x1; ++x) ++cellStart[static_cast<size_t>(z) * columns + x + 1];
+	}
+	for (size_t i = 1; i < cellStart.size(); ++i) cellStart[i] += cellStart[i - 1];
+	cellTiles.resize(cellStart.back());
+	std::vector<uint32_t> cursor(cellStart.begin(), cellStart.end() - 1);
+	for (TileId id : ids) {
+		int x0, x1, z0, z1;
+		cellRange(boxes[id], x0, x1, z0, z1);
+		for (int z = z0; z <= z1; ++z)
+			for (int x = x0; x <= x1; ++x) cellTiles[cursor[static_cast<size_t>(z) * columns + x]++] = id;
+	}
+
+	minGridX = *std::min_element(gridXs.begin(), gridXs.end());
+	minGridY = *std::min_element(gridYs.begin(), gridYs.end());
+	gridColumns = *std::max_element(gridXs.begin(), gridXs.end()) - minGridX + 1;
+	gridRows = *std::max_element(gridYs.begin(), gridYs.end()) - minGridY + 1;
+	if (static_cast<long long>(gridColumns) * gridRows > kMaxGridCells) {
+		std::cout << "Tile grid disabled: grid names span too many cells." << std::endl;
+		*this = TileGrid();
+		return;
+	}
+	nameIndex.assign(static_cast<size_t>(gridColumns) * gridRows, kInvalidTileId);
+	for (size_t i = 0; i < ids.size(); ++i) {
+		TileId& slot = nameIndex[static_cast<size_t>(gridYs[i] - minGridY) * gridColumns + (gridXs[i] - minGridX)];
+		if (slot == kInvalidTileId) slot = ids[i];
+	}
+
+	valid = true;
+	std::cout << "Tile grid: " << columns << "x" << rows << " cells of " << cellSizeX << " x " << cellSizeZ
+		<< ", " << cellTiles.size() << " tile references" << (swapAxes ? " (names swapped to z, x)" : "") << std::endl;
+}
+
+TileId TileGrid::tileAt(int gridX, int gridY) const {
+	if (!valid) return kInvalidTileId;
+	int x = gridX - minGridX, y = gridY - minGridY;
+	if (x < 0 || x >= gridColumns || y < 0 || y >= gridRows) return kInvalidTileId;
+	return nameIndex[static_cast<size_t>(y) * gridColumns + x];
+}
@@ -6,24 +6,23 @@
 #include <fstream>
 #include <vector>
 #include <iomanip>
+#include <algorithm>
+#include <unordered_map>
+#include <cmath>
+#include <atomic>
+#include <thread>
 #include <Camera.h>
+#include "TileBroadPhase.h"
+#include "ThreadPool.h"
+
+// 宽相位使用 float，提前结束判断时留出的相对误差
+static const double kBroadPhaseTolerance = 1e-5;
 
 static std::ostream& operator<<(std::ostream& os, const osg::Vec3d& vec) {
 	os << "(" << vec.x() << ", " << vec.y() << ", " << vec.z() << ")";
 	return os;
 }
 
-// 辅助函数：根据名称查找节点
-static osg::Node* findNodeByName(const osg::ref_ptr<osg::Group>& group, const std::string& name) {
-	for (unsigned int i = 0; i < group->getNumChildren(); ++i) {
-		osg::Node* child = group->getChild(i);
-		if (child->getName() == name) {
-			return child;
-		}
-	}
-	return nullptr;
-}
-
 // 递归遍历节点树，找到所有的 osg::Geode 节点
 static void findGeodes(osg::Node* node, std::vector<osg::Geode*>& geodes) {
 	if (!node) return;
@@ -41,87 +40,394 @@ static void findGeodes(osg::Node* node, std::vector<osg::Geode*>& geodes) {
 	}
 }
 
-std::vector<TileIntersectionResult> performRayTileIntersections(
-	const osg::ref_ptr<osg::Group>& scene,
-	const std::vector<std::pair<osg::Vec3d, osg::Vec3d>>& pixelRays,
-	const std::vector<NamedBoundingBox>& intersectingTiles) {
-	// 存储每个 tile 被射线击中的数量
-	std::map<std::string, int> tileHitCounts;
-
-	// 初始化所有 tile 的击中计数
+// 用候选 tile 的包围盒构建宽相位，供逐射线由近到远地访问 tile
+static TileBroadPhase buildTileBroadPhase(const std::vector<NamedBoundingBox>& intersectingTiles) {
+	std::vector<osg::BoundingBox> boxes;
+	boxes.reserve(intersectingTiles.size());
 	for (const auto& tile : intersectingTiles) {
-		tileHitCounts[tile.name] = 0;
+		boxes.push_back(tile.bbox);
+	}
+	return TileBroadPhase(boxes);
+}
+
+// 逐射线求最先击中的 tile。候选 tile 的 geode 在构造时收集一次，求交器和访问器在射线之间复用。
+// 提供有效的 tile 网格时按 2D DDA 由近到远访问格子，否则用包围盒宽相位
+class ClosestTileTracer {
+public:
+	ClosestTileTracer(const std::vector<osg::ref_ptr<osg::Node>>& tileNodes,
+		const std::vector<NamedBoundingBox>& intersectingTiles, const TileGrid* tileGrid = nullptr)
+		: tileGrid(tileGrid && tileGrid->isValid() ? tileGrid : nullptr),
+		tileGeodes(intersectingTiles.size()),
+		intersector(new osgUtil::LineSegmentIntersector(osg::Vec3d(), osg::Vec3d(0.0, 0.0, 1.0))) {
+		visitor = new osgUtil::IntersectionVisitor(intersector.get());
+		if (this->tileGrid) {
+			// TileId 到候选下标的映射，不在候选中的 tile 为 -1
+			for (size_t i = 0; i < intersectingTiles.size(); ++i) {
+				TileId id = intersectingTiles[i].id;
+				if (id >= candidateIndex.size()) candidateIndex.resize(id + 1, -1);
+				candidateIndex[id] = static_cast<int>(i);
+			}
+			testedStamp.assign(intersectingTiles.size(), 0);
+		}
+		else {
+			broadPhase = buildTileBroadPhase(intersectingTiles);
+		}
+		for (size_t i = 0; i < intersectingTiles.size(); ++i) {
+			osg::Node* tileNode = tileNodes[intersectingTiles[i].id].get();
+			if (tileNode) {
+				findGeodes(tileNode, tileGeodes[i]);
+			}
+			else {
+				std::cout << "Tile not found: #" << intersectingTiles[i].id << std::endl;
+			}
+		}
 	}
 
-	for (const auto& ray : pixelRays) {
-		osg::Vec3d start(ray.first.x(), ray.first.y(), ray.first.z());
-		osg::Vec3d end(ray.second.x(), ray.second.y(), ray.second.z());
+	// 返回最先击中的 tile 在 intersectingTiles 中的下标，未击中返回 -1
+	int trace(const std::pair<osg::Vec3d, osg::Vec3d>& ray) {
+		const osg::Vec3d& start = ray.first;
+		const osg::Vec3d& end = ray.second;
+		// 裁剪后的空线段没有穿过任何候选 tile
+		if (start == end) return -1;
+		if (tileGrid) return traceGrid(start, end);
+
+		// 线段参数 t ∈ [0, 1]，只保留线段穿过的包围盒
+		broadPhase.intersect(start, end - start, 0.0f, 1.0f, hits);
+		if (hits.empty()) return -1;
 
-		osg::ref_ptr<osgUtil::LineSegmentIntersector> intersector =
-			new osgUtil::LineSegmentIntersector(start, end);
-		osg::ref_ptr<osgUtil::IntersectionVisitor> iv = new osgUtil::IntersectionVisitor(intersector.get());
+		intersector->setStart(start);
+		intersector->setEnd(end);
+		intersector->reset();
+		visitor->reset();
 
+		const double segmentLength = (end - start).length();
 		double closestDistance = std::numeric_limits<double>::max();
-		std::string closestTile;
-		osg::Vec3d closestIntersection;
+		int closestTile = -1;
 
-		for (const auto& tile : intersectingTiles) {
-			osg::Node* tileNode = findNodeByName(scene, tile.name);
-			if (tileNode) {
-				std::vector<osg::Geode*> geodes;
-				findGeodes(tileNode, geodes);
-				for (osg::Geode* geode : geodes) {
-					//std::cout << "Checking geode: " << geode->getName() << std::endl;
-					for (unsigned int i = 0; i < geode->getNumDrawables(); ++i) {
-						osg::Drawable* drawable = geode->getDrawable(i);
-						//std::cout << "Drawable type: " << drawable->className() << std::endl;
-						osg::Geometry* geometry = dynamic_cast<osg::Geometry*>(drawable);
-						//if (geometry) {
-						//    std::cout << "Geometry has " << geometry->getVertexArray()->getNumElements() << " vertices" << std::endl;
-						//}
-					}
-					geode->accept(*iv);
-					if (intersector->containsIntersections()) {
-						osgUtil::LineSegmentIntersector::Intersections intersections = intersector->getIntersections();
-						for (auto& intersection : intersections) {
-							double distance = (intersection.getWorldIntersectPoint() - start).length();
-							if (distance < closestDistance) {
-								closestDistance = distance;
-								closestTile = tile.name;
-								closestIntersection = intersection.getWorldIntersectPoint();
-							}
-						}
-					}
+		for (const TileHit& hit : hits) {
+			// 包围盒按进入距离排序，已有交点比后续包围盒的入口更近时即可结束
+			if (closestTile >= 0 && hit.tEnter * segmentLength > closestDistance + kBroadPhaseTolerance * segmentLength) break;
+
+			testTile(static_cast<int>(hit.tileId), start, closestDistance, closestTile);
+		}
+		return closestTile;
+	}
+
+private:
+	// 用 geode 测试候选 tile，更近的交点更新 closestDistance / closestTile
+	void testTile(int candidate, const osg::Vec3d& start, double& closestDistance, int& closestTile) {
+		for (osg::Geode* geode : tileGeodes[candidate]) {
+			geode->accept(*visitor);
+			if (!intersector->containsIntersections()) continue;
+			for (auto& intersection : intersector->getIntersections()) {
+				double distance = (intersection.getWorldIntersectPoint() - start).length();
+				if (distance < closestDistance) {
+					closestDistance = distance;
+					closestTile = candidate;
 				}
 			}
-			else {
-				std::cout << "Tile not found: " << tile.name << std::endl;
+		}
+	}
+
+	// 沿线段经过的格子由近到远测试其中的 tile，交点不超出当前格子的出口即为最近交点
+	int traceGrid(const osg::Vec3d& start, const osg::Vec3d& end) {
+		intersector->setStart(start);
+		intersector->setEnd(end);
+		intersector->reset();
+		visitor->reset();
+		// 跨格子的 tile 每条射线只测试一次
+		if (++stamp == 0) {
+			std::fill(testedStamp.begin(), testedStamp.end(), 0u);
+			stamp = 1;
+		}
+
+		const double segmentLength = (end - start).length();
+		double closestDistance = std::numeric_limits<double>::max();
+		int closestTile = -1;
+		tileGrid->traverse(start, end, [&](const TileId* tiles, size_t count, double, double tExit) {
+			for (size_t i = 0; i < count; ++i) {
+				if (tiles[i] >= candidateIndex.size()) continue;
+				int candidate = candidateIndex[tiles[i]];
+				if (candidate < 0 || testedStamp[candidate] == stamp) continue;
+				testedStamp[candidate] = stamp;
+				testTile(candidate, start, closestDistance, closestTile);
 			}
+			return !(closestTile >= 0 && closestDistance <= tExit * segmentLength);
+		});
+		return closestTile;
+	}
+
+	const TileGrid* tileGrid;
+	TileBroadPhase broadPhase;
+	std::vector<int> candidateIndex;
+	std::vector<unsigned int> testedStamp;
+	unsigned int stamp = 0;
+	std::vector<std::vector<osg::Geode*>> tileGeodes;  // 按候选下标
+	osg::ref_ptr<osgUtil::LineSegmentIntersector> intersector;
+	osg::ref_ptr<osgUtil::IntersectionVisitor> visitor;
+	std::vector<TileHit> hits;
+};
+
+std::vector<TileId> traceRayTiles(
+	const std::vector<osg::ref_ptr<osg::Node>>& tileNodes,
+	const std::vector<std::pair<osg::Vec3d, osg::Vec3d>>& pixelRays,
+	const std::vector<NamedBoundingBox>& intersectingTiles,
+	const TileGrid* tileGrid) {
+	std::vector<TileId> rayTiles(pixelRays.size(), kInvalidTileId);
+	ClosestTileTracer tracer(tileNodes, intersectingTiles, tileGrid);
+
+	for (size_t i = 0; i < pixelRays.size(); ++i) {
+		int closestTile = tracer.trace(pixelRays[i]);
+		if (closestTile >= 0) {
+			rayTiles[i] = intersectingTiles[closestTile].id;
 		}
+	}
+	return rayTiles;
+}
+
+std::vector<TileId> traceRayTilesBatched(
+	const std::vector<osg::ref_ptr<osg::Node>>& tileNodes,
+	const std::vector<std::pair<osg::Vec3d, osg::Vec3d>>& pixelRays,
+	const std::vector<NamedBoundingBox>& intersectingTiles,
+	unsigned int numThreads) {
+	std::vector<TileId> rayTiles(pixelRays.size(), kInvalidTileId);
+	const TileBroadPhase broadPhase = buildTileBroadPhase(intersectingTiles);
+	if (numThreads == 0) numThreads = ThreadPool::shared().size();
+
+	// 每个线程每次领取一段连续射线，按 tile 分组后每个 tile 子树只遍历一次
+	const size_t chunkSize = 1024;
+	std::atomic<size_t> nextChunk(0);
+	auto worker = [&]() {
+		std::vector<std::vector<uint32_t>> tileRays(intersectingTiles.size());
+		std::vector<TileHit> hits;
+		std::vector<double> nearestRatio;
+		std::vector<osg::ref_ptr<osgUtil::LineSegmentIntersector>> intersectorPool;
+		osg::ref_ptr<osgUtil::IntersectorGroup> group = new osgUtil::IntersectorGroup();
+		osg::ref_ptr<osgUtil::IntersectionVisitor> visitor = new osgUtil::IntersectionVisitor(group.get());
+
+		for (size_t begin = nextChunk.fetch_add(chunkSize); begin < pixelRays.size(); begin = nextChunk.fetch_add(chunkSize)) {
+			const size_t end = std::min(pixelRays.size(), begin + chunkSize);
+			for (auto& rays : tileRays) rays.clear();
+			for (size_t i = begin; i < end; ++i) {
+				const auto& ray = pixelRays[i];
+				if (ray.first == ray.second) continue;
+				broadPhase.intersect(ray.first, ray.second - ray.first, 0.0f, 1.0f, hits);
+				for (const TileHit& hit : hits) {
+					tileRays[hit.tileId].push_back(static_cast<uint32_t>(i));
+				}
+			}
+			nearestRatio.assign(end - begin, std::numeric_limits<double>::max());
 
-		if (!closestTile.empty()) {
-			//std::cout << "Ray intersects with tile: " << closestTile << " at distance: " << closestDistance << std::endl;
-			tileHitCounts[closestTile]++;
+			for (size_t tile = 0; tile < intersectingTiles.size(); ++tile) {
+				const std::vector<uint32_t>& rays = tileRays[tile];
+				osg::Node* tileNode = tileNodes[intersectingTiles[tile].id].get();
+				if (rays.empty() || !tileNode) continue;
+
+				// 复用求交器对象，只更新线段端点
+				while (intersectorPool.size() < rays.size()) {
+					intersectorPool.push_back(new osgUtil::LineSegmentIntersector(osg::Vec3d(), osg::Vec3d(0.0, 0.0, 1.0)));
+				}
+				group->clear();
+				for (size_t k = 0; k < rays.size(); ++k) {
+					osgUtil::LineSegmentIntersector* intersector = intersectorPool[k].get();
+					intersector->setStart(pixelRays[rays[k]].first);
+					intersector->setEnd(pixelRays[rays[k]].second);
+					intersector->reset();
+					intersector->setIntersectionLimit(osgUtil::Intersector::LIMIT_NEAREST);
+					group->addIntersector(intersector);
+				}
+				visitor->reset();
+				tileNode->accept(*visitor);
+
+				for (size_t k = 0; k < rays.size(); ++k) {
+					osgUtil::LineSegmentIntersector* intersector = intersectorPool[k].get();
+					if (!intersector->containsIntersections()) continue;
+					double ratio = intersector->getFirstIntersection().ratio;
+					double& nearest = nearestRatio[rays[k] - begin];
+					if (ratio < nearest) {
+						nearest = ratio;
+						rayTiles[rays[k]] = intersectingTiles[tile].id;
+					}
+				}
+			}
+		}
+	};
+
+	TaskGroup tasks(ThreadPool::shared());
+	for (unsigned int i = 0; i < numThreads; ++i) {
+		tasks.run(worker);
+	}
+	tasks.wait();
+	return rayTiles;
+}
+
+std::vector<TileIntersectionResult> aggregateTileCoverage(
+	const std::vector<TileId>& rayTiles,
+	const std::vector<NamedBoundingBox>& intersectingTiles) {
+	// 存储每个 tile 被射线击中的数量，候选 tile 之外的命中不计入
+	std::unordered_map<TileId, int> tileHitCounts;
+	for (const auto& tile : intersectingTiles) {
+		tileHitCounts[tile.id] = 0;
+	}
+	for (TileId tileId : rayTiles) {
+		auto it = tileHitCounts.find(tileId);
+		if (it != tileHitCounts.end()) {
+			it->second++;
 		}
 	}
 
 	// 计算每个 tile 的射线占比
 	std::vector<TileIntersectionResult> results;
-	int totalRays = pixelRays.size();
-	for (const auto& entry : tileHitCounts) {
-		double percentage = (static_cast<double>(entry.second) / totalRays) * 100.0;
-		results.push_back({ entry.first, percentage });
+	double totalRays = static_cast<double>(rayTiles.size());
+	for (const auto& tile : intersectingTiles) {
+		double percentage = totalRays > 0 ? (tileHitCounts[tile.id] / totalRays) * 100.0 : 0.0;
+		results.push_back({ tile.id, percentage });
 	}
+	return results;
+}
 
-	std::cout << "Tile intersection results:" << std::endl;
-	for (const auto& result : results) {
-		std::cout << "Tile: " << result.tileName << " - " << result.percentage << "%" << std::endl;
+std::vector<TileIntersectionResult> performRayTileIntersections(
+	const std::vector<osg::ref_ptr<osg::Node>>& tileNodes,
+	const std::vector<std::pair<osg::Vec3d, osg::Vec3d>>& pixelRays,
+	const std::vector<NamedBoundingBox>& intersectingTiles,
+	const TileGrid* tileGrid) {
+	return aggregateTileCoverage(traceRayTiles(tileNodes, pixelRays, intersectingTiles, tileGrid), intersectingTiles);
+}
+
+std::vector<TileIntersectionResult> performThresholdRefinedIntersections(
+	const std::vector<osg::ref_ptr<osg::Node>>& tileNodes,
+	const Camera& camera,
+	const std::vector<NamedBoundingBox>& intersectingTiles,
+	const ThresholdRefinementOptions& options,
+	const TileGrid* tileGrid) {
+	const PhotoInfo& photoInfo = camera.getPhotoInfo();
+	const int coarseStep = options.coarseStep;
+	const int fineStep = options.fineStep;
+	const int numTiles = static_cast<int>(intersectingTiles.size());
+	ClosestTileTracer tracer(tileNodes, intersectingTiles, tileGrid);
+	auto pixelRay = [&](int x, int y) {
+		return options.rayLength > 0.0
+			? camera.calculatePixelRay(x, y, options.rayLength)
+			: camera.calculateClippedPixelRay(x, y, intersectingTiles);
+	};
+
+	// 第一遍：粗网格采样，记录每个采样点命中的 tile
+	const int coarseCols = (photoInfo.imageWidth + coarseStep - 1) / coarseStep;
+	const int coarseRows = (photoInfo.imageHeight + coarseStep - 1) / coarseStep;
+	std::vector<int> coarseLabels(coarseCols * coarseRows, -1);
+	std::vector<int> coarseCounts(numTiles, 0);
+	for (int row = 0; row < coarseRows; ++row) {
+		for (int col = 0; col < coarseCols; ++col) {
+			auto ray = pixelRay(col * coarseStep, row * coarseStep);
+			int label = tracer.trace(ray);
+			coarseLabels[row * coarseCols + col] = label;
+			if (label >= 0) coarseCounts[label]++;
+		}
 	}
 
+	// 用二项分布标准误估计不确定带，带外的 tile 直接定稿
+	const double coarseTotal = static_cast<double>(coarseLabels.size());
+	std::vector<double> percentages(numTiles, 0.0);
+	std::vector<bool> ambiguous(numTiles, false);
+	int numAmbiguous = 0;
+	for (int t = 0; t < numTiles; ++t) {
+		double p = coarseCounts[t] / coarseTotal;
+		double band = std::max(options.minBand, 2.0 * std::sqrt(p * (1.0 - p) / coarseTotal) * 100.0);
+		percentages[t] = p * 100.0;
+		if (std::fabs(percentages[t] - options.threshold) <= band) {
+			ambiguous[t] = true;
+			++numAmbiguous;
+		}
+	}
+
+	size_t tracedRays = coarseLabels.size();
+	if (numAmbiguous > 0) {
+		// 第二遍：只在可能含有待定 tile 的粗网格单元内按细步长追踪，其余细采样点沿用单元左上角的粗标签。
+		// 单元的角点标签涉及待定 tile，或单元与待定 tile 包围盒的投影矩形相交时需要细化；
+		// 后者覆盖完全落在单元内部、角点都没有采到的待定 tile
+		auto coarseLabelAt = [&](int col, int row) {
+			col = std::min(col, coarseCols - 1);
+			row = std::min(row, coarseRows - 1);
+			return coarseLabels[row * coarseCols + col];
+		};
+		auto isAmbiguous = [&](int label) { return label >= 0 && ambiguous[label]; };
+		std::vector<char> refineCell(coarseLabels.size(), 0);
+		for (int row = 0; row < coarseRows; ++row) {
+			for (int col = 0; col < coarseCols; ++col) {
+				refineCell[row * coarseCols + col] = isAmbiguous(coarseLabelAt(col, row)) || isAmbiguous(coarseLabelAt(col + 1, row))
+					|| isAmbiguous(coarseLabelAt(col, row + 1)) || isAmbiguous(coarseLabelAt(col + 1, row + 1));
+			}
+		}
+		const double fx = photoInfo.intrinsicMatrix[0][0], fy = photoInfo.intrinsicMatrix[1][1];
+		const double cx = photoInfo.intrinsicMatrix[0][2], cy = photoInfo.intrinsicMatrix[1][2];
+		for (int t = 0; t < numTiles; ++t) {
+			if (!ambiguous[t]) continue;
+			const osg::BoundingBox& bbox = intersectingTiles[t].bbox;
+			double minX = std::numeric_limits<double>::max(), minY = minX;
+			double maxX = -minX, maxY = -minX;
+			bool behind = false;
+			for (int corner = 0; corner < 8 && !behind; ++corner) {
+				osg::Vec3d p = camera.worldToCamera(osg::Vec3d(bbox.corner(corner)));
+				// 包围盒跨过相机平面时投影无界，整幅图像都需要细化
+				behind = p.z() <= 0.0;
+				if (behind) break;
+				minX = std::min(minX, fx * p.x() / p.z() + cx);
+				maxX = std::max(maxX, fx * p.x() / p.z() + cx);
+				minY = std::min(minY, fy * p.y() / p.z() + cy);
+				maxY = std::max(maxY, fy * p.y() / p.z() + cy);
+			}
+			if (behind) {
+				minX = minY = 0.0;
+				maxX = photoInfo.imageWidth;
+				maxY = photoInfo.imageHeight;
+			}
+			if (maxX < 0.0 || maxY < 0.0 || minX >= photoInfo.imageWidth || minY >= photoInfo.imageHeight) continue;
+			// 细采样点 (x, y) 属于单元 (x / coarseStep, y / coarseStep)
+			const int colBegin = static_cast<int>(std::max(0.0, minX)) / coarseStep;
+			const int colEnd = static_cast<int>(std::min<double>(photoInfo.imageWidth - 1, maxX)) / coarseStep;
+			const int rowBegin = static_cast<int>(std::max(0.0, minY)) / coarseStep;
+			const int rowEnd = static_cast<int>(std::min<double>(photoInfo.imageHeight - 1, maxY)) / coarseStep;
+			for (int row = rowBegin; row <= rowEnd; ++row) {
+				for (int col = colBegin; col <= colEnd; ++col) {
+					refineCell[row * coarseCols + col] = 1;
+				}
+			}
+		}
+
+		std::vector<int> fineCounts(numTiles, 0);
+		size_t fineTotal = 0;
+		for (int y = 0; y < photoInfo.imageHeight; y += fineStep) {
+			for (int x = 0; x < photoInfo.imageWidth; x += fineStep) {
+				int col = x / coarseStep;
+				int row = y / coarseStep;
+				int label = coarseLabelAt(col, row);
+				if (refineCell[row * coarseCols + col]) {
+					label = tracer.trace(pixelRay(x, y));
+					++tracedRays;
+				}
+				if (label >= 0) fineCounts[label]++;
+				++fineTotal;
+			}
+		}
+		for (int t = 0; t < numTiles; ++t) {
+			if (ambiguous[t]) {
+				percentages[t] = (static_cast<double>(fineCounts[t]) / fineTotal) * 100.0;
+			}
+		}
+	}
+
+	std::vector<TileIntersectionResult> results;
+	for (int t = 0; t < numTiles; ++t) {
+		results.push_back({ intersectingTiles[t].id, percentages[t] });
+	}
+
+	std::cout << "Threshold refinement: " << numAmbiguous << "/" << numTiles << " tiles refined, "
+		<< tracedRays << " rays traced for photo: " << photoInfo.imagePath << std::endl;
+
 	return results;
 }
 
-void outputIntersectionResultsToCSV(const std::string& filename, const std::vector<PhotoData>& allPhotoData, const std::vector<std::string>& tileNames) {
+void outputIntersectionResultsToCSV(const std::string& filename, const std::vector<PhotoData>& allPhotoData, const TileRegistry& registry) {
 	std::ofstream outFile(filename);
 	if (!outFile.is_open()) {
 		std::cerr << "无法打开文件：" << filename << std::endl;
@@ -129,23 +435,23 @@ void outputIntersectionResultsToCSV(const std::string& filename, const std::vect
 	}
 
 	outFile << "Photo Index, Image Path";
-	for (const auto& tileName : tileNames) {
+	for (const auto& tileName : registry.getTileNames()) {
 		outFile << "," << tileName;
 	}
 	outFile << std::endl;
 
+	std::vector<double> tilePercentages(registry.size());
 	for (const auto& photoData : allPhotoData) {
 		outFile << photoData.index << "," << photoData.imagePath;
-		std::map<std::string, double> tilePercentages;
+		std::fill(tilePercentages.begin(), tilePercentages.end(), 0.0);  // Default to 0 if not found
 		for (const auto& result : photoData.intersectionResults) {
-			tilePercentages[result.tileName] = result.percentage;
+			tilePercentages[result.tileId] = result.percentage;
 		}
-		for (const auto& tileName : tileNames) {
-			double percentage = tilePercentages[tileName];  // Default to 0 if not found
+		for (double percentage : tilePercentages) {
 			outFile << "," << std::fixed << std::setprecision(5) << percentage;
 		}
 		outFile << std::endl;
 	}
 
 	outFile.close();
-}
\ No newline at end of file
+}
@@ -0,0 +1,144 @@
+#include "TileLoader.h"
+#include "AsyncFileReader.h"
+#include <osgDB/ReadFile>
+#include <osgDB/Registry>
+#include <osgDB/FileNameUtils>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <istream>
+#include <mutex>
+#include <streambuf>
+#include <thread>
+#include <algorithm>
+#include <exception>
+
+// 不复制数据地把内存缓冲区包装成输入流
+class MemoryStreamBuffer : public std::streambuf {
+public:
+	MemoryStreamBuffer(const char* data, size_t size) {
+		char* begin = const_cast<char*>(data);
+		setg(begin, begin, begin + size);
+	}
+};
+
+// 从内存解析；mtl 与纹理按文件所在目录查找。没有支持流读取的插件时退回按路径读取
+static osg::ref_ptr<osg::Node> parseTileFile(const std::string& path, const std::string& data) {
+	osgDB::ReaderWriter* readerWriter = osgDB::Registry::instance()->getReaderWriterForExtension(osgDB::getLowerCaseFileExtension(path));
+	if (!readerWriter) return osgDB::readNodeFile(path);
+	osg::ref_ptr<osgDB::Options> readOptions = new osgDB::Options();
+	readOptions->setDatabasePath(osgDB::getFilePath(path));
+	MemoryStreamBuffer buffer(data.data(), data.size());
+	std::istream stream(&buffer);
+	osgDB::ReaderWriter::ReadResult result = readerWriter->readNode(stream, readOptions.get());
+	if (!result.validNode()) return nullptr;
+	return result.getNode();
+}
+
+TileLoader::TileLoader(const TileLoadOptions& options) : options(options) {}
+
+TileLoadStats TileLoader::load(const std::vector<std::string>& files,
+	const std::function<void(size_t, osg::ref_ptr<osg::Node>)>& onParsed) const {
+	typedef FileReadResult ReadBuffer;
+
+	auto startTime = std::chrono::steady_clock::now();
+	std::unique_ptr<AsyncFileReader> fileReader = createAsyncFileReader(options.ioBackend, options.ioThreads, options.queueDepth);
+	const unsigned int parseThreads = options.parseThreads > 0 ? options.parseThreads : std::max(1u, std::thread::hardware_concurrency());
+
+	std::atomic<size_t> parsedFiles(0), failedFiles(0);
+	std::atomic<uint64_t> bytesRead(0);
+	std::deque<ReadBuffer> ready;
+	size_t bufferedBytes = 0;
+	bool readingDone = false;
+	double readSeconds = 0.0;
+	std::mutex mutex;
+	std::condition_variable readyCondition, spaceCondition;
+	std::mutex progressMutex;
+	size_t reportedStep = 0;
+	std::exception_ptr error;
+
+	auto reader = [&]() {
+		try {
+			fileReader->readFiles(files, [&](ReadBuffer&& buffer) {
+				const size_t size = buffer.data.size();
+				bytesRead += size;
+				std::unique_lock<std::mutex> lock(mutex);
+				// 缓冲已满时等待解析线程消费，避免读取远远跑在解析前面
+				spaceCondition.wait(lock, [&]() { return bufferedBytes == 0 || bufferedBytes + size <= options.maxBufferedBytes; });
+				bufferedBytes += size;
+				ready.push_back(std::move(buffer));
+				readyCondition.notify_one();
+				});
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock(progressMutex);
+			if (!error) error = std::current_exception();
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		readSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+		readingDone = true;
+		readyCondition.notify_all();
+	};
+
+	auto parser = [&]() {
+		for (;;) {
+			ReadBuffer buffer;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				readyCondition.wait(lock, [&]() { return !ready.empty() || readingDone; });
+				if (ready.empty()) return;
+				buffer = std::move(ready.front());
+				ready.pop_front();
+			}
+			osg::ref_ptr<osg::Node> node;
+			if (buffer.ok) node = parseTileFile(files[buffer.index], buffer.data);
+			if (!node) {
+				++failedFiles;
+				std::cerr << "Failed to load tile file: " << files[buffer.index] << std::endl;
+			}
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				bufferedBytes -= buffer.data.size();
+			}
+			spaceCondition.notify_all();
+			buffer.data = std::string();
+			// 回调异常不能让解析线程退出，否则读取线程会一直等待缓冲空间
+			try {
+				onParsed(buffer.index, node);
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lock(progressMutex);
+				if (!error) error = std::current_exception();
+			}
+
+			// 每完成 5% 输出一次进度
+			size_t done = ++parsedFiles;
+			size_t step = done * 20 / files.size();
+			std::lock_guard<std::mutex> lock(progressMutex);
+			if (step > reportedStep) {
+				reportedStep = step;
+				double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+				double megabytes = bytesRead.load() / (1024.0 * 1024.0);
+				std::cout << "Loaded " << done << "/" << files.size() << " tile files (" << step * 5 << "%), "
+					<< megabytes << " MB read, " << (seconds > 0.0 ? megabytes / seconds : 0.0) << " MB/s" << std::endl;
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	threads.emplace_back(reader);
+	for (unsigned int i = 0; i < parseThreads; ++i) threads.emplace_back(parser);
+	for (auto& thread : threads) thread.join();
+	if (error) std::rethrow_exception(error);
+
+	TileLoadStats stats;
+	stats.files = files.size();
+	stats.failed = failedFiles;
+	stats.bytesRead = bytesRead;
+	stats.readSeconds = readSeconds;
+	stats.backend = fileReader->name();
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	return stats;
+}
@@ -0,0 +1,76 @@
+#include "TileMesh.h"
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/NodeVisitor>
+#include <osg/TriangleIndexFunctor>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+// 把 TriangleIndexFunctor 回调的局部索引加上当前 Geometry 的顶点偏移
+struct TriangleIndexCollector {
+	std::vector<uint32_t>* indices = nullptr;
+	uint32_t baseVertex = 0;
+
+	void operator()(unsigned int p1, unsigned int p2, unsigned int p3) {
+		if (p1 == p2 || p2 == p3 || p1 == p3) return; // 退化三角形
+		indices->push_back(baseVertex + p1);
+		indices->push_back(baseVertex + p2);
+		indices->push_back(baseVertex + p3);
+	}
+};
+
+class TileMeshCollector : public osg::NodeVisitor {
+public:
+	explicit TileMeshCollector(TileMesh& mesh)
+		: osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN), mesh(mesh) {}
+
+	virtual void apply(osg::Geode& geode) {
+		for (unsigned int i = 0; i < geode.getNumDrawables(); ++i) {
+			osg::Geometry* geometry = geode.getDrawable(i)->asGeometry();
+			if (!geometry) continue;
+			osg::Vec3Array* vertices = dynamic_cast<osg::Vec3Array*>(geometry->getVertexArray());
+			if (!vertices || vertices->empty()) continue;
+
+			osg::TriangleIndexFunctor<TriangleIndexCollector> collector;
+			collector.indices = &mesh.indices;
+			collector.baseVertex = static_cast<uint32_t>(mesh.vertices.size());
+			geometry->accept(collector);
+
+			for (const osg::Vec3& vertex : *vertices) {
+				mesh.vertices.push_back(vertex);
+				mesh.bbox.expandBy(vertex);
+			}
+		}
+	}
+
+private:
+	TileMesh& mesh;
+};
+
+TileMesh extractTileMesh(osg::Node* tileNode) {
+	TileMesh mesh;
+	if (tileNode) {
+		TileMeshCollector collector(mesh);
+		tileNode->accept(collector);
+	}
+	return mesh;
+}
+
+std::vector<TileMesh> extractTileMeshes(const std::vector<osg::ref_ptr<osg::Node>>& tileNodes) {
+	std::vector<TileMesh> meshes(tileNodes.size());
+	std::atomic<size_t> next(0);
+	unsigned int numThreads = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<std::thread> threads;
+	for (unsigned int i = 0; i < numThreads; ++i) {
+		threads.emplace_back([&]() {
+			for (size_t t = next++; t < tileNodes.size(); t = next++) {
+				meshes[t] = extractTileMesh(tileNodes[t].get());
+			}
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	return meshes;
+}
@@ -0,0 +1,343 @@
+#include "TileRasterizer.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include "ThreadPool.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// bin 的大小（采样点），宽度须为 8 的倍数以便 SIMD 每次处理一行中的 8 个采样点
+static const int kBinWidth = 64;
+static const int kBinHeight = 32;
+// 每个任务处理的三角形数
+static const size_t kChunkSize = 4096;
+// 相机坐标系下的近裁剪面
+static const double kNearPlane = 1e-3;
+
+namespace {
+
+// 投影到采样点坐标系后的三角形，边函数为 w = a * col + b * row + c
+struct SetupTriangle {
+	float a[3], b[3], c[3];
+	float inverseDepth[3];      // 已除以三角形面积，插值时直接与边函数相乘
+	int minCol, maxCol, minRow, maxRow;
+	TileId tileId;
+};
+
+// 一段连续的三角形及其建立结果，按任务顺序合并保证结果与线程调度无关
+struct TriangleChunk {
+	size_t tile;                // intersectingTiles 中的下标
+	size_t begin, end;          // 三角形下标区间
+	std::vector<SetupTriangle> triangles;
+	std::vector<std::pair<uint32_t, uint32_t>> binEntries; // (bin, 三角形在 triangles 中的下标)
+};
+
+struct ProjectedVertex {
+	double x, y, z;             // 相机坐标
+};
+
+// 相机坐标到采样点坐标的投影
+struct SampleProjection {
+	double matrix[3][3];
+	osg::Vec3d center;
+	double fx, fy, cx, cy, invStep;
+
+	ProjectedVertex toCamera(const osg::Vec3f& v) const {
+		double dx = v.x() - center.x(), dy = v.y() - center.y(), dz = v.z() - center.z();
+		return {
+			matrix[0][0] * dx + matrix[0][1] * dy + matrix[0][2] * dz,
+			matrix[1][0] * dx + matrix[1][1] * dy + matrix[1][2] * dz,
+			matrix[2][0] * dx + matrix[2][1] * dy + matrix[2][2] * dz };
+	}
+};
+
+} // namespace
+
+static SampleProjection makeProjection(const Camera& camera, int step) {
+	SampleProjection projection;
+	projection.center = camera.getCameraCenter();
+	// worldToCamera 是仿射变换，对坐标轴方向的增量即旋转矩阵的列
+	osg::Vec3d origin = camera.worldToCamera(projection.center);
+	for (int axis = 0; axis < 3; ++axis) {
+		osg::Vec3d unit;
+		unit[axis] = 1.0;
+		osg::Vec3d column = camera.worldToCamera(projection.center + unit) - origin;
+		for (int row = 0; row < 3; ++row) {
+			projection.matrix[row][axis] = column[row];
+		}
+	}
+	const PhotoInfo& photoInfo = camera.getPhotoInfo();
+	projection.fx = photoInfo.intrinsicMatrix[0][0];
+	projection.fy = photoInfo.intrinsicMatrix[1][1];
+	projection.cx = photoInfo.intrinsicMatrix[0][2];
+	projection.cy = photoInfo.intrinsicMatrix[1][2];
+	projection.invStep = 1.0 / step;
+	return projection;
+}
+
+// 建立一个位于近裁剪面之前的三角形，完全落在采样范围之外或退化时返回 false
+static bool setupTriangle(const SampleProjection& projection, const ProjectedVertex v[3], TileId tileId,
+	int cols, int rows, SetupTriangle& triangle) {
+	double sx[3], sy[3], iz[3];
+	for (int i = 0; i < 3; ++i) {
+		iz[i] = 1.0 / v[i].z;
+		sx[i] = (projection.fx * v[i].x * iz[i] + projection.cx) * projection.invStep;
+		sy[i] = (projection.fy * v[i].y * iz[i] + projection.cy) * projection.invStep;
+	}
+	double area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sy[1] - sy[0]) * (sx[2] - sx[0]);
+	if (std::fabs(area) < 1e-12) return false;
+	// 不剔除背面，与线段求交一致；统一为正向环绕
+	if (area < 0.0) {
+		std::swap(sx[1], sx[2]);
+		std::swap(sy[1], sy[2]);
+		std::swap(iz[1], iz[2]);
+		area = -area;
+	}
+
+	double minX = std::min({ sx[0], sx[1], sx[2] }), maxX = std::max({ sx[0], sx[1], sx[2] });
+	double minY = std::min({ sy[0], sy[1], sy[2] }), maxY = std::max({ sy[0], sy[1], sy[2] });
+	if (maxX < 0.0 || maxY < 0.0 || minX > cols - 1 || minY > rows - 1) return false;
+	triangle.minCol = std::max(0, static_cast<int>(std::ceil(minX)));
+	triangle.maxCol = std::min(cols - 1, static_cast<int>(std::floor(maxX)));
+	triangle.minRow = std::max(0, static_cast<int>(std::ceil(minY)));
+	triangle.maxRow = std::min(rows - 1, static_cast<int>(std::floor(maxY)));
+	if (triangle.minCol > triangle.maxCol || triangle.minRow > triangle.maxRow) return false;
+
+	// 边 i 与顶点 i 相对，w_i / area 即顶点 i 的重心坐标
+	for (int i = 0; i < 3; ++i) {
+		int j = (i + 1) % 3, k = (i + 2) % 3;
+		triangle.a[i] = static_cast<float>(sy[j] - sy[k]);
+		triangle.b[i] = static_cast<float>(sx[k] - sx[j]);
+		triangle.c[i] = static_cast<float>(sx[j] * sy[k] - sx[k] * sy[j]);
+		triangle.inverseDepth[i] = static_cast<float>(iz[i] / area);
+	}
+	triangle.tileId = tileId;
+	return true;
+}
+
+// 三角形与近裁剪面求交后可能变为四边形，拆成两个三角形
+static int clipToNearPlane(const ProjectedVertex in[3], ProjectedVertex out[6]) {
+	ProjectedVertex polygon[4];
+	int count = 0;
+	for (int i = 0; i < 3; ++i) {
+		const ProjectedVertex& p = in[i];
+		const ProjectedVertex& q = in[(i + 1) % 3];
+		bool pInside = p.z >= kNearPlane, qInside = q.z >= kNearPlane;
+		if (pInside) polygon[count++] = p;
+		if (pInside != qInside) {
+			double t = (kNearPlane - p.z) / (q.z - p.z);
+			polygon[count++] = { p.x + (q.x - p.x) * t, p.y + (q.y - p.y) * t, kNearPlane };
+		}
+	}
+	if (count < 3) return 0;
+	out[0] = polygon[0]; out[1] = polygon[1]; out[2] = polygon[2];
+	if (count == 3) return 1;
+	out[3] = polygon[0]; out[4] = polygon[2]; out[5] = polygon[3];
+	return 2;
+}
+
+static void setupChunk(const SampleProjection& projection, const TileMesh& mesh, TileId tileId,
+	int cols, int rows, int binCols, TriangleChunk& chunk) {
+	for (size_t t = chunk.begin; t < chunk.end; ++t) {
+		ProjectedVertex v[3];
+		for (int i = 0; i < 3; ++i) {
+			v[i] = projection.toCamera(mesh.vertices[mesh.indices[t * 3 + i]]);
+		}
+		ProjectedVertex clipped[6];
+		int numTriangles = 1;
+		const ProjectedVertex* source = v;
+		if (v[0].z < kNearPlane || v[1].z < kNearPlane || v[2].z < kNearPlane) {
+			numTriangles = clipToNearPlane(v, clipped);
+			source = clipped;
+		}
+		for (int k = 0; k < numTriangles; ++k) {
+			SetupTriangle triangle;
+			if (!setupTriangle(projection, source + k * 3, tileId, cols, rows, triangle)) continue;
+			uint32_t index = static_cast<uint32_t>(chunk.triangles.size());
+			chunk.triangles.push_back(triangle);
+			for (int binRow = triangle.minRow / kBinHeight; binRow <= triangle.maxRow / kBinHeight; ++binRow) {
+				for (int binCol = triangle.minCol / kBinWidth; binCol <= triangle.maxCol / kBinWidth; ++binCol) {
+					chunk.binEntries.emplace_back(static_cast<uint32_t>(binRow * binCols + binCol), index);
+				}
+			}
+		}
+	}
+}
+
+// 在 bin 的矩形 [col0, col1] x [row0, row1] 内光栅化一个三角形，深度测试取更近者
+static void rasterizeInBin(const SetupTriangle& triangle, int col0, int col1, int row0, int row1, TileIdBuffer& buffer) {
+	int minCol = std::max(col0, triangle.minCol), maxCol = std::min(col1, triangle.maxCol);
+	int minRow = std::max(row0, triangle.minRow), maxRow = std::min(row1, triangle.maxRow);
+	if (minCol > maxCol || minRow > maxRow) return;
+
+#if defined(__AVX2__)
+	const __m256 a0 = _mm256_set1_ps(triangle.a[0]), a1 = _mm256_set1_ps(triangle.a[1]), a2 = _mm256_set1_ps(triangle.a[2]);
+	const __m256 z0 = _mm256_set1_ps(triangle.inverseDepth[0]);
+	const __m256 z1 = _mm256_set1_ps(triangle.inverseDepth[1]);
+	const __m256 z2 = _mm256_set1_ps(triangle.inverseDepth[2]);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256 tileId = _mm256_castsi256_ps(_mm256_set1_epi32(static_cast<int>(triangle.tileId)));
+	// bin 的左边界是 8 的倍数，向下对齐后仍在同一个 bin 内
+	const int alignedMinCol = minCol & ~7;
+	for (int row = minRow; row <= maxRow; ++row) {
+		const float fRow = static_cast<float>(row);
+		const __m256 r0 = _mm256_set1_ps(triangle.b[0] * fRow + triangle.c[0]);
+		const __m256 r1 = _mm256_set1_ps(triangle.b[1] * fRow + triangle.c[1]);
+		const __m256 r2 = _mm256_set1_ps(triangle.b[2] * fRow + triangle.c[2]);
+		float* depthRow = &buffer.inverseDepth[static_cast<size_t>(row) * buffer.stride];
+		TileId* idRow = &buffer.ids[static_cast<size_t>(row) * buffer.stride];
+		for (int col = alignedMinCol; col <= maxCol; col += 8) {
+			__m256i colIndex = _mm256_add_epi32(_mm256_set1_epi32(col), lanes);
+			__m256 px = _mm256_cvtepi32_ps(colIndex);
+			__m256 w0 = _mm256_add_ps(_mm256_mul_ps(a0, px), r0);
+			__m256 w1 = _mm256_add_ps(_mm256_mul_ps(a1, px), r1);
+			__m256 w2 = _mm256_add_ps(_mm256_mul_ps(a2, px), r2);
+			__m256 inside = _mm256_and_ps(_mm256_cmp_ps(w0, zero, _CMP_GE_OQ),
+				_mm256_and_ps(_mm256_cmp_ps(w1, zero, _CMP_GE_OQ), _mm256_cmp_ps(w2, zero, _CMP_GE_OQ)));
+			__m256i inRange = _mm256_and_si256(
+				_mm256_cmpgt_epi32(colIndex, _mm256_set1_epi32(minCol - 1)),
+				_mm256_cmpgt_epi32(_mm256_set1_epi32(maxCol + 1), colIndex));
+			inside = _mm256_and_ps(inside, _mm256_castsi256_ps(inRange));
+			if (_mm256_movemask_ps(inside) == 0) continue;
+
+			__m256 depth = _mm256_add_ps(_mm256_mul_ps(w0, z0), _mm256_add_ps(_mm256_mul_ps(w1, z1), _mm256_mul_ps(w2, z2)));
+			__m256 stored = _mm256_loadu_ps(depthRow + col);
+			__m256 closer = _mm256_and_ps(inside, _mm256_cmp_ps(depth, stored, _CMP_GT_OQ));
+			if (_mm256_movemask_ps(closer) == 0) continue;
+			_mm256_storeu_ps(depthRow + col, _mm256_blendv_ps(stored, depth, closer));
+			__m256 ids = _mm256_loadu_ps(reinterpret_cast<const float*>(idRow + col));
+			_mm256_storeu_ps(reinterpret_cast<float*>(idRow + col), _mm256_blendv_ps(ids, tileId, closer));
+		}
+	}
+#else
+	for (int row = minRow; row <= maxRow; ++row) {
+		const float fRow = static_cast<float>(row);
+		const float r0 = triangle.b[0] * fRow + triangle.c[0];
+		const float r1 = triangle.b[1] * fRow + triangle.c[1];
+		const float r2 = triangle.b[2] * fRow + triangle.c[2];
+		float* depthRow = &buffer.inverseDepth[static_cast<size_t>(row) * buffer.stride];
+		TileId* idRow = &buffer.ids[static_cast<size_t>(row) * buffer.stride];
+		for (int col = minCol; col <= maxCol; ++col) {
+			const float px = static_cast<float>(col);
+			float w0 = triangle.a[0] * px + r0;
+			float w1 = triangle.a[1] * px + r1;
+			float w2 = triangle.a[2] * px + r2;
+			if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) continue;
+			float depth = w0 * triangle.inverseDepth[0] + w1 * triangle.inverseDepth[1] + w2 * triangle.inverseDepth[2];
+			if (depth > depthRow[col]) {
+				depthRow[col] = depth;
+				idRow[col] = triangle.tileId;
+			}
+		}
+	}
+#endif
+}
+
+TileRasterizer::TileRasterizer(const std::vector<TileMesh>& meshes, unsigned int numThreads)
+	: meshes(meshes), numThreads(numThreads > 0 ? numThreads : ThreadPool::shared().size()) {}
+
+void TileRasterizer::rasterize(const Camera& camera, const std::vector<NamedBoundingBox>& intersectingTiles, int step,
+	TileIdBuffer& buffer) const {
+	const PhotoInfo& photoInfo = camera.getPhotoInfo();
+	buffer.step = step;
+	buffer.cols = (photoInfo.imageWidth + step - 1) / step;
+	buffer.rows = (photoInfo.imageHeight + step - 1) / step;
+	buffer.stride = (buffer.cols + 7) & ~7;
+	buffer.ids.assign(static_cast<size_t>(buffer.stride) * buffer.rows, kInvalidTileId);
+	buffer.inverseDepth.assign(static_cast<size_t>(buffer.stride) * buffer.rows, 0.0f);
+
+	const int binCols = (buffer.cols + kBinWidth - 1) / kBinWidth;
+	const int binRows = (buffer.rows + kBinHeight - 1) / kBinHeight;
+	const SampleProjection projection = makeProjection(camera, step);
+
+	// 第一阶段：按三角形分段并行投影、裁剪并分配到 bin
+	std::vector<TriangleChunk> chunks;
+	for (size_t k = 0; k < intersectingTiles.size(); ++k) {
+		const TileMesh& mesh = meshes[intersectingTiles[k].id];
+		for (size_t begin = 0; begin < mesh.numTriangles(); begin += kChunkSize) {
+			TriangleChunk chunk;
+			chunk.tile = k;
+			chunk.begin = begin;
+			chunk.end = std::min(mesh.numTriangles(), begin + kChunkSize);
+			chunks.push_back(std::move(chunk));
+		}
+	}
+	std::atomic<size_t> nextChunk(0);
+	auto setupWorker = [&]() {
+		for (size_t c = nextChunk++; c < chunks.size(); c = nextChunk++) {
+			TileId tileId = intersectingTiles[chunks[c].tile].id;
+			setupChunk(projection, meshes[tileId], tileId, buffer.cols, buffer.rows, binCols, chunks[c]);
+		}
+	};
+
+	// 照片本身已是共享线程池中的任务，两个阶段都在同一线程池中展开，不另开线程
+	{
+		TaskGroup tasks(ThreadPool::shared());
+		for (unsigned int i = 0; i < numThreads; ++i) {
+			tasks.run(setupWorker);
+		}
+		tasks.wait();
+	}
+
+	// 按任务顺序做计数排序，得到每个 bin 的三角形列表
+	const size_t numBins = static_cast<size_t>(binCols) * binRows;
+	std::vector<uint32_t> binOffsets(numBins + 1, 0);
+	for (const TriangleChunk& chunk : chunks) {
+		for (const auto& entry : chunk.binEntries) {
+			binOffsets[entry.first + 1]++;
+		}
+	}
+	for (size_t b = 0; b < numBins; ++b) {
+		binOffsets[b + 1] += binOffsets[b];
+	}
+	std::vector<const SetupTriangle*> binTriangles(binOffsets[numBins]);
+	std::vector<uint32_t> binFill(binOffsets.begin(), binOffsets.end() - 1);
+	for (const TriangleChunk& chunk : chunks) {
+		for (const auto& entry : chunk.binEntries) {
+			binTriangles[binFill[entry.first]++] = &chunk.triangles[entry.second];
+		}
+	}
+
+	// 第二阶段：各线程独占不同的 bin 做光栅化
+	std::atomic<size_t> nextBin(0);
+	auto rasterWorker = [&]() {
+		for (size_t b = nextBin++; b < numBins; b = nextBin++) {
+			int col0 = static_cast<int>(b % binCols) * kBinWidth;
+			int row0 = static_cast<int>(b / binCols) * kBinHeight;
+			int col1 = std::min(buffer.cols, col0 + kBinWidth) - 1;
+			int row1 = std::min(buffer.rows, row0 + kBinHeight) - 1;
+			for (uint32_t i = binOffsets[b]; i < binOffsets[b + 1]; ++i) {
+				rasterizeInBin(*binTriangles[i], col0, col1, row0, row1, buffer);
+			}
+		}
+	};
+	TaskGroup tasks(ThreadPool::shared());
+	for (unsigned int i = 0; i < numThreads; ++i) {
+		tasks.run(rasterWorker);
+	}
+	tasks.wait();
+}
+
+std::vector<TileIntersectionResult> TileRasterizer::computeCoverage(const Camera& camera,
+	const std::vector<NamedBoundingBox>& intersectingTiles, int step) const {
+	TileIdBuffer buffer;
+	rasterize(camera, intersectingTiles, step, buffer);
+
+	// TileId 缓冲的直方图
+	std::vector<int> tileHitCounts(meshes.size(), 0);
+	for (int row = 0; row < buffer.rows; ++row) {
+		for (int col = 0; col < buffer.cols; ++col) {
+			TileId id = buffer.at(col, row);
+			if (id != kInvalidTileId) tileHitCounts[id]++;
+		}
+	}
+
+	std::vector<TileIntersectionResult> results;
+	const double totalSamples = static_cast<double>(buffer.cols) * buffer.rows;
+	for (const NamedBoundingBox& tile : intersectingTiles) {
+		results.push_back({ tile.id, tileHitCounts[tile.id] / totalSamples * 100.0 });
+	}
+	return results;
+}
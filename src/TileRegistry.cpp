@@ -0,0 +1,17 @@
+#include "TileRegistry.h"
+
+TileId TileRegistry::registerTile(const std::string& name) {
+	auto it = ids.find(name);
+	if (it != ids.end()) {
+		return it->second;
+	}
+	TileId id = static_cast<TileId>(names.size());
+	names.push_back(name);
+	ids.emplace(name, id);
+	return id;
+}
+
+TileId TileRegistry::findTile(const std::string& name) const {
+	auto it = ids.find(name);
+	return it == ids.end() ? kInvalidTileId : it->second;
+}
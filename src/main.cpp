@@ -14,8 +14,30 @@
 #include "Camera.h"
 #include "RayIntersection.h"
 #include "TileIntersectionCalculator.h"
+#include "PipelineConfig.h"
+#include "ResultWriter.h"
+#include "TileAssignment.h"
+#include "CoverageEngine.h"
+#include "EngineBenchmark.h"
+#include "ModelMetadata.h"
+#include "OutOfCorePlanner.h"
+#include "ProcessMemory.h"
+#include "ShardPlanner.h"
+#include "TileCache.h"
+#include "CheckpointLog.h"
+#include "IncrementalState.h"
+#include "RayLabelStore.h"
+#include "PoseDelta.h"
+#include "ResultCache.h"
+#include "ThreadPool.h"
+#include <functional>
+#include <cmath>
 #include <unordered_set>
+#include <unordered_map>
 #include <fstream>
+#include <memory>
+#include <algorithm>
+#include <sstream>
 
 std::unordered_set<int> loadPhotoIndices(const std::string& filePath)
 {
@@ -37,58 +59,155 @@ std::unordered_set<int> loadPhotoIndices(const std::string& filePath)
 	return indices;
 }
 
-// 输出交集结果到CSV文件
-static std::vector<std::string> extractTileNames(const std::vector<NamedBoundingBox>& tileBoundingBoxes)
+// 按配置把照片分配到 tile 目录
+static void runTileAssignment(const PipelineConfig& config, const std::vector<PhotoData>& photos, const std::vector<std::string>& tileNames)
 {
-	std::vector<std::string> tileNames;
-	for (const NamedBoundingBox& box : tileBoundingBoxes)
+	TileAssignmentOptions options;
+	options.outputFolder = config.assignFolder;
+	options.threshold = config.assignmentThreshold;
+	options.linkMode = parseLinkMode(config.linkMode);
+	options.numThreads = config.assignThreads > 0 ? config.assignThreads : 0;
+	assignPhotosToTiles(photos, tileNames, options);
+}
+
+// 逐射线对比引擎与参考引擎，输出射线标签不一致率和 tile 占比的最大偏差
+static void printEngineReport(const std::string& imagePath, const char* engineName, const std::vector<TileId>& engineRayTiles,
+                              const std::vector<TileId>& exactRayTiles,
+                              const std::vector<TileIntersectionResult>& engineResults,
+                              const std::vector<TileIntersectionResult>& exactResults,
+                              const TileRegistry& registry)
+{
+	size_t mismatches = 0;
+	for (size_t i = 0; i < engineRayTiles.size() && i < exactRayTiles.size(); ++i)
+	{
+		if (engineRayTiles[i] != exactRayTiles[i]) ++mismatches;
+	}
+	double maxError = 0.0;
+	TileId maxErrorTile = kInvalidTileId;
+	for (size_t i = 0; i < engineResults.size() && i < exactResults.size(); ++i)
+	{
+		double error = std::fabs(engineResults[i].percentage - exactResults[i].percentage);
+		if (error > maxError)
+		{
+			maxError = error;
+			maxErrorTile = engineResults[i].tileId;
+		}
+	}
+	std::cout << "Engine report (" << engineName << ") for " << imagePath << ": " << mismatches << "/" << exactRayTiles.size() << " rays mismatched ("
+		<< (exactRayTiles.empty() ? 0.0 : 100.0 * mismatches / exactRayTiles.size()) << "%), max coverage error "
+		<< maxError << "%";
+	if (maxErrorTile != kInvalidTileId)
 	{
-		tileNames.push_back(box.name);
+		std::cout << " on " << registry.getTileName(maxErrorTile);
 	}
-	return tileNames;
+	std::cout << std::endl;
 }
 
 // 设置全局互斥锁
 std::mutex allIntersectionResultsMutex;
 
 // 处理单张照片，生成包含射线和相机中心球体的场景
-static osg::ref_ptr<osg::Group> processPhoto(const PhotoInfo& photoInfo, int photoIndex, osg::ref_ptr<osg::Group> scene,
-                                             double heightThreshold,
+static osg::ref_ptr<osg::Group> processPhoto(const PhotoInfo& photoInfo, int photoIndex, const SceneBuilder& builder,
+                                             double heightThreshold, const osg::BoundingBox& sceneBounds,
                                              const std::vector<NamedBoundingBox>& tileBoundingBoxes,
+                                             const PipelineConfig& config,
+                                             const CoverageEngine& engine,
+                                             const CoverageEngine* referenceEngine,
+                                             SparseResultWriter* resultWriter,
+                                             CheckpointLog* checkpoint,
+                                             const PoseDeltaTracer* poseDelta,
+                                             RayLabelWriter* rayLabelWriter,
+                                             ResultCache* resultCache,
                                              std::vector<PhotoData>& allPhotoData)
 {
 	osg::ref_ptr<osg::Group> localScene = new osg::Group();
 
 	Camera camera(photoInfo);
 
-	// 判断照片高度~如果高于阈值，则不处理,-camera.getCameraCenter().y()代表相机中心的高度值
-	if (-camera.getCameraCenter().y() > (heightThreshold + 30))
+	// 判断照片高度~如果高于阈值，则不处理
+	if (isPhotoAboveScene(camera, heightThreshold))
 	{
 		return localScene;
 	}
-	// 创建视椎体
-	osg::ref_ptr<osg::MatrixTransform> frustumTransform = camera.createFrustumGeometry(heightThreshold);
-	localScene->addChild(frustumTransform);
+	// 创建视椎体，计算与视锥体相交的 tile 和射线
+	PhotoRaySetup setup = setupPhotoRays(camera, sceneBounds, tileBoundingBoxes, config);
+	localScene->addChild(setup.frustumTransform);
 	// 可视化视锥体边界框
-	osg::BoundingBox frustumBBox = camera.calculateFrustumBoundingBox(frustumTransform);
-	osg::ref_ptr<osg::Geode> frustumBBoxGeode = camera.createBoundingBoxDrawable(frustumBBox);
+	osg::ref_ptr<osg::Geode> frustumBBoxGeode = camera.createBoundingBoxDrawable(setup.frustumBBox);
 	localScene->addChild(frustumBBoxGeode);
-	// 计算与视锥体相交的边界框
-	std::vector<NamedBoundingBox> intersectingTiles = camera.calculateIntersectingTiles(frustumBBox, tileBoundingBoxes);
-	// 计算射线
-	std::vector<std::pair<osg::Vec3d, osg::Vec3d>> pixelRays = camera.calculatePartialPixelRays(128, 5.0);
+	const std::vector<NamedBoundingBox>& intersectingTiles = setup.intersectingTiles;
+	const TileRegistry& registry = builder.getTileRegistry();
+	for (const NamedBoundingBox& tile : intersectingTiles)
+	{
+		std::cout << "Intersected Tile: " << registry.getTileName(tile.id) << std::endl;  // 输出相交的瓦片名称
+	}
+	const std::vector<std::pair<osg::Vec3d, osg::Vec3d>>& pixelRays = setup.rays;
 	std::cout << "Calculated " << pixelRays.size() << " rays for photo: " << photoInfo.imagePath << std::endl;
-	// 计算射线与边界框
-	//std::vector<TileIntersectionResult> intersectionResults = performRayTileIntersections(scene, pixelRays, intersectingTiles);
-	// 全局互斥锁
-	//PhotoData data;
-	//data.index = photoIndex;
-	//data.imagePath = photoInfo.imagePath;
-	//data.intersectionResults = intersectionResults;
-	//{
-	//    std::lock_guard<std::mutex> lock(allIntersectionResultsMutex);
-	//    allPhotoData.push_back(data);
-	//}
+	// 计算射线与 tile 的占比；阈值细化模式下粗采样后只细化占比接近下游阈值的 tile
+	if (config.computeCoverage || config.thresholdRefinement)
+	{
+		PhotoData data;
+		data.index = photoIndex;
+		data.imagePath = photoInfo.imagePath;
+		if (config.thresholdRefinement)
+		{
+			ThresholdRefinementOptions options;
+			options.threshold = config.assignmentThreshold;
+			options.coarseStep = config.coarseStep;
+			options.fineStep = config.rayStep;
+			options.minBand = config.refineBand;
+			options.rayLength = config.rayLength;
+			data.intersectionResults = performThresholdRefinedIntersections(builder.getTileNodes(), camera, intersectingTiles, options,
+				config.useTileGrid ? &builder.getTileGrid() : nullptr);
+		}
+		else
+		{
+			CoverageBatch batch = { camera, intersectingTiles, config.rayStep, pixelRays };
+			// 位姿增量模式沿用上次的标签，只重算可能改变的射线
+			std::vector<TileId> rayTiles = poseDelta ? poseDelta->trace(engine, batch, photoIndex) : engine.traceBatch(batch);
+			if (rayLabelWriter)
+			{
+				rayLabelWriter->writePhoto(photoIndex, (photoInfo.imageWidth + config.rayStep - 1) / config.rayStep,
+					(photoInfo.imageHeight + config.rayStep - 1) / config.rayStep, intersectingTiles, rayTiles);
+			}
+			data.intersectionResults = engine.aggregate(rayTiles, batch);
+			if (referenceEngine)
+			{
+				std::vector<TileId> referenceRayTiles = referenceEngine->traceBatch(batch);
+				printEngineReport(photoInfo.imagePath, engine.name(), rayTiles, referenceRayTiles, data.intersectionResults,
+					referenceEngine->aggregate(referenceRayTiles, batch), registry);
+			}
+		}
+		if (resultCache)
+		{
+			std::vector<TileId> tileIds;
+			for (const NamedBoundingBox& tile : intersectingTiles) tileIds.push_back(tile.id);
+			resultCache->store(resultCache->photoKey(photoInfo, tileIds, builder), registry, data.intersectionResults);
+		}
+		for (const auto& result : data.intersectionResults)
+		{
+			std::cout << "Tile: " << registry.getTileName(result.tileId) << " - " << result.percentage << "%" << std::endl;
+		}
+		// 断点模式下结果先进日志，全部完成后按序号统一输出；否则稀疏格式在照片完成时直接写出，稠密矩阵需要等全部照片完成
+		if (checkpoint)
+		{
+			checkpoint->append(data);
+		}
+		else if (resultWriter)
+		{
+			resultWriter->writePhoto(data);
+		}
+		else
+		{
+			std::lock_guard<std::mutex> lock(allIntersectionResultsMutex);
+			allPhotoData.push_back(data);
+		}
+	}
+	// 不打开窗口时无需生成射线几何
+	if (!config.showViewer)
+	{
+		return localScene;
+	}
 	// 绘制射线
 	for (const auto& ray : pixelRays)
 	{
@@ -110,14 +229,398 @@ static osg::ref_ptr<osg::Group> processPhoto(const PhotoInfo& photoInfo, int pho
 	return localScene;
 }
 
-int main()
+// 影响照片结果的采样与引擎参数，结果缓存按它与照片、tile 内容寻址
+static std::string samplingKey(const PipelineConfig& config)
+{
+	std::ostringstream key;
+	key.precision(17);
+	key << "step=" << config.rayStep << ";length=" << config.rayLength
+		<< ";engine=" << config.coverageEngine << ";bvh=" << config.bvhWidth << ";dsm=" << config.dsmCellSize;
+	if (config.thresholdRefinement)
+	{
+		key << ";refine=" << config.assignmentThreshold << "," << config.coarseStep << "," << config.refineBand;
+	}
+	return key.str();
+}
+
+// 除照片文件外影响逐射线标签的参数；位姿增量模式的照片文件本来就与上次不同，逐射线标签文件按它沿用
+static std::string sceneRunKey(const PipelineConfig& config)
+{
+	return "mesh=" + config.meshFolder + ";metadata=" + config.metadataFile + ";frame=" + config.photoFrame + ";" + samplingKey(config);
+}
+
+// 影响照片结果的参数，断点日志与增量状态只能在这些参数相同的运行之间沿用
+static std::string resultRunKey(const PipelineConfig& config)
+{
+	return "xml=" + config.xmlFile + ";" + sceneRunKey(config);
+}
+
+// 增量模式：照片的输入哈希与候选 tile 都与上次相同，且候选 tile 的内容都未变化时沿用上次的结果（放入 reusedPhotos），
+// 返回需要重算的照片。stateKey 不同（参数或高度阈值变化）时全部重算
+static std::vector<int> findAffectedPhotos(const IncrementalState& previousState, const std::string& stateKey, const SceneBuilder& builder,
+                                           const std::vector<PhotoInfo>& photoInfos, const std::vector<PhotoWorkItem>& items,
+                                           std::vector<PhotoData>& reusedPhotos)
+{
+	const TileRegistry& registry = builder.getTileRegistry();
+	// 上次的 tile 编号到本次编号，内容变化或已删除的 tile 为 kInvalidTileId
+	std::vector<TileId> previousToCurrent(previousState.tiles.size(), kInvalidTileId);
+	size_t unchangedTiles = 0;
+	for (size_t previousId = 0; previousId < previousState.tiles.size(); ++previousId)
+	{
+		TileId id = registry.findTile(previousState.tiles[previousId].name);
+		if (id != kInvalidTileId && builder.getTileContentHashes()[id] == previousState.tiles[previousId].contentHash)
+		{
+			previousToCurrent[previousId] = id;
+			++unchangedTiles;
+		}
+	}
+	std::unordered_map<int, const IncrementalPhoto*> previousPhotos;
+	if (previousState.runKey == stateKey)
+	{
+		for (const IncrementalPhoto& photo : previousState.photos) previousPhotos[photo.index] = &photo;
+	}
+	else if (!previousState.photos.empty())
+	{
+		std::cout << "Incremental: parameters or height threshold changed since the previous run, recomputing all photos" << std::endl;
+	}
+
+	std::vector<int> affected;
+	for (const PhotoWorkItem& item : items)
+	{
+		auto it = previousPhotos.find(item.photoIndex);
+		const IncrementalPhoto* previous = it == previousPhotos.end() ? nullptr : it->second;
+		bool reusable = previous && previous->inputHash == hashPhotoInfo(photoInfos[item.photoIndex])
+			&& previous->dependencies.size() == item.tiles.size();
+		// 两次运行的候选 tile 都按编号排列，映射后须逐个相同；变化的 tile 映射为 kInvalidTileId，不会相等
+		for (size_t i = 0; reusable && i < item.tiles.size(); ++i)
+		{
+			reusable = previousToCurrent[previous->dependencies[i]] == item.tiles[i];
+		}
+		if (!reusable)
+		{
+			affected.push_back(item.photoIndex);
+			continue;
+		}
+		if (!previous->hasResult) continue;
+		PhotoData data;
+		data.index = previous->index;
+		data.imagePath = previous->imagePath;
+		for (const TileIntersectionResult& result : previous->results)
+		{
+			data.intersectionResults.push_back({ previousToCurrent[result.tileId], result.percentage });
+		}
+		reusedPhotos.push_back(data);
+	}
+	std::cout << "Incremental: " << registry.size() - unchangedTiles << " of " << registry.size() << " tiles changed, "
+		<< affected.size() << " of " << items.size() << " photos need retracing" << std::endl;
+	return affected;
+}
+
+// 本次运行的增量状态，photos 为全部照片的结果（含沿用的结果）
+static IncrementalState buildIncrementalState(const std::string& stateKey, const SceneBuilder& builder,
+                                              const std::vector<PhotoInfo>& photoInfos, const std::vector<PhotoWorkItem>& items,
+                                              const std::vector<PhotoData>& photos)
+{
+	IncrementalState state;
+	state.runKey = stateKey;
+	const TileRegistry& registry = builder.getTileRegistry();
+	for (TileId id = 0; id < registry.size(); ++id)
+	{
+		TileSummary tile;
+		tile.name = registry.getTileName(id);
+		tile.bbox = builder.getTileBoundingBoxes()[id].bbox;
+		tile.triangles = builder.getTileTriangleCounts()[id];
+		tile.contentHash = builder.getTileContentHashes()[id];
+		tile.sourceStamp = builder.getTileSourceStamps()[id];
+		state.tiles.push_back(tile);
+	}
+	std::unordered_map<int, const PhotoData*> results;
+	for (const PhotoData& photo : photos) results[photo.index] = &photo;
+	for (const PhotoWorkItem& item : items)
+	{
+		auto it = results.find(item.photoIndex);
+		IncrementalPhoto photo;
+		photo.index = item.photoIndex;
+		photo.imagePath = photoInfos[item.photoIndex].imagePath;
+		photo.inputHash = hashPhotoInfo(photoInfos[item.photoIndex]);
+		photo.hasResult = it != results.end();
+		photo.dependencies = item.tiles;
+		if (photo.hasResult) photo.results = it->second->intersectionResults;
+		state.photos.push_back(photo);
+	}
+	return state;
+}
+
+// 场景图中每个三角形的常驻内存估计（顶点、法线、纹理坐标与索引），加速结构另由引擎给出
+static const size_t kSceneGraphBytesPerTriangle = 128;
+
+// 本次运行处理的照片：分片模式取清单中本分片的照片，否则取 [photoBegin, photoEnd)
+static std::vector<int> selectPhotoIndices(const PipelineConfig& config, size_t numPhotos)
+{
+	std::vector<int> photoIndices;
+	if (config.mode == "shard")
+	{
+		ShardManifest manifest = readShardManifest(config.shardDir);
+		if (manifest.xmlFile != config.xmlFile || manifest.meshFolder != config.meshFolder)
+		{
+			throw std::runtime_error("Shard manifest was planned for --xml=" + manifest.xmlFile + " --mesh=" + manifest.meshFolder
+				+ ", running with --xml=" + config.xmlFile + " --mesh=" + config.meshFolder);
+		}
+		if (config.shardIndex < 0 || config.shardIndex >= static_cast<int>(manifest.shardPhotos.size()))
+		{
+			throw std::runtime_error("shard " + std::to_string(config.shardIndex) + " is not in the manifest of "
+				+ std::to_string(manifest.shardPhotos.size()) + " shards");
+		}
+		for (int photoIndex : manifest.shardPhotos[config.shardIndex])
+		{
+			if (photoIndex < 0 || photoIndex >= static_cast<int>(numPhotos))
+			{
+				throw std::runtime_error("Photo #" + std::to_string(photoIndex) + " in the shard manifest is not in " + config.xmlFile);
+			}
+			photoIndices.push_back(photoIndex);
+		}
+		return photoIndices;
+	}
+	int photoEnd = std::min(config.photoEnd, static_cast<int>(numPhotos));
+	for (int photoIndex = config.photoBegin; photoIndex < photoEnd; ++photoIndex)
+	{
+		photoIndices.push_back(photoIndex);
+	}
+	return photoIndices;
+}
+
+// 照片的地面位置与候选 tile，候选 tile 与 processPhoto 中的计算一致；高于阈值的照片不处理，tiles 为空
+static std::vector<PhotoWorkItem> collectPhotoWorkItems(const std::vector<PhotoInfo>& photoInfos, const std::vector<int>& photoIndices,
+                                                        double heightThreshold, const osg::BoundingBox& sceneBounds,
+                                                        const std::vector<NamedBoundingBox>& tileBoundingBoxes)
+{
+	std::vector<PhotoWorkItem> items;
+	for (int photoIndex : photoIndices)
+	{
+		Camera camera(photoInfos[photoIndex]);
+		PhotoWorkItem item = { photoIndex, camera.getCameraCenter().x(), camera.getCameraCenter().z(), {} };
+		if (!isPhotoAboveScene(camera, heightThreshold))
+		{
+			osg::BoundingBox frustumBBox = camera.calculateFrustumBoundingBox(camera.createFrustumGeometry(sceneBounds));
+			for (const NamedBoundingBox& tile : camera.calculateIntersectingTiles(frustumBBox, tileBoundingBoxes))
+			{
+				item.tiles.push_back(tile.id);
+			}
+		}
+		items.push_back(item);
+	}
+	return items;
+}
+
+// 分片规划：单张照片的开销估计为射线数乘以 (1 + 候选 tile 数)，高于阈值的照片几乎不花时间
+static void runShardPlanning(const PipelineConfig& config, const std::vector<PhotoInfo>& photoInfos, const SceneBuilder& builder)
+{
+	std::vector<PhotoWorkItem> items = collectPhotoWorkItems(photoInfos, selectPhotoIndices(config, photoInfos.size()),
+		builder.calculateHeightThreshold(), builder.getSceneBoundingBox(), builder.getTileBoundingBoxes());
+	std::vector<PhotoCost> costs;
+	for (const PhotoWorkItem& item : items)
+	{
+		const PhotoInfo& photoInfo = photoInfos[item.photoIndex];
+		double rays = std::ceil(static_cast<double>(photoInfo.imageWidth) / config.rayStep) * std::ceil(static_cast<double>(photoInfo.imageHeight) / config.rayStep);
+		double cost = item.tiles.empty() ? 1.0 : rays * (1.0 + item.tiles.size());
+		costs.push_back({ item.photoIndex, item.groundX, item.groundZ, cost });
+	}
+	ShardManifest manifest = planShards(costs, config.numShards);
+	manifest.xmlFile = config.xmlFile;
+	manifest.meshFolder = config.meshFolder;
+	writeShardManifest(config.shardDir, manifest);
+	for (size_t shard = 0; shard < manifest.shardPhotos.size(); ++shard)
+	{
+		std::cout << "Shard " << shard << ": " << manifest.shardPhotos[shard].size() << " photos, cost " << manifest.shardCosts[shard] << std::endl;
+	}
+	std::cout << "Wrote shard manifest for " << costs.size() << " photos to " << config.shardDir << std::endl;
+}
+
+// 核外处理：按候选 tile 的估计内存把照片分批，每批只让需要的 tile 常驻。
+// 每批加载前按当前估计复核，加载中分段测量常驻内存，超出预算时按实测放大估计并重新规划剩余照片
+static void runOutOfCoreBatches(const PipelineConfig& config, const std::vector<PhotoWorkItem>& allItems, SceneBuilder& builder,
+                                size_t bytesPerTriangle,
+                                const std::function<void(const std::vector<TileId>&)>& releaseTiles,
+                                const std::function<void()>& prepareEngines,
+                                const std::function<void(const std::vector<int>&)>& processPhotos)
+{
+	const size_t budget = static_cast<size_t>(config.memoryBudgetMb) << 20;
+	const size_t numTiles = builder.getTileRegistry().size();
+
+	// 没有候选 tile 的照片（包括高于阈值、由 processPhoto 直接跳过的照片）不需要常驻 tile，最后一起处理
+	std::vector<PhotoWorkItem> items;
+	std::vector<int> tilelessPhotos;
+	for (const PhotoWorkItem& item : allItems)
+	{
+		if (!item.tiles.empty()) items.push_back(item);
+		else tilelessPhotos.push_back(item.photoIndex);
+	}
+
+	double scale = 1.0;
+	auto estimateTileBytes = [&]() {
+		std::vector<size_t> tileBytes(numTiles);
+		for (TileId id = 0; id < numTiles; ++id)
+		{
+			tileBytes[id] = static_cast<size_t>(builder.getTileTriangleCounts()[id] * bytesPerTriangle * scale);
+		}
+		return tileBytes;
+	};
+	releaseFreedMemory();
+	const size_t baseline = currentResidentBytes();
+	auto measureUsed = [&]() {
+		const size_t resident = currentResidentBytes();
+		return resident > baseline ? resident - baseline : 0;
+	};
+	std::vector<PhotoBatch> batches = planPhotoBatches(items, estimateTileBytes(), budget);
+	std::cout << "Out-of-core: " << items.size() << " photos in " << batches.size() << " batches, budget "
+		<< config.memoryBudgetMb << " MB, baseline resident " << (baseline >> 20) << " MB" << std::endl;
+	// 估计偏小：按实测放大后重新规划第 next 批及之后的照片，已常驻的 tile 在下一批中复用
+	auto replanRemaining = [&](size_t next) {
+		std::unordered_set<int> remaining;
+		for (size_t b = next; b < batches.size(); ++b)
+		{
+			remaining.insert(batches[b].photoIndices.begin(), batches[b].photoIndices.end());
+		}
+		std::vector<PhotoWorkItem> remainingItems;
+		for (const PhotoWorkItem& item : items)
+		{
+			if (remaining.count(item.photoIndex)) remainingItems.push_back(item);
+		}
+		batches = planPhotoBatches(remainingItems, estimateTileBytes(), budget);
+		std::cout << "Out-of-core: estimate scaled by " << scale << ", re-planned into " << batches.size() << " batches" << std::endl;
+	};
+
+	std::vector<TileId> residentTiles;
+	size_t batchesDone = 0;
+	size_t next = 0;
+	while (next < batches.size())
+	{
+		const PhotoBatch batch = batches[next];
+		// 加载前按当前的放大系数复核本批估计，上一批的实测可能已把它推过预算
+		const std::vector<size_t> tileBytes = estimateTileBytes();
+		size_t estimated = 0;
+		for (TileId id : batch.tiles) estimated += tileBytes[id];
+		if (estimated > budget && batch.photoIndices.size() > 1)
+		{
+			replanRemaining(next);
+			next = 0;
+			continue;
+		}
+
+		// 先卸载本批不需要的 tile 再加载，常驻集合不超过一批
+		std::vector<char> needed(numTiles, 0);
+		for (TileId id : batch.tiles) needed[id] = 1;
+		std::vector<TileId> unload;
+		for (TileId id : residentTiles)
+		{
+			if (!needed[id]) unload.push_back(id);
+		}
+		builder.unloadTiles(unload);
+		releaseTiles(unload);
+		releaseFreedMemory();
+
+		// 分段加载，每段约为预算的 1/8，段间检查实际占用，超出预算时停止加载，不等整批装入才发现
+		const size_t chunkBytes = std::max<size_t>(1, budget / 8);
+		std::vector<TileId> chunk;
+		size_t pendingBytes = 0, loadedEstimate = 0, used = 0;
+		bool overBudget = false;
+		for (size_t i = 0; i < batch.tiles.size() && !overBudget; ++i)
+		{
+			chunk.push_back(batch.tiles[i]);
+			pendingBytes += tileBytes[batch.tiles[i]];
+			if (pendingBytes < chunkBytes && i + 1 < batch.tiles.size()) continue;
+			builder.loadTiles(chunk);
+			loadedEstimate += pendingBytes;
+			chunk.clear();
+			pendingBytes = 0;
+			used = measureUsed();
+			overBudget = used > budget && baseline > 0;
+		}
+		// 常驻集合按实际已加载的节点重建：中途停止加载时，上一批留下、排在本批后面的 tile 仍然常驻，之后须能被换出
+		residentTiles.clear();
+		for (TileId id = 0; id < numTiles; ++id)
+		{
+			if (builder.isTileLoaded(id)) residentTiles.push_back(id);
+		}
+		if (!overBudget)
+		{
+			prepareEngines();
+			used = measureUsed();
+			overBudget = used > budget && baseline > 0;
+		}
+		if (overBudget)
+		{
+			if (batch.photoIndices.size() == 1)
+			{
+				throw std::runtime_error("Resident tiles for photo #" + std::to_string(batch.photoIndices[0]) + " use "
+					+ std::to_string(used >> 20) + " MB, more than the memory budget of " + std::to_string(config.memoryBudgetMb) + " MB");
+			}
+			std::cout << "Out-of-core: " << (used >> 20) << " MB resident exceeds the budget" << std::endl;
+			scale *= 1.1 * used / std::max<size_t>(1, loadedEstimate);
+			replanRemaining(next);
+			next = 0;
+			continue;
+		}
+
+		processPhotos(batch.photoIndices);
+		++batchesDone;
+		std::cout << "Out-of-core batch " << batchesDone << ": " << batch.photoIndices.size() << " photos, " << batch.tiles.size()
+			<< " tiles, estimated " << (estimated >> 20) << " MB, resident " << (used >> 20) << " MB, peak RSS "
+			<< (peakResidentBytes() >> 20) << " MB" << std::endl;
+		// 实测高于估计时放大系数，之后的批次在加载前即可按新系数复核
+		if (used > estimated && estimated > 0 && baseline > 0)
+		{
+			scale *= static_cast<double>(used) / estimated;
+		}
+		++next;
+	}
+	builder.unloadTiles(residentTiles);
+	releaseTiles(residentTiles);
+	if (!tilelessPhotos.empty())
+	{
+		processPhotos(tilelessPhotos);
+	}
+}
+
+int main(int argc, char** argv)
 {
 	try
 	{
 		auto startTime = std::chrono::high_resolution_clock::now();
+		PipelineConfig config = parsePipelineConfig(argc, argv);
+		// 先创建引擎，名称错误时在加载场景前报错
+		std::unique_ptr<CoverageEngine> coverageEngine = createCoverageEngine(config.coverageEngine, config);
+		if (config.mode == "assign")
+		{
+			SparseResults results = readSparseResults(config.assignInput.empty() ? config.outputCsv : config.assignInput);
+			runTileAssignment(config, results.photos, results.tileNames);
+			return 0;
+		}
+		// 合并各分片的部分结果，输出与单进程运行相同格式的结果文件
+		if (config.mode == "merge")
+		{
+			SparseResults results = mergeShardResults(config.shardDir, readShardManifest(config.shardDir));
+			TileRegistry registry;
+			for (const std::string& tileName : results.tileNames) registry.registerTile(tileName);
+			if (config.outputFormat == "dense")
+			{
+				outputIntersectionResultsToCSV(config.outputCsv, results.photos, registry);
+			}
+			else
+			{
+				SparseResultWriter writer(config.outputCsv, registry,
+					config.outputFormat == "binary" ? ResultFormat::SparseBinary : ResultFormat::SparseText);
+				for (const PhotoData& photo : results.photos) writer.writePhoto(photo);
+				writer.flush();
+			}
+			if (config.assignTiles)
+			{
+				runTileAssignment(config, results.photos, results.tileNames);
+			}
+			return 0;
+		}
 		// 解析照片信息
-		std::string xmlFile = "data/images/weizi.xml";
-		PhotoInfoParser parser(xmlFile);
+		PhotoInfoParser parser(config.xmlFile);
 		std::vector<PhotoInfo> photoInfos = parser.parsePhotoInfo();
 		if (photoInfos.empty())
 		{
@@ -126,9 +629,82 @@ int main()
 		}
 		std::cout << "Parsed " << photoInfos.size() << " photos." << std::endl;
 
+		// 引擎只在逐射线计算占比或写 tile 缓存时使用；阈值细化直接在 tile 节点上求交，基准模式自行创建引擎，
+		// 其余情况不在加载时构建引擎的加速结构，也不调用 prepare
+		const bool useEngine = (config.computeCoverage && !config.thresholdRefinement) || !config.tileCache.empty();
+
 		// 构建场景和边界框
 		SceneBuilder builder;
-		osg::ref_ptr<osg::Group> scene = builder.buildScene("data/mesh");
+		builder.setBuildKdTrees(config.buildKdTrees || (config.coverageEngine == "osgkd" && (useEngine || config.mode == "bench")));
+		TileLoadOptions loadOptions;
+		loadOptions.ioBackend = config.ioBackend;
+		loadOptions.ioThreads = config.ioThreads;
+		loadOptions.queueDepth = config.ioDepth;
+		loadOptions.parseThreads = config.parseThreads;
+		loadOptions.maxBufferedBytes = static_cast<size_t>(config.loadBufferMb) << 20;
+		builder.setLoadOptions(loadOptions);
+		if (useEngine)
+		{
+			builder.setTileLoadedCallback([&coverageEngine](const std::string& tileName, osg::Node* tileNode) {
+				coverageEngine->onTileLoaded(tileName, tileNode);
+			});
+		}
+		// 核外模式只登记 tile，按批次换入换出；场景不常驻，因此也不打开窗口
+		// 分片规划只需要包围盒，同样只扫描；分片进程不打开窗口，分配留给合并步骤
+		const bool outOfCore = config.memoryBudgetMb > 0;
+		if (config.mode == "shard")
+		{
+			config.showViewer = false;
+			config.assignTiles = false;
+		}
+		// 增量模式读取上次的状态：内容未变的 tile 不再解析，只重算依赖变化 tile 的照片，场景同样不常驻
+		const bool incremental = !config.incrementalFile.empty();
+		IncrementalState previousState;
+		if (incremental)
+		{
+			readIncrementalState(config.incrementalFile, previousState);
+			config.showViewer = false;
+		}
+		// 结果缓存与增量模式相同：按 tile 内容哈希扫描，只加载未命中照片的候选 tile
+		std::unique_ptr<ResultCache> resultCache;
+		std::vector<TileSummary> cachedTiles;
+		if (!config.resultCacheDir.empty())
+		{
+			resultCache.reset(new ResultCache(config.resultCacheDir, samplingKey(config), static_cast<uint64_t>(config.resultCacheMb) << 20));
+			cachedTiles = resultCache->readTileIndex();
+			config.showViewer = false;
+		}
+		// 共享 tile 缓存有效时只按缓存登记 tile，bvh 引擎直接映射缓存；无效时正常加载，prepare 后写出缓存
+		std::unique_ptr<TileCache> tileCache;
+		if (!config.tileCache.empty() && config.mode != "cache")
+		{
+			tileCache = TileCache::open(config.tileCache, config.bvhWidth);
+			if (!tileCache || !builder.restoreScene(config.meshFolder, tileCache->getTiles()))
+			{
+				std::cout << "Tile cache " << config.tileCache << " is missing or stale, loading the scene." << std::endl;
+				tileCache.reset();
+			}
+		}
+		osg::ref_ptr<osg::Group> scene;
+		if (tileCache)
+		{
+			scene = new osg::Group();
+			coverageEngine->attachTileCache(tileCache.get());
+		}
+		else if (outOfCore || incremental || resultCache || config.mode == "plan")
+		{
+			if (config.mode == "bench")
+			{
+				throw std::runtime_error("bench mode needs the whole scene resident; drop --memory-budget-mb");
+			}
+			builder.scanScene(config.meshFolder, incremental ? &previousState.tiles : resultCache ? &cachedTiles : nullptr);
+			scene = new osg::Group();
+			config.showViewer = false;
+		}
+		else
+		{
+			scene = builder.buildScene(config.meshFolder);
+		}
 		// 创建边界框几何
 
 		osg::ref_ptr<osg::Group> bboxGeometry = builder.createBoundingBoxGeometry();
@@ -136,48 +712,283 @@ int main()
 		builder.printTileBoundingBoxes();
 		std::cout << "Scene built." << std::endl;
 
+		// mesh 顶点相对 SRSOrigin 存放，照片中心在创建 Camera 前换算到同一局部坐标系
+		ModelMetadata metadata = loadModelMetadata(config.metadataFile.empty() ? config.meshFolder + "/metadata.xml" : config.metadataFile);
+		convertPhotosToLocalFrame(photoInfos, metadata, parsePhotoFrame(config.photoFrame), builder.getSceneBoundingBox());
+
+		// 基准模式只输出对比表，超出容差时以非零值退出
+		if (config.mode == "bench")
+		{
+			return runEngineBenchmark(config, photoInfos, builder) ? 0 : 1;
+		}
+		if (config.mode == "plan")
+		{
+			runShardPlanning(config, photoInfos, builder);
+			return 0;
+		}
+
 		std::vector<NamedBoundingBox> tileBoundingBoxes = builder.getTileBoundingBoxes();
 		// 计算高度阈值
 		double heightThreshold = builder.calculateHeightThreshold();
+		osg::BoundingBox sceneBounds = builder.getSceneBoundingBox();
 		// 存储所有照片的结果
 		std::vector<PhotoData> allPhotoData;
 
 		std::unordered_set<int> photoIndices = loadPhotoIndices(
 			"C://Users//Admin//Desktop//PhotoMapping//PhotoMapping//images//Tile_0016_0020//photo_indices.txt");
 
-		// 处理所有照片
-		std::vector<std::thread> threads;
+		// 准备占比计算引擎；需要误差报告时另备一个 osg 参考引擎。核外模式在每批 tile 换入后再准备
+		std::unique_ptr<CoverageEngine> referenceEngine;
+		if (useEngine && config.engineReport && config.coverageEngine != "osg")
+		{
+			referenceEngine = createCoverageEngine("osg", config);
+		}
+		auto prepareEngines = [&]() {
+			if (!useEngine) return;
+			coverageEngine->prepare(builder);
+			if (referenceEngine) referenceEngine->prepare(builder);
+		};
+		if (!outOfCore && !incremental && !resultCache)
+		{
+			prepareEngines();
+		}
+		if (!config.tileCache.empty() && !tileCache)
+		{
+			coverageEngine->writeTileCache(config.tileCache, builder);
+		}
+		if (config.mode == "cache")
+		{
+			return 0;
+		}
+
+		std::vector<int> selectedPhotos = selectPhotoIndices(config, photoInfos.size());
+		const std::unordered_set<int> selectedSet(selectedPhotos.begin(), selectedPhotos.end());
+		// 断点日志中已完成的照片不再处理
+		std::unique_ptr<CheckpointLog> checkpoint;
+		if (!config.checkpointFile.empty())
+		{
+			checkpoint.reset(new CheckpointLog(config.checkpointFile, resultRunKey(config), builder.getTileRegistry(), config.resume));
+			std::vector<int> remainingPhotos;
+			for (int photoIndex : selectedPhotos)
+			{
+				if (!checkpoint->isCompleted(photoIndex)) remainingPhotos.push_back(photoIndex);
+			}
+			std::cout << "Checkpoint: " << selectedPhotos.size() - remainingPhotos.size() << " of " << selectedPhotos.size()
+				<< " photos already completed" << std::endl;
+			selectedPhotos.swap(remainingPhotos);
+		}
+		std::vector<PhotoWorkItem> workItems;
+		std::vector<PhotoData> reusedPhotos;
+		std::string stateKey;
+		if (incremental)
+		{
+			std::ostringstream key;
+			key.precision(17);
+			key << resultRunKey(config) << ";height=" << heightThreshold;
+			stateKey = key.str();
+			workItems = collectPhotoWorkItems(photoInfos, selectedPhotos, heightThreshold, sceneBounds, tileBoundingBoxes);
+			selectedPhotos = findAffectedPhotos(previousState, stateKey, builder, photoInfos, workItems, reusedPhotos);
+		}
+		// 结果缓存命中的照片不再处理。高于高度阈值的照片没有结果；没有候选 tile 的照片结果为空，
+		// 与不用缓存时 processPhoto 的输出一致，无需追踪
+		std::vector<PhotoData> cachedPhotos;
+		if (resultCache)
+		{
+			resultCache->writeTileIndex(builder);
+			std::vector<int> missedPhotos;
+			for (const PhotoWorkItem& item : collectPhotoWorkItems(photoInfos, selectedPhotos, heightThreshold, sceneBounds, tileBoundingBoxes))
+			{
+				if (isPhotoAboveScene(Camera(photoInfos[item.photoIndex]), heightThreshold)) continue;
+				PhotoData data;
+				data.index = item.photoIndex;
+				data.imagePath = photoInfos[item.photoIndex].imagePath;
+				if (item.tiles.empty() || resultCache->lookup(resultCache->photoKey(photoInfos[item.photoIndex], item.tiles, builder), builder.getTileRegistry(),
+					data.intersectionResults))
+				{
+					cachedPhotos.push_back(data);
+				}
+				else
+				{
+					missedPhotos.push_back(item.photoIndex);
+				}
+			}
+			selectedPhotos.swap(missedPhotos);
+		}
+		// 分片进程总是写稀疏格式的部分结果，先写到临时文件，完成后改名
+		const std::string outputFile = config.mode == "shard" ? shardResultPath(config.shardDir, config.shardIndex) : config.outputCsv;
+		// 不计算占比的运行没有结果，不创建也不覆盖结果文件
+		std::unique_ptr<SparseResultWriter> resultWriter;
+		if ((config.computeCoverage || config.thresholdRefinement) && (config.outputFormat != "dense" || config.mode == "shard"))
+		{
+			resultWriter.reset(new SparseResultWriter(config.mode == "shard" ? outputFile + ".tmp" : outputFile, builder.getTileRegistry(),
+				config.outputFormat == "binary" ? ResultFormat::SparseBinary : ResultFormat::SparseText));
+		}
+
+		// 逐射线标签按候选 tile 的内容哈希校验
+		if (!config.previousXmlFile.empty() || !config.rayLabelsFile.empty())
+		{
+			builder.computeTileContentHashes();
+		}
+		// 位姿增量模式：上次运行的照片位姿换算到同一局部坐标系，与上次的逐射线标签一起作为基础
+		std::unique_ptr<PoseDeltaTracer> poseDelta;
+		if (!config.previousXmlFile.empty())
+		{
+			std::vector<PhotoInfo> previousPhotos = PhotoInfoParser(config.previousXmlFile).parsePhotoInfo();
+			convertPhotosToLocalFrame(previousPhotos, metadata, parsePhotoFrame(config.photoFrame), builder.getSceneBoundingBox());
+			PoseDeltaOptions options;
+			options.maxShift = config.deltaMaxShift;
+			options.maxRotationDegrees = config.deltaMaxRotation;
+			options.band = config.deltaBand;
+			poseDelta.reset(new PoseDeltaTracer(std::move(previousPhotos), readRayLabels(config.previousRayLabels, sceneRunKey(config), builder),
+				sceneBounds, options));
+		}
+		std::unique_ptr<RayLabelWriter> rayLabelWriter;
+		if (!config.rayLabelsFile.empty())
+		{
+			rayLabelWriter.reset(new RayLabelWriter(config.rayLabelsFile, sceneRunKey(config), builder));
+		}
+
+		// 处理一组照片，每张照片一个共享线程池任务，核外模式每批照片再多也不会为每张照片开线程；
+		// 增量模式先收集全部结果，与沿用的结果合并后再输出
+		SparseResultWriter* photoWriter = incremental ? nullptr : resultWriter.get();
 		std::mutex sceneMutex; // Mutex for scene synchronization photoInfos.size()
-		for (int photoIndex = 655; photoIndex < 656; ++photoIndex) {
-		    threads.emplace_back([&photoInfos, photoIndex, &scene, &sceneMutex, heightThreshold, &tileBoundingBoxes, &allPhotoData]() {
-		        auto localScene = processPhoto(photoInfos[photoIndex], photoIndex, scene, heightThreshold, tileBoundingBoxes, allPhotoData);
-		        std::lock_guard<std::mutex> lock(sceneMutex);
-		        scene->addChild(localScene);
-		        });
+		auto processPhotos = [&](const std::vector<int>& photoIndices) {
+			TaskGroup tasks(ThreadPool::shared());
+			for (int photoIndex : photoIndices) {
+			    tasks.run([&photoInfos, photoIndex, &builder, &scene, &sceneMutex, heightThreshold, &sceneBounds, &tileBoundingBoxes, &config, &coverageEngine, &referenceEngine, photoWriter, &checkpoint, &poseDelta, &rayLabelWriter, &resultCache, &allPhotoData]() {
+			        auto localScene = processPhoto(photoInfos[photoIndex], photoIndex, builder, heightThreshold, sceneBounds, tileBoundingBoxes, config, *coverageEngine, referenceEngine.get(), photoWriter, checkpoint.get(), poseDelta.get(), rayLabelWriter.get(), resultCache.get(), allPhotoData);
+			        std::lock_guard<std::mutex> lock(sceneMutex);
+			        scene->addChild(localScene);
+			        });
+			}
+			// 等待所有照片完成，照片中抛出的第一个异常在这里重新抛出
+			tasks.wait();
+		};
+		if (outOfCore)
+		{
+			auto releaseTiles = [&](const std::vector<TileId>& ids) {
+				if (useEngine) coverageEngine->releaseTiles(ids);
+				if (referenceEngine) referenceEngine->releaseTiles(ids);
+			};
+			size_t bytesPerTriangle = kSceneGraphBytesPerTriangle + (useEngine ? coverageEngine->accelerationBytesPerTriangle() : 0)
+				+ (referenceEngine ? referenceEngine->accelerationBytesPerTriangle() : 0);
+			runOutOfCoreBatches(config, collectPhotoWorkItems(photoInfos, selectedPhotos, heightThreshold,
+				sceneBounds, tileBoundingBoxes), builder, bytesPerTriangle, releaseTiles, prepareEngines, processPhotos);
+		}
+		else if (incremental || resultCache)
+		{
+			// 只加载待重算照片的候选 tile
+			std::vector<char> needed(builder.getTileRegistry().size(), 0);
+			std::vector<TileId> neededTiles;
+			for (const PhotoWorkItem& item : collectPhotoWorkItems(photoInfos, selectedPhotos, heightThreshold, sceneBounds, tileBoundingBoxes))
+			{
+				for (TileId id : item.tiles)
+				{
+					if (!needed[id]) neededTiles.push_back(id);
+					needed[id] = 1;
+				}
+			}
+			builder.loadTiles(neededTiles);
+			prepareEngines();
+			processPhotos(selectedPhotos);
 		}
-		// 等待所有线程完成
-		for (auto& thread : threads)
+		else
 		{
-			if (thread.joinable())
+			processPhotos(selectedPhotos);
+		}
+
+		if (poseDelta)
+		{
+			poseDelta->printSummary();
+		}
+		// 缓存命中的结果与本次计算的结果一起输出
+		if (resultCache)
+		{
+			resultCache->printSummary();
+			for (PhotoData& photo : cachedPhotos)
 			{
-				thread.join();
+				if (resultWriter) resultWriter->writePhoto(photo);
+				else allPhotoData.push_back(std::move(photo));
 			}
 		}
+		if (rayLabelWriter)
+		{
+			rayLabelWriter->close();
+		}
 
-		// 获取所有瓦片名称
-		//std::vector<std::string> tileNames = extractTileNames(tileBoundingBoxes);
+		// 增量模式：合并沿用的结果，按序号输出并保存本次状态
+		if (incremental)
+		{
+			allPhotoData.insert(allPhotoData.end(), reusedPhotos.begin(), reusedPhotos.end());
+			std::sort(allPhotoData.begin(), allPhotoData.end(), [](const PhotoData& a, const PhotoData& b) { return a.index < b.index; });
+			writeIncrementalState(config.incrementalFile, buildIncrementalState(stateKey, builder, photoInfos, workItems, allPhotoData));
+			if (resultWriter)
+			{
+				for (const PhotoData& photo : allPhotoData) resultWriter->writePhoto(photo);
+			}
+		}
+
+		// 断点模式：日志包含此前各次运行完成的照片，按序号输出，与一次跑完的结果相同
+		if (checkpoint)
+		{
+			std::vector<PhotoData> checkpointPhotos;
+			for (PhotoData& photo : checkpoint->readPhotos())
+			{
+				if (selectedSet.count(photo.index)) checkpointPhotos.push_back(std::move(photo));
+			}
+			std::cout << "Checkpoint: " << checkpointPhotos.size() << " photos from the log, " << checkpoint->getWriteSeconds()
+				<< " s spent writing it in this run" << std::endl;
+			if (resultWriter)
+			{
+				for (const PhotoData& photo : checkpointPhotos) resultWriter->writePhoto(photo);
+			}
+			else
+			{
+				allPhotoData.swap(checkpointPhotos);
+			}
+		}
 		// 输出交集结果到CSV文件
-		//outputIntersectionResultsToCSV("output.csv", allPhotoData, tileNames);
+		if (resultWriter)
+		{
+			resultWriter->flush();
+			if (config.mode == "shard")
+			{
+				resultWriter.reset();
+				commitShardResult(config.shardDir, config.shardIndex, std::vector<int>(selectedSet.begin(), selectedSet.end()));
+				std::cout << "Shard " << config.shardIndex << " written to " << outputFile << std::endl;
+			}
+		}
+		else if (!allPhotoData.empty())
+		{
+			outputIntersectionResultsToCSV(config.outputCsv, allPhotoData, builder.getTileRegistry());
+		}
+		// 分配照片到 tile 目录，稀疏输出时从刚写完的结果文件读回
+		if (config.assignTiles)
+		{
+			if (resultWriter)
+			{
+				SparseResults results = readSparseResults(config.outputCsv);
+				runTileAssignment(config, results.photos, results.tileNames);
+			}
+			else
+			{
+				runTileAssignment(config, allPhotoData, builder.getTileRegistry().getTileNames());
+			}
+		}
+
+		auto endTime = std::chrono::high_resolution_clock::now();
+		auto totalTime = std::chrono::duration_cast<std::chrono::seconds>(endTime - startTime).count();
+		std::cout << "Total time: " << totalTime << " seconds, peak RSS " << (peakResidentBytes() >> 20) << " MB." << std::endl;
+		if (!config.showViewer)
+		{
+			return 0;
+		}
 
 		// 设置背景色并运行观察器
 		osgViewer::Viewer viewer;
 		viewer.setSceneData(scene);
 		viewer.getCamera()->setClearColor(osg::Vec4(1.0, 1.0, 1.0, 1.0));
 		viewer.setUpViewInWindow(100, 100, 800, 600);
-		// 设置总时间
-		auto endTime = std::chrono::high_resolution_clock::now();
-		auto totalTime = std::chrono::duration_cast<std::chrono::seconds>(endTime - startTime).count();
-		std::cout << "Total time: " << totalTime << " seconds." << std::endl;
 		return viewer.run();
 	}
 	catch (const std::exception& e)